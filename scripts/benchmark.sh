@@ -0,0 +1,160 @@
+#!/usr/bin/env bash
+# Columba 1.1: Approximate Pattern Matching using Search Schemes
+# Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and
+#                           Jan Fostier <jan.fostier@ugent.be>
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as
+# published by the Free Software Foundation, either version 3 of the
+# License, or (at your option) any later version.
+#
+# Runs columba for every combination of search scheme, distance metric and
+# partitioning strategy and writes one tab separated line of results per run.
+# Without a read file, reads are simulated with a fixed seed, so that runs on
+# the same index can be compared over time.
+
+set -u
+
+usage() {
+    echo "Usage: $0 [options] bindir basefilename"
+    echo
+    echo " [options]"
+    echo "  -e  comma-separated maximal edit distances [default = 4]"
+    echo "  -r  read file, reads are simulated if not given"
+    echo "  -n  number of simulated reads [default = 10000]"
+    echo "  -o  output file [default = benchmark.tsv]"
+    echo "  -w  folder for the reads and the logs [default = benchmark]"
+    echo "  -a  also run the naive backtracking, which is orders of magnitude"
+    echo "      slower than the search schemes, and run it once more at edit"
+    echo "      distance $naiveHighED on the first $naiveHighReads reads"
+}
+
+# beyond the edit distances of the search schemes, only the naive backtracking
+# with the wide bit-parallel matrix applies
+naiveHighED=14
+naiveHighReads=100
+
+maxEDs=4
+reads=""
+numReads=10000
+output="benchmark.tsv"
+workDir="benchmark"
+naive=0
+
+while getopts "e:r:n:o:w:ah" opt; do
+    case $opt in
+        e) maxEDs=$OPTARG ;;
+        r) reads=$OPTARG ;;
+        n) numReads=$OPTARG ;;
+        o) output=$OPTARG ;;
+        w) workDir=$OPTARG ;;
+        a) naive=1 ;;
+        *) usage; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -ne 2 ]; then
+    usage
+    exit 1
+fi
+binDir=$1
+index=$2
+
+mkdir -p "$workDir"
+if [ -z "$reads" ]; then
+    reads="$workDir/simulated.fa"
+    "$binDir/columba_simulate" -n "$numReads" -S 42 "$index" "$reads" \
+        > "$workDir/simulate.log" || exit 1
+fi
+
+schemes=(kuch1 kuch2 kianfar manbest pigeon "01*0")
+if [ $naive -eq 1 ]; then
+    schemes+=(naive)
+fi
+metrics=(editopt editnaive hamming)
+partitionings=(uniform static dynamic)
+
+# succeeds if the scheme supports the maximal edit distance
+# arguments: scheme max_ed
+supports() {
+    case $1 in
+        manbest) [ "$2" -eq 4 ] ;;
+        naive) [ "$2" -le 20 ] ;;
+        *) [ "$2" -le 4 ] ;;
+    esac
+}
+
+# runs columba once and appends its line of results to the output file
+# arguments: scheme metric partitioning max_ed reads log
+run() {
+    "$binDir/columba" -e "$4" -ss "$1" -m "$2" -p "$3" "$index" "$5" \
+        > "$6" 2>&1
+    status=$?
+
+    # the progress counts the reads and their reverse complements
+    awk -v scheme="$1" -v metric="$2" -v partitioning="$3" -v ed="$4" \
+        -v status="$status" '
+        /^Progress: / {
+            split($NF, p, "/"); n = p[2] / 2
+        }
+        /^Total duration: / {
+            s = $3; sub("s", "", s)
+        }
+        /^Reads per second: / { rate = $4 }
+        /^Average no. nodes: / { nodes = $4 }
+        /^Mapped reads: / { mapped = $3 }
+        /^Peak memory: / { rss = $3 }
+        END {
+            ok = (status == 0 && s != "")
+            printf "%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n",
+                scheme, metric, partitioning, ed,
+                ok ? n : "NA", ok ? s : "NA", ok ? rate : "NA",
+                ok ? nodes : "NA", ok ? rss : "NA",
+                ok ? mapped : "NA", ok ? "ok" : "failed"
+        }' "$6" | tee -a "$output"
+}
+
+printf "scheme\tmetric\tpartitioning\tmax_ed\treads\tseconds\treads_per_s\t\
+nodes_per_read\tpeak_rss_kb\tmapped\tstatus\n" > "$output"
+
+for maxED in ${maxEDs//,/ }; do
+    for scheme in "${schemes[@]}"; do
+        for metric in "${metrics[@]}"; do
+            for partitioning in "${partitionings[@]}"; do
+                # the naive backtracking does not partition the reads
+                if [ "$scheme" = "naive" ] &&
+                    [ "$partitioning" != "dynamic" ]; then
+                    continue
+                fi
+
+                if ! supports "$scheme" "$maxED"; then
+                    printf "%s\t%s\t%s\t%s\tNA\tNA\tNA\tNA\tNA\tNA\t\
+unsupported\n" "$scheme" "$metric" "$partitioning" "$maxED" |
+                        tee -a "$output"
+                    continue
+                fi
+
+                log="$workDir/${scheme//\*/s}_${metric}_${partitioning}"
+                log+="_ed${maxED}.log"
+                run "$scheme" "$metric" "$partitioning" "$maxED" "$reads" \
+                    "$log"
+            done
+        done
+    done
+done
+
+if [ $naive -eq 1 ]; then
+    # keep the extension, columba derives the read format from it
+    subset="$workDir/first_${naiveHighReads}.${reads##*.}"
+    if [ "$(head -c 1 "$reads")" = "@" ]; then # FASTQ, 4 lines per read
+        head -n $((4 * naiveHighReads)) "$reads" > "$subset"
+    else
+        awk -v max="$naiveHighReads" '/^>/ { n++ } n <= max' "$reads" \
+            > "$subset"
+    fi
+    for metric in "${metrics[@]}"; do
+        run naive "$metric" dynamic "$naiveHighED" "$subset" \
+            "$workDir/naive_${metric}_ed${naiveHighED}.log"
+    done
+fi
@@ -19,6 +19,9 @@
 #ifndef BANDMATRIX_H
 #define BANDMATRIX_H
 
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <cmath>
 #include <cstdio>
 #include <iostream>
@@ -51,7 +54,18 @@ class BandMatrix {
     length_t W; // The off diagonal width of this bandmatrix
     length_t m; // number of rows
     length_t n; // number of columns
-    const static int Wprod = 16;
+    int Wprod;  // the storage per row, holds the band and its borders
+
+    /**
+     * The storage per row for a band of a given width. Small bands share the
+     * same power of two, wider bands get exactly the band and its two
+     * borders, the left border aliases the final cell of the previous row.
+     * @param W, the off diagonal width of the band
+     * @returns the storage per row
+     */
+    static int rowStride(int W) {
+        return std::max(16, 2 * W + 2);
+    }
 
     int finalCellFirstCol; // the final row of the zeroth column
     int rowsPerColumn; // the number of rows per column (starting from the Wth
@@ -126,7 +140,7 @@ class BandMatrix {
      */
     BandMatrix(length_t pieceSize, int W, int startValue,
                const std::vector<int>& eds)
-        : W(W), n(pieceSize + 1) {
+        : W(W), n(pieceSize + 1), Wprod(rowStride(W)) {
 
         if (eds.empty()) {
             m = pieceSize + W + 1;
@@ -153,7 +167,7 @@ class BandMatrix {
      * the origin
      */
     BandMatrix(length_t pieceSize, int W, int startValue)
-        : W(W), m(pieceSize + W + 1), n(pieceSize + 1) {
+        : W(W), m(pieceSize + W + 1), n(pieceSize + 1), Wprod(rowStride(W)) {
         matrix.resize(m * Wprod);
         rowsPerColumn = 2 * W + 1;
         initializeMatrix(startValue);
@@ -165,7 +179,7 @@ class BandMatrix {
      * @param m Number of rows
      * @param W Number of off-diagonal elements (one sided)
      */
-    BandMatrix(length_t m, int W) : W(W), m(m) {
+    BandMatrix(length_t m, int W) : W(W), m(m), Wprod(rowStride(W)) {
         matrix.resize(m * Wprod);
         n = m - W;
         initializeMatrix(0);
@@ -274,38 +288,157 @@ class BandMatrix {
     }
 };
 
+// ============================================================================
+// CLASS ENCODED PATTERN
+// ============================================================================
+
+/**
+ * A pattern encoded once as one bit vector per nucleotide, in both reading
+ * directions. The match vectors of a bit-parallel matrix for any substring of
+ * the pattern are sliced from it a word at a time, instead of being built
+ * character by character for every part and direction.
+ */
+class EncodedPattern {
+  private:
+    // bit i of fwd[c] is set if character i of the pattern is nucleotide c,
+    // bit i of rev[c] is set if character i from the end is nucleotide c
+    std::array<std::vector<uint64_t>, 4> fwd, rev;
+    size_t size = 0; // the size of the pattern
+
+    /**
+     * Packs the characters of the pattern in one bit vector per nucleotide,
+     * a word at a time and without branching on the nucleotides, which are
+     * unpredictable
+     * @param pattern the pattern
+     * @param reverse if true bit i corresponds to character i from the end
+     * @param bits the bit vectors (output), must be large enough
+     */
+    void pack(const std::string& pattern, bool reverse,
+              std::array<std::vector<uint64_t>, 4>& bits) const {
+        // the index of each nucleotide, 4 for all other characters
+        static const std::array<uint8_t, 256> codes = []() {
+            std::array<uint8_t, 256> table;
+            table.fill(4);
+            table['A'] = 0, table['C'] = 1, table['G'] = 2, table['T'] = 3;
+            return table;
+        }();
+
+        for (size_t w = 0; w * 64 < size; w++) {
+            // word 4 collects the characters other than ACGT
+            uint64_t word[5] = {0, 0, 0, 0, 0};
+            size_t end = std::min<size_t>(size, w * 64 + 64);
+            for (size_t i = w * 64; i < end; i++) {
+                char ch = pattern[reverse ? size - 1 - i : i];
+                word[codes[(unsigned char)ch]] |= 1ull << (i % 64);
+            }
+            for (size_t c = 0; c < 4; c++) {
+                bits[c][w] = word[c];
+            }
+        }
+    }
+
+  public:
+    /**
+     * Encodes a pattern, the memory of a previous pattern is reused
+     * @param pattern the pattern to encode, characters other than ACGT
+     * match no nucleotide
+     */
+    void encode(const std::string& pattern) {
+        size = pattern.size();
+        // one extra word so that a slice can always read the next word
+        size_t numWords = (size + 63) / 64 + 1;
+        for (size_t c = 0; c < 4; c++) {
+            fwd[c].assign(numWords, 0);
+            rev[c].assign(numWords, 0);
+        }
+        pack(pattern, false, fwd);
+        pack(pattern, true, rev);
+    }
+
+    /**
+     * Finds where a substring of the pattern starts in the encoding of its
+     * direction
+     * @param X a substring of the encoded pattern
+     * @returns the bit that corresponds to X[0]
+     */
+    size_t getOffset(const Substring& X) const {
+        return (X.getDirection() == FORWARD) ? X.begin() : size - X.end();
+    }
+
+    /**
+     * Gets at most 64 consecutive bits of the bit vector of a nucleotide
+     * @param c the index of the nucleotide (A = 0, C = 1, G = 2, T = 3)
+     * @param d the direction in which the pattern is read
+     * @param pos the first bit
+     * @param count the number of bits, at most 64
+     * @returns the bits [pos, pos + count) in the lowest bits of a word
+     */
+    uint64_t getBits(size_t c, Direction d, size_t pos, size_t count) const {
+        const std::vector<uint64_t>& bits = (d == FORWARD) ? fwd[c] : rev[c];
+        const size_t w = pos / 64, s = pos % 64;
+
+        uint64_t word = bits[w] >> s;
+        if (s != 0) {
+            word |= bits[w + 1] << (64 - s);
+        }
+        return (count >= 64) ? word : word & ((1ull << count) - 1);
+    }
+};
+
 // ============================================================================
 // CLASS BIT-PARALLEL-ED MATRIX
 // ============================================================================
 
-typedef struct {
-    uint64_t HP;    // bit vector to indicate which delta_H == +1
-    uint64_t HN;    // bit vector to indicate which delta_H == -1
-    uint64_t D0;    // bit vector to indicate which delta_D == 0
-    uint64_t RAC;   // bit vector to indicate the Rightmost Active Column
+// 128-bit word for the wide bit-parallel matrix (a GCC/Clang extension)
+__extension__ typedef unsigned __int128 uint128_t;
+
+/**
+ * Counts the set bits in a word of the bit-parallel matrix
+ * @param w the word
+ * @returns the number of bits set to one
+ */
+inline int popcount(uint64_t w) {
+    return __builtin_popcountll(w);
+}
+
+/**
+ * Counts the set bits in a wide word of the bit-parallel matrix
+ * @param w the word
+ * @returns the number of bits set to one
+ */
+inline int popcount(uint128_t w) {
+    return __builtin_popcountll((uint64_t)w) +
+           __builtin_popcountll((uint64_t)(w >> 64));
+}
+
+template <typename Word> struct BitVectors {
+    Word HP;        // bit vector to indicate which delta_H == +1
+    Word HN;        // bit vector to indicate which delta_H == -1
+    Word D0;        // bit vector to indicate which delta_D == 0
+    Word RAC;       // bit vector to indicate the Rightmost Active Column
                     // = rightmost column with a value <= maxED
     uint64_t score; // score at the diagonal
-} BitVectors;
-
-typedef struct {
-    uint64_t A; // match vector to indicate occurrences of A in X
-    uint64_t C; // match vector to indicate occurrences of C in X
-    uint64_t G; // match vector to indicate occurrences of G in X
-    uint64_t T; // match vector to indicate occurrences of T in X
-} MatchVectors;
-
-#define WORD_SIZE (64ull)
-#define BLOCK_SIZE (32ull)
-#define MAX_ED ((WORD_SIZE - BLOCK_SIZE - 2ull) / 3ull)
-#define LEFT (2ull * MAX_ED + 1ull)
-#define DIAG_R0 (2ull * MAX_ED)
-
-class BitParallelED {
+};
+
+/**
+ * Banded edit distance matrix that computes one row at a time in a
+ * bit-parallel manner. A row of the band is stored in a single machine word
+ * of type Word, which determines the highest supported edit distance: 10 for
+ * 64-bit words and 20 for 128-bit words. Longer sequences are handled in
+ * blocks of half a word, independent of the word size.
+ */
+template <typename Word> class BitParallelEDT {
   public:
+    static constexpr size_t WORD_SIZE = 8 * sizeof(Word); // bits in a word
+    static constexpr size_t BLOCK_SIZE = WORD_SIZE / 2;   // rows per block
+    static constexpr size_t MAX_ED = (WORD_SIZE - BLOCK_SIZE - 2) / 3;
+    static constexpr size_t LEFT = 2 * MAX_ED + 1;
+    static constexpr size_t DIAG_R0 = 2 * MAX_ED;
+
     /**
      * Constructor
      */
-    BitParallelED() {
+    BitParallelEDT() {
         // create the alphabet mappingS
         char2idx = std::vector<char>(256, 4);
         char2idx['A'] = 0;
@@ -320,6 +453,19 @@ class BitParallelED {
      * (with different initialization settings) with a fixed sequence X.
      */
     void setSequence(const Substring& X) {
+        if (X.getDirection() == FORWARD) {
+            setSequence(X.view<FORWARD>());
+        } else {
+            setSequence(X.view<BACKWARD>());
+        }
+    }
+
+    /**
+     * Bit-encode the horizontal sequence X, read in a direction that is known
+     * at compile time. See setSequence(const Substring&).
+     * @param X the characters of the horizontal sequence
+     */
+    template <Direction D> void setSequence(const SubstringView<D>& X) {
         n = X.size() + 1;   // number of columns
         m = 2 * MAX_ED + n; // this is an upper bound, the exact maxED
                             // is specified during initializeMatrix()
@@ -328,11 +474,11 @@ class BitParallelED {
         mv.resize((m + BLOCK_SIZE - 1) / BLOCK_SIZE);
 
         // encode the first block
-        const uint64_t init = (1ull << LEFT) - 1;
+        const Word init = (Word(1) << LEFT) - 1;
         // first left bits are set to 1 for each characters, so that
         // initialization vector can propagate to first actual column
         mv[0] = {init, init, init, init};
-        uint64_t bitmask = 1ull << LEFT;
+        Word bitmask = Word(1) << LEFT;
         size_t je = std::min<size_t>(X.size(), WORD_SIZE - LEFT);
         for (size_t j = 0; j < je; j++) {
             assert(char2idx[X[j]] < 4); // assert ACTG alphabet
@@ -349,7 +495,7 @@ class BitParallelED {
             mv[b][2] = mv[b - 1][2] >> BLOCK_SIZE;
             mv[b][3] = mv[b - 1][3] >> BLOCK_SIZE;
 
-            bitmask = 1ull << (WORD_SIZE - BLOCK_SIZE);
+            bitmask = Word(1) << (WORD_SIZE - BLOCK_SIZE);
             size_t jb = WORD_SIZE - LEFT + (b - 1) * BLOCK_SIZE;
             size_t je = std::min<size_t>(X.size(), jb + BLOCK_SIZE);
             for (size_t j = jb; j < je; j++) {
@@ -360,6 +506,45 @@ class BitParallelED {
         }
     }
 
+    /**
+     * Bit-encode the horizontal sequence X by slicing the match vectors from
+     * an encoding of the pattern X is a substring of. This is equivalent to
+     * setSequence(X), but processes a word at a time.
+     * @param X a substring of the encoded pattern
+     * @param encoding the encoding of the pattern
+     */
+    void setSequence(const Substring& X, const EncodedPattern& encoding) {
+        n = X.size() + 1;   // number of columns
+        m = 2 * MAX_ED + n; // this is an upper bound, the exact maxED
+                            // is specified during initializeMatrix()
+
+        // allocate the match vectors
+        mv.resize((m + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+        const Direction d = X.getDirection();
+        const size_t first = encoding.getOffset(X);
+
+        // encode the first block, the first LEFT bits are set to 1 for each
+        // character as in setSequence(X)
+        const Word init = (Word(1) << LEFT) - 1;
+        size_t je = std::min<size_t>(X.size(), WORD_SIZE - LEFT);
+        for (size_t c = 0; c < 4; c++) {
+            mv[0][c] = init | (slice(encoding, c, d, first, je) << LEFT);
+        }
+
+        // encode the remaining blocks
+        for (size_t b = 1; b < mv.size(); b++) {
+            size_t jb = WORD_SIZE - LEFT + (b - 1) * BLOCK_SIZE;
+            size_t je = std::min<size_t>(X.size(), jb + BLOCK_SIZE);
+            size_t count = (je > jb) ? je - jb : 0;
+            for (size_t c = 0; c < 4; c++) {
+                Word bits = slice(encoding, c, d, first + jb, count);
+                mv[b][c] = (mv[b - 1][c] >> BLOCK_SIZE) |
+                           (bits << (WORD_SIZE - BLOCK_SIZE));
+            }
+        }
+    }
+
     /**
      * Initialize the alignment matrix
      * @param maxED Maximum edit distance allowed during alignment
@@ -389,21 +574,21 @@ class BitParallelED {
 
         // initialize top row as [2*MAX_ED, ..., 2, 1, 0, 1, 2, ...]
         // decrease in first LEFT bits and increase in remaining bits
-        bv[0].HP = (~0ull) << LEFT;
+        bv[0].HP = (~Word(0)) << LEFT;
         bv[0].HN = ~bv[0].HP;
 
         // correct top row if initED has been specified
         for (size_t i = 1; i < std::min<size_t>(initED.size(), LEFT + 1); i++) {
             if (initED[i] < initED[i - 1]) {
-                bv[0].HP ^= 1ull << (LEFT - i); // set HP to 1
-                bv[0].HN ^= 1ull << (LEFT - i); // set HN to 0
+                bv[0].HP ^= Word(1) << (LEFT - i); // set HP to 1
+                bv[0].HN ^= Word(1) << (LEFT - i); // set HN to 0
             } else if (initED[i] == initED[i - 1]) {
-                bv[0].HN ^= 1ull << (LEFT - i); // set HN to 0
+                bv[0].HN ^= Word(1) << (LEFT - i); // set HN to 0
             }
         }
 
         // RAC equals the right-most active element
-        bv[0].RAC = 1ull << (DIAG_R0 + Wh);
+        bv[0].RAC = Word(1) << (DIAG_R0 + Wh);
     }
 
     /**
@@ -422,14 +607,14 @@ class BitParallelED {
         const uint l = i % BLOCK_SIZE; // leftmost relevant bit
 
         // aliases to the bit vectors of the current row i (will be computed)
-        uint64_t& HP = bv[i].HP;
-        uint64_t& HN = bv[i].HN;
+        Word& HP = bv[i].HP;
+        Word& HN = bv[i].HN;
 
-        uint64_t& D0 = bv[i].D0;
-        uint64_t& RAC = bv[i].RAC;
+        Word& D0 = bv[i].D0;
+        Word& RAC = bv[i].RAC;
 
         // select the right match vector
-        const uint64_t& M = mv[b][char2idx[Y]];
+        const Word& M = mv[b][char2idx[Y]];
 
         // copy the input vectors pertaining the previous row i-1
         HP = bv[i - 1].HP;
@@ -447,14 +632,14 @@ class BitParallelED {
         // compute the 5 bitvectors that encode the edit distance minScore
         // (Hyyro)s
         D0 = (((M & HP) + HP) ^ HP) | M | HN;
-        uint64_t VP = HN | ~(D0 | HP);
-        uint64_t VN = D0 & HP;
+        Word VP = HN | ~(D0 | HP);
+        Word VN = D0 & HP;
         HP = (VN << 1) | ~(D0 | (VP << 1));
         HN = (D0 & (VP << 1));
 
         // compute the minScore at the diagonal
         const size_t diagBit = l + DIAG_R0;
-        bv[i].score = bv[i - 1].score + (D0 & (1ull << diagBit) ? 0 : 1);
+        bv[i].score = bv[i - 1].score + (D0 & (Word(1) << diagBit) ? 0 : 1);
 
         // update the rightmost active column (Hyyro)
         // if not a match on the previous RAC, the RAC needs to be updated
@@ -465,7 +650,7 @@ class BitParallelED {
                     val--;
                 if (HN & RAC)
                     val++;
-                if (RAC == (1ull << (diagBit - Wv)))
+                if (RAC == (Word(1) << (diagBit - Wv)))
                     return false;
                 RAC >>= 1;
             }
@@ -539,8 +724,9 @@ class BitParallelED {
         initializeMatrix(score);
 
         // compute the rows
-        for (unsigned int i = 0; i < ref.size(); i++) {
-            computeRow(i + 1, ref[i]);
+        const SubstringView<FORWARD> refChars = ref.view<FORWARD>();
+        for (unsigned int i = 0; i < refChars.size(); i++) {
+            computeRow(i + 1, refChars[i]);
         }
 
         // trackback starting from the final cell
@@ -552,8 +738,10 @@ class BitParallelED {
 
         while (j > 0 || i > 0) {
             const uint b = i / BLOCK_SIZE; // block identifier
-            const uint64_t& M = mv[b][char2idx[ref[i - 1]]];
-            uint64_t bit = 1ull << ((j - b * BLOCK_SIZE) + DIAG_R0);
+            // the match vector is only needed for a diagonal step (i > 0)
+            const Word M =
+                (i > 0) ? mv[b][char2idx[refChars[i - 1]]] : Word(0);
+            Word bit = Word(1) << ((j - b * BLOCK_SIZE) + DIAG_R0);
 
             if ((j > 0) && bv[i].HP & bit) { // gap in horizontal
                 j--;
@@ -618,6 +806,7 @@ class BitParallelED {
      */
     void trackBack(const Substring& ref, const uint refEnd, uint& refBegin,
                    uint& ED, std::vector<std::pair<char, uint>>& CIGAR) const {
+        const SubstringView<FORWARD> refChars = ref.view<FORWARD>();
 
         CIGAR.clear();
         CIGAR.reserve(2 * MAX_ED + 1);
@@ -630,8 +819,10 @@ class BitParallelED {
 
         while (j > 0) {
             const uint b = i / BLOCK_SIZE; // block identifier
-            const uint64_t& M = mv[b][char2idx[ref[i - 1]]];
-            uint64_t bit = 1ull << ((j - b * BLOCK_SIZE) + DIAG_R0);
+            // the match vector is only needed for a diagonal step (i > 0)
+            const Word M =
+                (i > 0) ? mv[b][char2idx[refChars[i - 1]]] : Word(0);
+            Word bit = Word(1) << ((j - b * BLOCK_SIZE) + DIAG_R0);
 
             if (bv[i].HP & bit) { // gap in horizontal direction -> insertion
                 j--;
@@ -663,6 +854,43 @@ class BitParallelED {
         refBegin = i;
     }
 
+    /**
+     * Do backtracking to find the begin of the alignment without computing
+     * the CIGAR string, which can later be found with findCIGAR
+     * @param ref reference sequence, pattern P should be set using
+     * setSequence(P)(...)$
+     * @param refEnd End offset of the reference sequence
+     * @param refBegin Begin offset of the reference sequence (output)
+     * @param ED Edit distance score associated with this alignment (output)
+     */
+    void trackBack(const Substring& ref, const uint refEnd, uint& refBegin,
+                   uint& ED) const {
+        const SubstringView<FORWARD> refChars = ref.view<FORWARD>();
+
+        uint i = refEnd;
+        uint j = n - 1;
+        ED = operator()(i, j);
+
+        while (j > 0) {
+            const uint b = i / BLOCK_SIZE; // block identifier
+            // the match vector is only needed for a diagonal step (i > 0)
+            const Word M =
+                (i > 0) ? mv[b][char2idx[refChars[i - 1]]] : Word(0);
+            Word bit = Word(1) << ((j - b * BLOCK_SIZE) + DIAG_R0);
+
+            if (bv[i].HP & bit) { // gap in horizontal direction -> insertion
+                j--;
+            } else if ((i > 0) && ((M | ~bv[i].D0) & bit)) { // diagonal
+                i--;
+                j--;
+            } else { // gap in vertical direction
+                i--;
+            }
+        }
+
+        refBegin = i;
+    }
+
     /**
      * Operator () overloading -- this procedure is O(1)
      * @param i Row index
@@ -679,9 +907,9 @@ class BitParallelED {
         uint b = (i > j) ? bit - (i - j) + 1 : bit + 1;
         uint e = (i > j) ? bit + 1 : bit + (j - i) + 1;
 
-        uint64_t mask = ((1ull << (e - b)) - 1ull) << b;
-        int negatives = __builtin_popcountll(bv[i].HN & mask);
-        int positives = __builtin_popcountll(bv[i].HP & mask);
+        Word mask = ((Word(1) << (e - b)) - Word(1)) << b;
+        int negatives = popcount(bv[i].HN & mask);
+        int positives = popcount(bv[i].HP & mask);
 
         uint score = bv[i].score;
         score += (i > j) ? (negatives - positives) : (positives - negatives);
@@ -706,7 +934,7 @@ class BitParallelED {
         // check if all relevant bits for HN are set to 1
         size_t bb = DIAG_R0 - Wv + r + 1;
         size_t be = DIAG_R0 + n - b * BLOCK_SIZE;
-        return (((~bv[i].HN >> bb) << bb) << (64 - be)) == 0ull;
+        return (((~bv[i].HN >> bb) << bb) << (WORD_SIZE - be)) == Word(0);
     }
 
     /**
@@ -782,7 +1010,7 @@ class BitParallelED {
             for (uint j = firstCol; j <= lastCol; j++)
                 std::cout << operator()(i, j) << " ";
             std::cout << "\tRAC:" << -(int)Wv + (int)i << "/"
-                      << std::log2(bv[i].RAC) - DIAG_R0;
+                      << std::log2((double)bv[i].RAC) - DIAG_R0;
             std::cout << (onlyVerticalGapsLeft(i) ? " - true" : " - false");
             uint minScore, minJ;
             findMinimumAtRow(i, minJ, minScore);
@@ -793,6 +1021,26 @@ class BitParallelED {
     }
 
   private:
+    /**
+     * Slices consecutive bits of a nucleotide from an encoded pattern
+     * @param encoding the encoded pattern
+     * @param c the index of the nucleotide
+     * @param d the direction in which the pattern is read
+     * @param pos the first bit
+     * @param count the number of bits, at most WORD_SIZE
+     * @returns the bits [pos, pos + count) in the lowest bits of a word
+     */
+    static Word slice(const EncodedPattern& encoding, size_t c, Direction d,
+                      size_t pos, size_t count) {
+        Word bits = 0;
+        for (size_t k = 0; k < count; k += 64) {
+            bits |= Word(encoding.getBits(c, d, pos + k,
+                                          std::min<size_t>(64, count - k)))
+                    << k;
+        }
+        return bits;
+    }
+
     std::vector<char> char2idx;
 
     uint maxED; // maximum allowed edit distance
@@ -801,8 +1049,20 @@ class BitParallelED {
     uint Wv;    // vertical width of the band
     uint Wh;    // horizontal width of the band
 
-    std::vector<BitVectors> bv;              // bit vectors
-    std::vector<std::array<uint64_t, 4>> mv; // match vectors
+    std::vector<BitVectors<Word>> bv;    // bit vectors
+    std::vector<std::array<Word, 4>> mv; // match vectors
 };
 
+template <typename Word> constexpr size_t BitParallelEDT<Word>::WORD_SIZE;
+template <typename Word> constexpr size_t BitParallelEDT<Word>::BLOCK_SIZE;
+template <typename Word> constexpr size_t BitParallelEDT<Word>::MAX_ED;
+template <typename Word> constexpr size_t BitParallelEDT<Word>::LEFT;
+template <typename Word> constexpr size_t BitParallelEDT<Word>::DIAG_R0;
+
+// the matrix used by the searches, up to edit distance 10
+typedef BitParallelEDT<uint64_t> BitParallelED;
+
+// a matrix with twice the band width, for edit distances up to 20
+typedef BitParallelEDT<uint128_t> WideBitParallelED;
+
 #endif
@@ -27,10 +27,12 @@
  * using the -mpopcnt flag to enable the SSE 4.2 POPCNT instruction.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <fstream>
 #include <string.h>
+#include <thread>
 #include <vector>
 
 // ============================================================================
@@ -123,7 +125,7 @@ class Bitvec {
      * Create an index for the bitvector to support fast rank operations
      */
     void index() {
-        counts = std::vector<size_t>((bv.size() + 7) / 4, 0ull);
+        counts = std::vector<size_t>(getCountsSize(N), 0ull);
 
         size_t countL1 = 0, countL2 = 0;
         for (size_t w = 0, q = 0; w < bv.size(); w++) {
@@ -180,7 +182,7 @@ class Bitvec {
         bv.resize((N + 63) / 64);
         ifs.read((char*)bv.data(), bv.size() * sizeof(size_t));
 
-        counts.resize((bv.size() + 7) / 4);
+        counts.resize(getCountsSize(N));
         ifs.read((char*)counts.data(), counts.size() * sizeof(size_t));
     }
 
@@ -192,6 +194,30 @@ class Bitvec {
         return N;
     }
 
+    /**
+     * @returns the number of bytes used by the bitvector and its counts
+     */
+    size_t getSizeInBytes() const {
+        return (bv.capacity() + counts.capacity()) * sizeof(size_t);
+    }
+
+    /**
+     * @param N the size of a bitvector
+     * @returns the number of bytes used by a bitvector of size N and its
+     * counts
+     */
+    static size_t getSizeInBytes(size_t N) {
+        return ((N + 63) / 64 + getCountsSize(N)) * sizeof(size_t);
+    }
+
+    /**
+     * @param N the size of a bitvector
+     * @returns the number of words in the counts of a bitvector of size N
+     */
+    static size_t getCountsSize(size_t N) {
+        return ((N + 63) / 64 + 7) / 4;
+    }
+
     /**
      * Default constructor, move constructor and move assignment operator
      */
@@ -252,7 +278,7 @@ class BitvecIntl {
         memset((void*)bv, 0, numBytes);
 
         // allocate memory for the counts
-        countsSize = 2 * S * ((N + 511) / 512);
+        countsSize = getCountsSize(N);
         // numBytes must be an integral multiple of B
         numBytes = ((countsSize * sizeof(size_t) + B - 1) / B) * B;
         counts = (size_t*)aligned_alloc(B, numBytes);
@@ -301,28 +327,55 @@ class BitvecIntl {
         return Bitref(bv[w], 1ull << b);
     }
 
+    /**
+     * Create the index of the bitvector of a single character, the counts of
+     * different characters are disjoint
+     * @param c Character index [0,1,...,S[
+     */
+    void indexCharacter(size_t c) {
+        size_t countL1 = 0, countL2 = 0;
+        for (size_t w = c, q = 2 * c; w < bvSize; w += S) {
+            size_t numBits = __builtin_popcountll(bv[w]);
+            if (w % (8 * S) == c) { // store the L1 counts
+                countL1 += countL2;
+                counts[q] = countL1;
+                countL2 = numBits;
+                q += 2 * S;
+            } else { // store the L2 counts
+                size_t L2offs = 9 * ((w / S % 8) - 1);
+                counts[q + 1 - 2 * S] |= (countL2 << L2offs);
+                countL2 += numBits;
+            }
+        }
+    }
+
     /**
      * Create an index for the bitvector to support fast rank operations
+     * @param numThreads the number of threads, each indexes the bitvectors
+     * of a subset of the characters
      */
-    void index() {
+    void index(size_t numThreads = 1) {
         // reset counts to zero
         memset((void*)counts, 0, countsSize * sizeof(size_t));
 
-        for (size_t c = 0; c < S; c++) {
-            size_t countL1 = 0, countL2 = 0;
-            for (size_t w = c, q = 2 * c; w < bvSize; w += S) {
-                size_t numBits = __builtin_popcountll(bv[w]);
-                if (w % (8 * S) == c) { // store the L1 counts
-                    countL1 += countL2;
-                    counts[q] = countL1;
-                    countL2 = numBits;
-                    q += 2 * S;
-                } else { // store the L2 counts
-                    size_t L2offs = 9 * ((w / S % 8) - 1);
-                    counts[q + 1 - 2 * S] |= (countL2 << L2offs);
-                    countL2 += numBits;
-                }
+        numThreads = std::max<size_t>(1, std::min(numThreads, S));
+        if (numThreads == 1) {
+            for (size_t c = 0; c < S; c++) {
+                indexCharacter(c);
             }
+            return;
+        }
+
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < numThreads; t++) {
+            threads.emplace_back([this, t, numThreads]() {
+                for (size_t c = t; c < S; c += numThreads) {
+                    indexCharacter(c);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
         }
     }
 
@@ -378,6 +431,22 @@ class BitvecIntl {
         return N;
     }
 
+    /**
+     * @returns the number of bytes used by the bitvectors and their counts
+     */
+    size_t getSizeInBytes() const {
+        return (bvSize + countsSize) * sizeof(size_t);
+    }
+
+    /**
+     * @param N Number of bits in the interleaved bitvector per character
+     * @returns the number of words in the counts of an interleaved
+     * bitvector of size N
+     */
+    static size_t getCountsSize(size_t N) {
+        return 2 * S * ((N + 511) / 512);
+    }
+
     /**
      * Constructor
      * @param N Number of bits in the interleaved bitvector per character
@@ -582,6 +651,13 @@ class BitvecNonIntl {
         return N;
     }
 
+    /**
+     * @returns the number of bytes used by the bitvectors and their counts
+     */
+    size_t getSizeInBytes() const {
+        return (bvSize + countsSize) * sizeof(size_t);
+    }
+
     /**
      * Constructor
      * @param N Number of bits in the interleaved bitvector per character
@@ -622,4 +698,147 @@ class BitvecNonIntl {
     }
 };
 
+// ============================================================================
+// TEMPLATED STREAMING BIT VECTOR WRITER CLASS
+// ============================================================================
+
+/**
+ * Writes an (interleaved) bitvector of which the bits are produced in order
+ * to a file, without holding the bitvector in memory. The file has the
+ * layout of BitvecIntl<S>::write, or of Bitvec::write for S == 1. The words
+ * and counts are buffered and written at their offset in the file.
+ */
+template <size_t S> // S is the number of interleaved bitvectors
+class BitvecWriter {
+
+  private:
+    std::ofstream& ofs;   // output filestream
+    size_t N;             // size of the bitvector
+    size_t numGroups;     // number of words per character
+    size_t countsSize;    // number of words in the counts
+    std::streamoff bvPos; // file offset of the words
+    std::streamoff countsPos; // file offset of the counts
+
+    std::vector<size_t> bvBuffer;     // buffered words
+    std::vector<size_t> countsBuffer; // buffered counts
+    size_t bvWritten;                 // number of words written
+    size_t countsWritten;             // number of counts written
+
+    size_t group;              // number of groups of S words pushed
+    size_t countL1[S];         // 1st level count per character
+    size_t countL2[S];         // 2nd level count per character
+    size_t blockCounts[2 * S]; // counts of the current 512-bit block
+
+    /**
+     * Write the buffered words to the file
+     */
+    void flushWords() {
+        ofs.seekp(bvPos + bvWritten * sizeof(size_t));
+        ofs.write((char*)bvBuffer.data(), bvBuffer.size() * sizeof(size_t));
+        bvWritten += bvBuffer.size();
+        bvBuffer.clear();
+    }
+
+    /**
+     * Write the buffered counts to the file
+     */
+    void flushCounts() {
+        ofs.seekp(countsPos + countsWritten * sizeof(size_t));
+        ofs.write((char*)countsBuffer.data(),
+                  countsBuffer.size() * sizeof(size_t));
+        countsWritten += countsBuffer.size();
+        countsBuffer.clear();
+    }
+
+    /**
+     * Append the counts of the current block to the buffer
+     */
+    void pushBlockCounts() {
+        for (size_t i = 0; i < 2 * S; i++) {
+            countsBuffer.push_back(blockCounts[i]);
+        }
+        if (countsBuffer.size() + 2 * S > countsBuffer.capacity())
+            flushCounts();
+    }
+
+  public:
+    /**
+     * Constructor, writes the header of the bitvector at the current
+     * position of the filestream
+     * @param ofs Open output filestream
+     * @param N Number of bits in the bitvector per character
+     * @param countsSize Number of words in the counts, as given by
+     * Bitvec::getCountsSize(N) or BitvecIntl<S>::getCountsSize(N)
+     * @param bufferSize Number of words that are buffered
+     */
+    BitvecWriter(std::ofstream& ofs, size_t N, size_t countsSize,
+                 size_t bufferSize)
+        : ofs(ofs), N(N), numGroups((N + 63) / 64), countsSize(countsSize),
+          bvWritten(0), countsWritten(0), group(0) {
+        ofs.write((char*)&N, sizeof(N));
+        bvPos = ofs.tellp();
+        countsPos = bvPos + numGroups * S * sizeof(size_t);
+
+        bufferSize = std::max<size_t>(bufferSize, 8 * S);
+        bvBuffer.reserve(bufferSize);
+        countsBuffer.reserve(bufferSize / 4);
+
+        for (size_t c = 0; c < S; c++) {
+            countL1[c] = countL2[c] = 0;
+        }
+    }
+
+    /**
+     * Append the next 64 bits of each of the bitvectors
+     * @param words One word per character, bit b of word c is the bit of
+     * character c at the b-th position of the group
+     */
+    void push(const size_t* words) {
+        assert(group < numGroups);
+        for (size_t c = 0; c < S; c++) {
+            size_t numBits = __builtin_popcountll(words[c]);
+            if (group % 8 == 0) { // store the L1 counts
+                countL1[c] += countL2[c];
+                blockCounts[2 * c] = countL1[c];
+                blockCounts[2 * c + 1] = 0;
+                countL2[c] = numBits;
+            } else { // store the L2 counts
+                blockCounts[2 * c + 1] |= (countL2[c] << ((group % 8) - 1) * 9);
+                countL2[c] += numBits;
+            }
+            bvBuffer.push_back(words[c]);
+        }
+
+        if (bvBuffer.size() + S > bvBuffer.capacity())
+            flushWords();
+
+        if (++group % 8 == 0)
+            pushBlockCounts();
+    }
+
+    /**
+     * Append zero words up to the size of the bitvector, write the
+     * remaining words and counts and position the filestream after the
+     * bitvector
+     */
+    void finish() {
+        const size_t zeros[S] = {};
+        while (group < numGroups)
+            push(zeros);
+        if (group % 8 != 0)
+            pushBlockCounts();
+
+        // pad the counts with zeros
+        while (countsWritten + countsBuffer.size() < countsSize) {
+            countsBuffer.push_back(0);
+            if (countsBuffer.size() == countsBuffer.capacity())
+                flushCounts();
+        }
+
+        flushWords();
+        flushCounts();
+        ofs.seekp(countsPos + countsSize * sizeof(size_t));
+    }
+};
+
 #endif
\ No newline at end of file
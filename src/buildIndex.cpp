@@ -20,8 +20,13 @@
 #include <algorithm>
 #include <cstdio>
 #include <cstdlib>
+#include <exception>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "bwtrepr.h"
@@ -32,7 +37,23 @@ using namespace std;
 typedef uint32_t length_t;
 
 void showUsage() {
-    cout << "Usage: ./fmidx-build <base filename>\n\n";
+    cout << "Usage: ./fmidx-build [options] <base filename>\n\n";
+    cout << " [options]\n";
+    cout << "  -t  --threads\t\tnumber of threads [default = number of "
+            "cores]\n";
+    cout << "\t\t\tWith more than one thread the forward and reverse\n";
+    cout << "\t\t\tindex are built at the same time, which doubles the\n";
+    cout << "\t\t\tpeak memory usage. Use -t 1 to build them one after\n";
+    cout << "\t\t\tthe other.\n";
+    cout << "  -s  --sa-sparseness\tcomma-separated list of suffix array "
+            "sparseness\n";
+    cout << "\t\t\tfactors to build, powers of two in [1, 128], or all\n";
+    cout << "\t\t\t[default = all]\n";
+    cout << "  -m  --memory\t\tbuild in external memory within a budget of "
+            "the\n";
+    cout << "\t\t\tgiven number of MiB, the suffix arrays are streamed\n";
+    cout << "\t\t\tfrom disk and must be binary, -t is ignored\n";
+    cout << "\t\t\t[default = build in memory]\n\n";
     cout << "Following files are required:\n";
     cout << "\t<base filename>.txt: input text T\n";
     cout << "\t<base filename>.sa: suffix array of T\n";
@@ -41,11 +62,70 @@ void showUsage() {
     cout << "Report bugs to jan.fostier@ugent.be" << endl;
 }
 
-bool parseArguments(int argc, char* argv[], string& baseFN) {
-    if (argc != 2)
+/**
+ * Parses a comma-separated list of sparseness factors
+ * @param list the list, or "all" for all factors in [1, 128]
+ * @returns the sorted factors without duplicates
+ */
+vector<length_t> parseFactors(const string& list) {
+    vector<length_t> factors;
+    if (list == "all") {
+        for (length_t factor = 1; factor <= 128; factor *= 2)
+            factors.push_back(factor);
+        return factors;
+    }
+
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        size_t end = min(list.find(',', begin), list.size());
+        string token = list.substr(begin, end - begin);
+        int factor = atoi(token.c_str());
+        if (factor < 1 || factor > 128 || (factor & (factor - 1)) != 0)
+            throw runtime_error(token + " is not allowed as sparse factor, "
+                                        "should be in 2^[0, 7]");
+        factors.push_back(factor);
+        begin = end + 1;
+    }
+
+    sort(factors.begin(), factors.end());
+    factors.erase(unique(factors.begin(), factors.end()), factors.end());
+    return factors;
+}
+
+bool parseArguments(int argc, char* argv[], string& baseFN,
+                    vector<length_t>& factors, size_t& numThreads,
+                    size_t& memoryBudget) {
+    if (argc < 2)
         return false;
 
-    baseFN = argv[1];
+    for (int i = 1; i < argc - 1; i++) {
+        const string& arg = argv[i];
+        if (arg == "-t" || arg == "--threads") {
+            if (i + 1 >= argc - 1)
+                throw runtime_error(arg + " takes 1 argument as input");
+            int t = atoi(argv[++i]);
+            if (t < 1)
+                throw runtime_error("The number of threads should be at "
+                                    "least 1");
+            numThreads = t;
+        } else if (arg == "-s" || arg == "--sa-sparseness") {
+            if (i + 1 >= argc - 1)
+                throw runtime_error(arg + " takes 1 argument as input");
+            factors = parseFactors(argv[++i]);
+        } else if (arg == "-m" || arg == "--memory") {
+            if (i + 1 >= argc - 1)
+                throw runtime_error(arg + " takes 1 argument as input");
+            long long m = atoll(argv[++i]);
+            if (m < 1)
+                throw runtime_error("The memory budget should be at least "
+                                    "1 MiB");
+            memoryBudget = m << 20;
+        } else {
+            return false;
+        }
+    }
+
+    baseFN = argv[argc - 1];
     return true;
 }
 
@@ -89,14 +169,18 @@ void readSA(const string& filename, vector<length_t>& sa, size_t saSizeHint) {
     }
 }
 
-void sanityCheck(const string& T, vector<length_t>& sa) {
-    // check T for correctness
+void checkText(const string& T) {
     if (T.back() == '\n')
         throw runtime_error("T should end with a \'$\' character, "
                             "not with a newline");
 
     if (T.back() != '$')
         throw runtime_error("T should end with a \'$\' character");
+}
+
+void sanityCheck(const string& T, vector<length_t>& sa) {
+    // check T for correctness
+    checkText(T);
 
     if (sa.size() != T.size())
         throw runtime_error("Text and suffix array contain a "
@@ -133,7 +217,517 @@ void sanityCheck(const string& T, vector<length_t>& sa) {
     //      we could check T to see if the SA correctly sorts suffixes of T
 }
 
-void createFMIndex(const string& baseFN) {
+// ============================================================================
+// PARALLEL CONSTRUCTION
+// ============================================================================
+
+mutex logMutex; // keeps the messages of concurrent stages apart
+
+/**
+ * Writes a message on its own line to cout
+ * @param message the message
+ */
+void log(const string& message) {
+    lock_guard<mutex> lock(logMutex);
+    cout << message << endl;
+}
+
+/**
+ * Runs tasks on a number of threads, the tasks are divided round-robin
+ * between the threads. An exception thrown by a task is rethrown once all
+ * threads have finished.
+ * @param numTasks the number of tasks
+ * @param numThreads the number of threads, with one thread the tasks run in
+ * order on the calling thread
+ * @param task the function that runs a task, given its index
+ */
+template <typename Task>
+void runParallel(size_t numTasks, size_t numThreads, Task task) {
+    numThreads = max<size_t>(1, min(numThreads, numTasks));
+    if (numThreads == 1) {
+        for (size_t i = 0; i < numTasks; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    vector<exception_ptr> errors(numThreads);
+    vector<thread> threads;
+    for (size_t t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t]() {
+            try {
+                for (size_t i = t; i < numTasks; i += numThreads) {
+                    task(i);
+                }
+            } catch (...) {
+                errors[t] = current_exception();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+}
+
+/**
+ * Runs a function over [0, n) in equal chunks, one per thread
+ * @param n the number of elements
+ * @param numThreads the number of threads
+ * @param f the function, given the begin and end of a chunk
+ */
+template <typename Function>
+void parallelChunks(size_t n, size_t numThreads, Function f) {
+    size_t chunk = (n + numThreads - 1) / numThreads;
+    runParallel(numThreads, numThreads, [&](size_t t) {
+        f(min(n, t * chunk), min(n, (t + 1) * chunk));
+    });
+}
+
+/**
+ * Streams the samples of a sparse suffix array to disk through a large
+ * buffer, such that the file is written in few, large writes
+ */
+class SampleWriter {
+  private:
+    ofstream ofs;
+    vector<length_t> buffer;
+
+  public:
+    /**
+     * Constructor
+     * @param filename the file to write the samples to
+     * @param bufferSize the number of samples that are buffered
+     */
+    SampleWriter(const string& filename, size_t bufferSize)
+        : ofs(filename, ios::binary) {
+        if (!ofs)
+            throw runtime_error("Cannot open file: " + filename);
+        buffer.reserve(bufferSize);
+    }
+
+    /**
+     * Appends a sample, the buffer is written once it is full
+     * @param el the sample
+     */
+    void push(length_t el) {
+        buffer.push_back(el);
+        if (buffer.size() == buffer.capacity())
+            flush();
+    }
+
+    /**
+     * Writes the buffered samples to the file
+     */
+    void flush() {
+        ofs.write((char*)buffer.data(), buffer.size() * sizeof(length_t));
+        if (!ofs)
+            throw runtime_error("Cannot write sparse suffix array");
+        buffer.clear();
+    }
+};
+
+/**
+ * Creates the sparse suffix arrays of the selected sparseness factors in a
+ * single pass over the suffix array. The samples are streamed to disk during
+ * the pass, the bitvectors are indexed and written in parallel afterwards.
+ * @param baseFN the base filename of the index
+ * @param SA the suffix array
+ * @param factors the sparseness factors, sorted powers of two in [1, 128]
+ * @param numThreads the number of threads
+ */
+void writeSparseSuffixArrays(const string& baseFN, const vector<length_t>& SA,
+                             const vector<length_t>& factors,
+                             size_t numThreads) {
+    const size_t bufferSize = 1 << 20; // 4 MiB of samples per factor
+    const size_t numFactors = factors.size();
+
+    vector<int> logFactors;
+    vector<Bitvec> bitvectors;
+    vector<unique_ptr<SampleWriter>> writers;
+    for (length_t factor : factors) {
+        logFactors.push_back(__builtin_ctz(factor));
+        bitvectors.emplace_back(SA.size());
+        writers.emplace_back(new SampleWriter(
+            baseFN + ".sa." + to_string(factor), bufferSize));
+    }
+
+    for (size_t i = 0; i < SA.size(); i++) {
+        length_t el = SA[i];
+        // the entry is sampled for every factor that divides it
+        int maxK = (el == 0) ? 31 : __builtin_ctz(el);
+        for (size_t j = 0; j < numFactors && logFactors[j] <= maxK; j++) {
+            bitvectors[j][i] = true;
+            writers[j]->push(el);
+        }
+    }
+
+    for (auto& writer : writers) {
+        writer->flush();
+    }
+    writers.clear();
+
+    runParallel(numFactors, numThreads, [&](size_t j) {
+        bitvectors[j].index();
+        SparseSuffixArray::writeBitvector(baseFN, factors[j], bitvectors[j]);
+        log("Wrote sparse suffix array with factor " + to_string(factors[j]));
+        bitvectors[j] = Bitvec();
+    });
+}
+
+/**
+ * Builds the BWT, the sparse suffix arrays and the BWT representation of the
+ * text
+ * @param baseFN the base filename of the index
+ * @param T the text
+ * @param sigma the alphabet of the text
+ * @param factors the sparseness factors of the sparse suffix arrays
+ * @param numThreads the number of threads
+ */
+void buildForward(const string& baseFN, const string& T,
+                  const Alphabet<ALPHABET>& sigma,
+                  const vector<length_t>& factors, size_t numThreads) {
+    // read the suffix array
+    log("Reading " + baseFN + ".sa...");
+    vector<length_t> SA;
+    readSA(baseFN + ".sa", SA, T.size());
+
+    // perform a sanity check on the suffix array
+    log("\tPerforming sanity checks on " + baseFN + ".sa...");
+    sanityCheck(T, SA);
+    log("\tSanity checks on " + baseFN + ".sa OK");
+
+    // build the BWT
+    log("Generating BWT...");
+    string BWT(T.size(), '\0');
+    parallelChunks(SA.size(), numThreads, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++)
+            if (SA[i] > 0)
+                BWT[i] = T[SA[i] - 1];
+            else
+                BWT[i] = T.back();
+    });
+
+    ofstream ofs(baseFN + ".bwt");
+    ofs.write((char*)BWT.data(), BWT.size());
+    ofs.close();
+
+    log("Wrote file " + baseFN + ".bwt");
+
+    // create sparse suffix arrays
+    writeSparseSuffixArrays(baseFN, SA, factors, numThreads);
+    vector<length_t>().swap(SA);
+
+    // create succint BWT bitvector table
+    BWTRepr<ALPHABET> fwdBWT(sigma, BWT, numThreads);
+    fwdBWT.write(baseFN + ".brt");
+    log("Wrote file: " + baseFN + ".brt");
+}
+
+/**
+ * Builds the BWT representation of the reverse of the text
+ * @param baseFN the base filename of the index
+ * @param T the text
+ * @param sigma the alphabet of the text
+ * @param numThreads the number of threads
+ */
+void buildReverse(const string& baseFN, const string& T,
+                  const Alphabet<ALPHABET>& sigma, size_t numThreads) {
+    // read the reverse suffix array
+    log("Reading " + baseFN + ".rev.sa...");
+    vector<length_t> revSA;
+    readSA(baseFN + ".rev.sa", revSA, T.size());
+
+    // perform a sanity check on the suffix array
+    log("\tPerforming sanity checks on " + baseFN + ".rev.sa...");
+    sanityCheck(T, revSA);
+    log("\tSanity checks on " + baseFN + ".rev.sa OK");
+
+    // build the reverse BWT
+    string rBWT(T.size(), '\0');
+    parallelChunks(revSA.size(), numThreads, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++)
+            if (revSA[i] > 0)
+                rBWT[i] = T[T.size() - revSA[i]];
+            else
+                rBWT[i] = T.front();
+    });
+    vector<length_t>().swap(revSA);
+
+    // create succint reverse BWT bitvector table
+    BWTRepr<ALPHABET> revBWT(sigma, rBWT, numThreads);
+    revBWT.write(baseFN + ".rev.brt");
+    log("Wrote file: " + baseFN + ".rev.brt");
+}
+
+// ============================================================================
+// EXTERNAL-MEMORY CONSTRUCTION
+// ============================================================================
+
+/**
+ * Buffer sizes of the external-memory construction
+ */
+struct ExternalSizes {
+    size_t saChunk;     // number of suffix array entries read at once
+    size_t chars;       // number of buffered BWT characters
+    size_t samples;     // number of buffered samples per sparse suffix array
+    size_t words;       // number of buffered words per bitvector file
+};
+
+/**
+ * Divides a memory budget over the buffers of the external-memory
+ * construction. Besides the text, which needs random access, half of the
+ * remaining budget goes to the suffix array chunk and half to the output
+ * buffers.
+ * @param n the length of the text
+ * @param numFactors the number of sparse suffix arrays that are written
+ * @param budget the memory budget in bytes
+ * @returns the buffer sizes
+ */
+ExternalSizes getExternalSizes(size_t n, size_t numFactors, size_t budget) {
+    const size_t MiB = 1ull << 20;
+    // the program itself, the text and the bitvector of the sanity check
+    size_t fixed = 8 * MiB + n + Bitvec::getSizeInBytes(n);
+    if (budget < fixed + 16 * MiB)
+        throw runtime_error("A memory budget of " + to_string(budget / MiB) +
+                            " MiB is too small, the text needs at least " +
+                            to_string((fixed + 16 * MiB) / MiB) + " MiB");
+
+    size_t available = (budget - fixed) / 2;
+    // the BWT, its representation and the samples and bitvector per factor
+    size_t perStream = available / (2 + 2 * numFactors);
+
+    ExternalSizes sizes;
+    sizes.saChunk = available / sizeof(length_t);
+    sizes.chars = perStream;
+    sizes.samples = perStream / sizeof(length_t);
+    // the counts of a bitvector are buffered in a quarter of its words
+    sizes.words = perStream * 4 / 5 / sizeof(size_t);
+    return sizes;
+}
+
+/**
+ * Reads a binary suffix array from disk in chunks
+ * @param filename the file name of the suffix array
+ * @param n the number of entries in the suffix array
+ * @param chunkSize the number of entries per chunk
+ * @param f the function called with the offset and the entries of each chunk
+ */
+template <typename Function>
+void forEachSAChunk(const string& filename, size_t n, size_t chunkSize,
+                    Function f) {
+    ifstream ifs(filename, ios::binary);
+    if (!ifs)
+        throw runtime_error("Cannot open file: " + filename);
+
+    ifs.seekg(0, ios::end);
+    if ((size_t)ifs.tellg() != n * sizeof(length_t))
+        throw runtime_error(filename + " should be a binary suffix array of " +
+                            to_string(n) + " elements for the "
+                                           "external-memory construction");
+    ifs.seekg(0, ios::beg);
+
+    vector<length_t> chunk;
+    chunk.reserve(min(chunkSize, n));
+    for (size_t offset = 0; offset < n; offset += chunk.size()) {
+        chunk.resize(min(chunkSize, n - offset));
+        ifs.read((char*)chunk.data(), chunk.size() * sizeof(length_t));
+        if (!ifs)
+            throw runtime_error("Cannot read file: " + filename);
+        f(offset, chunk);
+    }
+}
+
+/**
+ * Performs the checks of sanityCheck() on a suffix array on disk, reading it
+ * in chunks
+ * @param T the text
+ * @param filename the file name of the suffix array
+ * @param chunkSize the number of entries per chunk
+ * @returns true if the suffix array is 1-based and its entries must be
+ * rebased to [0..T.size()-1]
+ */
+bool sanityCheckExternal(const string& T, const string& filename,
+                         size_t chunkSize) {
+    checkText(T);
+
+    // briefly check the suffix array
+    length_t min = numeric_limits<length_t>::max(), max = 0;
+    forEachSAChunk(filename, T.size(), chunkSize,
+                   [&](size_t, const vector<length_t>& chunk) {
+                       for (length_t el : chunk) {
+                           min = std::min(min, el);
+                           max = std::max(max, el);
+                       }
+                   });
+
+    bool rebase = (min == 1 && max == T.size());
+    if (rebase) { // rebase to [0..T.size()-1]
+        min--;
+        max--;
+    }
+
+    if (min != 0 || max != T.size() - 1)
+        throw runtime_error("Suffix array must contain numbers between "
+                            "[0 and " +
+                            to_string(T.size() - 1) + "]");
+
+    // check if all numbers in the suffix array are present
+    Bitvec bv(T.size());
+    forEachSAChunk(filename, T.size(), chunkSize,
+                   [&](size_t, const vector<length_t>& chunk) {
+                       for (length_t el : chunk)
+                           bv[el - rebase] = true;
+                   });
+
+    for (size_t i = 0; i < bv.size(); i++)
+        if (!bv[i])
+            throw runtime_error("Suffix " + to_string(i) +
+                                " seems "
+                                "to be missing from suffix array");
+
+    return rebase;
+}
+
+/**
+ * Builds the BWT, the sparse suffix arrays and the BWT representation of the
+ * text in a single pass over the suffix array on disk. All files are written
+ * incrementally.
+ * @param baseFN the base filename of the index
+ * @param T the text
+ * @param sigma the alphabet of the text
+ * @param factors the sparseness factors of the sparse suffix arrays
+ * @param sizes the buffer sizes
+ */
+void buildForwardExternal(const string& baseFN, const string& T,
+                          const Alphabet<ALPHABET>& sigma,
+                          const vector<length_t>& factors,
+                          const ExternalSizes& sizes) {
+    const size_t n = T.size();
+
+    // perform a sanity check on the suffix array
+    cout << "\tPerforming sanity checks on " << baseFN << ".sa..." << endl;
+    bool rebase = sanityCheckExternal(T, baseFN + ".sa", sizes.saChunk);
+    cout << "\tSanity checks on " << baseFN << ".sa OK" << endl;
+
+    cout << "Generating BWT and sparse suffix arrays..." << endl;
+    ofstream bwtOfs(baseFN + ".bwt", ios::binary);
+    if (!bwtOfs)
+        throw runtime_error("Cannot open file: " + baseFN + ".bwt");
+    string bwtBuffer;
+    bwtBuffer.reserve(sizes.chars);
+
+    BWTReprWriter<ALPHABET> fwdBWT(sigma, n, baseFN + ".brt", sizes.words);
+
+    vector<int> logFactors;
+    vector<unique_ptr<SampleWriter>> sampleWriters;
+    vector<unique_ptr<ofstream>> bvFiles;
+    vector<unique_ptr<BitvecWriter<1>>> bvWriters;
+    vector<size_t> bvWords(factors.size(), 0);
+    for (length_t factor : factors) {
+        logFactors.push_back(__builtin_ctz(factor));
+        sampleWriters.emplace_back(new SampleWriter(
+            baseFN + ".sa." + to_string(factor), sizes.samples));
+        string name = baseFN + ".sa.bv." + to_string(factor);
+        bvFiles.emplace_back(new ofstream(name, ios::binary));
+        if (!*bvFiles.back())
+            throw runtime_error("Cannot open file: " + name);
+        bvWriters.emplace_back(new BitvecWriter<1>(
+            *bvFiles.back(), n, Bitvec::getCountsSize(n), sizes.words));
+    }
+
+    forEachSAChunk(
+        baseFN + ".sa", n, sizes.saChunk,
+        [&](size_t offset, const vector<length_t>& chunk) {
+            for (size_t j = 0; j < chunk.size(); j++) {
+                size_t i = offset + j;
+                length_t el = chunk[j] - rebase;
+
+                char c = (el > 0) ? T[el - 1] : T.back();
+                bwtBuffer.push_back(c);
+                if (bwtBuffer.size() == bwtBuffer.capacity()) {
+                    bwtOfs.write(bwtBuffer.data(), bwtBuffer.size());
+                    bwtBuffer.clear();
+                }
+                fwdBWT.push(c);
+
+                // the entry is sampled for every factor that divides it
+                int maxK = (el == 0) ? 31 : __builtin_ctz(el);
+                for (size_t f = 0;
+                     f < factors.size() && logFactors[f] <= maxK; f++) {
+                    bvWords[f] |= 1ull << (i % 64);
+                    sampleWriters[f]->push(el);
+                }
+
+                if (i % 64 == 63) {
+                    for (size_t f = 0; f < factors.size(); f++) {
+                        bvWriters[f]->push(&bvWords[f]);
+                        bvWords[f] = 0;
+                    }
+                }
+            }
+        });
+
+    bwtOfs.write(bwtBuffer.data(), bwtBuffer.size());
+    bwtOfs.close();
+    if (!bwtOfs)
+        throw runtime_error("Cannot write file: " + baseFN + ".bwt");
+    cout << "Wrote file " << baseFN << ".bwt\n";
+
+    for (size_t f = 0; f < factors.size(); f++) {
+        if (n % 64 != 0)
+            bvWriters[f]->push(&bvWords[f]);
+        bvWriters[f]->finish();
+        bvFiles[f]->close();
+        if (!*bvFiles[f])
+            throw runtime_error("Cannot write sparse suffix array");
+        sampleWriters[f]->flush();
+        cout << "Wrote sparse suffix array with factor " << factors[f]
+             << endl;
+    }
+
+    fwdBWT.finish();
+    cout << "Wrote file: " << baseFN << ".brt" << endl;
+}
+
+/**
+ * Builds the BWT representation of the reverse of the text in a single pass
+ * over the reverse suffix array on disk
+ * @param baseFN the base filename of the index
+ * @param T the text
+ * @param sigma the alphabet of the text
+ * @param sizes the buffer sizes
+ */
+void buildReverseExternal(const string& baseFN, const string& T,
+                          const Alphabet<ALPHABET>& sigma,
+                          const ExternalSizes& sizes) {
+    const size_t n = T.size();
+
+    // perform a sanity check on the suffix array
+    cout << "\tPerforming sanity checks on " << baseFN << ".rev.sa..." << endl;
+    bool rebase = sanityCheckExternal(T, baseFN + ".rev.sa", sizes.saChunk);
+    cout << "\tSanity checks on " << baseFN << ".rev.sa OK" << endl;
+
+    BWTReprWriter<ALPHABET> revBWT(sigma, n, baseFN + ".rev.brt",
+                                   sizes.words);
+    forEachSAChunk(baseFN + ".rev.sa", n, sizes.saChunk,
+                   [&](size_t, const vector<length_t>& chunk) {
+                       for (length_t el : chunk) {
+                           el -= rebase;
+                           revBWT.push((el > 0) ? T[n - el] : T.front());
+                       }
+                   });
+
+    revBWT.finish();
+    cout << "Wrote file: " << baseFN << ".rev.brt" << endl;
+}
+
+void createFMIndex(const string& baseFN, const vector<length_t>& factors,
+                   size_t numThreads, size_t memoryBudget) {
     // read the text file from disk
     cout << "Reading " << baseFN << ".txt..." << endl;
     string T;
@@ -168,31 +762,6 @@ void createFMIndex(const string& baseFN) {
 
     Alphabet<ALPHABET> sigma(charCounts);
 
-    // read the suffix array
-    cout << "Reading " << baseFN << ".sa..." << endl;
-    vector<length_t> SA;
-    readSA(baseFN + ".sa", SA, T.size());
-
-    // perform a sanity check on the suffix array
-    cout << "\tPerforming sanity checks..." << endl;
-    sanityCheck(T, SA);
-    cout << "\tSanity checks OK" << endl;
-
-    // build the BWT
-    cout << "Generating BWT..." << endl;
-    string BWT(T.size(), '\0');
-    for (size_t i = 0; i < SA.size(); i++)
-        if (SA[i] > 0)
-            BWT[i] = T[SA[i] - 1];
-        else
-            BWT[i] = T.back();
-
-    ofstream ofs(baseFN + ".bwt");
-    ofs.write((char*)BWT.data(), BWT.size());
-    ofs.close();
-
-    cout << "Wrote file " << baseFN << ".bwt\n";
-
     // write the character counts table
     {
         ofstream ofs(baseFN + ".cct", ios::binary);
@@ -203,60 +772,55 @@ void createFMIndex(const string& baseFN) {
 
     cout << "Wrote file " << baseFN << ".cct\n";
 
-    // create sparse suffix arrays
-    for (int saSF = 1; saSF <= 128; saSF *= 2) {
-        SparseSuffixArray sparseSA(SA, saSF);
-        sparseSA.write(baseFN);
-        cout << "Wrote sparse suffix array with factor " << saSF << endl;
+    if (memoryBudget != 0) {
+        // stream the suffix arrays from disk, the forward and reverse index
+        // are built one after the other to stay within the budget
+        ExternalSizes sizes =
+            getExternalSizes(T.size(), factors.size(), memoryBudget);
+        cout << "Building in external memory, reading the suffix arrays in "
+             << "chunks of " << sizes.saChunk << " entries" << endl;
+        buildForwardExternal(baseFN, T, sigma, factors, sizes);
+        buildReverseExternal(baseFN, T, sigma, sizes);
+        return;
     }
-    SA.clear();
-
-    // create succint BWT bitvector table
-    BWTRepr<ALPHABET> fwdBWT(sigma, BWT);
-    fwdBWT.write(baseFN + ".brt");
-    cout << "Wrote file: " << baseFN << ".brt" << endl;
-
-    BWT.clear();
-
-    // read the reverse suffix array
-    cout << "Reading " << baseFN << ".rev.sa..." << endl;
-    vector<length_t> revSA;
-    readSA(baseFN + ".rev.sa", revSA, T.size());
-
-    // perform a sanity check on the suffix array
-    cout << "\tPerforming sanity checks..." << endl;
-    sanityCheck(T, revSA);
-    cout << "\tSanity checks OK" << endl;
 
-    // build the reverse BWT
-    string rBWT(T.size(), '\0');
-    rBWT.resize(T.size());
-    for (size_t i = 0; i < revSA.size(); i++)
-        if (revSA[i] > 0)
-            rBWT[i] = T[T.size() - revSA[i]];
-        else
-            rBWT[i] = T.front();
-    revSA.clear();
-
-    // create succint reverse BWT bitvector table
-    BWTRepr<ALPHABET> revBWT(sigma, rBWT);
-    revBWT.write(baseFN + ".rev.brt");
-    cout << "Wrote file: " << baseFN << ".rev.brt" << endl;
+    // the forward and reverse index are independent, with more than one
+    // thread they are built at the same time, each with half of the threads
+    size_t threadsPerDirection = max<size_t>(1, numThreads / 2);
+    runParallel(2, numThreads, [&](size_t direction) {
+        if (direction == 0) {
+            buildForward(baseFN, T, sigma, factors, threadsPerDirection);
+        } else {
+            buildReverse(baseFN, T, sigma, threadsPerDirection);
+        }
+    });
 }
 
 int main(int argc, char* argv[]) {
     string baseFN;
+    vector<length_t> factors = parseFactors("all");
+    size_t numThreads = max(1u, thread::hardware_concurrency());
+    size_t memoryBudget = 0; // build in memory
 
-    if (!parseArguments(argc, argv, baseFN)) {
+    try {
+        if (!parseArguments(argc, argv, baseFN, factors, numThreads,
+                            memoryBudget)) {
+            showUsage();
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception& e) {
+        cerr << "Fatal error: " << e.what() << endl;
         showUsage();
         return EXIT_FAILURE;
     }
 
     cout << "Welcome to Columba's index construction!\n";
     cout << "Alphabet size is " << ALPHABET - 1 << " + 1\n";
+    if (memoryBudget == 0)
+        cout << "Using " << numThreads << " thread(s)\n";
 
     try {
-        createFMIndex(baseFN);
+        createFMIndex(baseFN, factors, numThreads, memoryBudget);
     } catch (const std::exception& e) {
         cerr << "Fatal error: " << e.what() << endl;
         return EXIT_FAILURE;
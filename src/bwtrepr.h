@@ -21,6 +21,7 @@
 #define BWTREPR_H
 
 #include <cstdlib>
+#include <memory>
 #include <vector>
 
 #include "alphabet.h"
@@ -51,23 +52,43 @@ class BWTRepr {     // e.g. S = 5 for DNA (A,C,G,T + $)
      * Constructor
      * @param sigma Alphabet
      * @param BWT Burrows-Wheeler transformation
+     * @param numThreads the number of threads that fill and index the
+     * bitvectors
      */
-    BWTRepr(const Alphabet<S>& sigma, const std::string& BWT)
+    BWTRepr(const Alphabet<S>& sigma, const std::string& BWT,
+            size_t numThreads = 1)
         : bv(BWT.size() + 1), dollarPos(BWT.size()) {
         // The $-character (cIdx == 0) is not encoded in the bitvector.
         // Hence, use index cIdx-1 in the bitvector.
-
-        for (size_t i = 0; i < BWT.size(); i++) {
-            if (BWT[i] == '$') {
-                dollarPos = i;
-                continue;
+        auto fill = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                if (BWT[i] == '$') {
+                    dollarPos = i;
+                    continue;
+                }
+
+                for (size_t cIdx = sigma.c2i(BWT[i]); cIdx < S; cIdx++)
+                    bv(cIdx - 1, i) = true;
+            }
+        };
+
+        // the chunks are multiples of 64 positions, such that no two threads
+        // write to the same word of the bitvector
+        size_t chunk = ((BWT.size() / std::max<size_t>(1, numThreads)) + 63) /
+                       64 * 64;
+        if (numThreads <= 1 || chunk == 0) {
+            fill(0, BWT.size());
+        } else {
+            std::vector<std::thread> threads;
+            for (size_t b = 0; b < BWT.size(); b += chunk) {
+                threads.emplace_back(fill, b, std::min(b + chunk, BWT.size()));
+            }
+            for (auto& thread : threads) {
+                thread.join();
             }
-
-            for (size_t cIdx = sigma.c2i(BWT[i]); cIdx < S; cIdx++)
-                bv(cIdx - 1, i) = true;
         }
 
-        bv.index();
+        bv.index(numThreads);
     }
 
     /**
@@ -105,6 +126,20 @@ class BWTRepr {     // e.g. S = 5 for DNA (A,C,G,T + $)
                            : bv.rank(cIdx - 2, k) + ((k <= dollarPos) ? 0 : 1);
     }
 
+    /**
+     * @returns the bitvector representation of the BWT, without the '$'
+     */
+    const BitvecIntl<S - 1>& getBitvector() const {
+        return bv;
+    }
+
+    /**
+     * @returns the number of bytes used by the representation
+     */
+    size_t getSizeInBytes() const {
+        return sizeof(dollarPos) + bv.getSizeInBytes();
+    }
+
     /**
      * Write table to disk
      * @param filename File name
@@ -134,4 +169,83 @@ class BWTRepr {     // e.g. S = 5 for DNA (A,C,G,T + $)
     }
 };
 
+// ============================================================================
+// CLASS BWT REPRESENTATION WRITER
+// ============================================================================
+
+/**
+ * Writes the BWT representation of a BWT of which the characters are produced
+ * in order, without holding the BWT or its bitvectors in memory. The file is
+ * identical to the one written by BWTRepr::write.
+ */
+template <size_t S> // S is the size of the alphabet (including '$')
+class BWTReprWriter {
+
+  private:
+    const Alphabet<S>& sigma; // alphabet
+    std::ofstream ofs;        // output filestream
+    size_t dollarPos;         // position of the dollar sign
+    size_t numChars;          // number of characters pushed
+    size_t words[S - 1];      // bits of the current 64 characters
+    std::unique_ptr<BitvecWriter<S - 1>> writer; // writes the bitvectors
+
+  public:
+    /**
+     * Constructor
+     * @param sigma Alphabet
+     * @param length Length of the BWT
+     * @param filename File name
+     * @param bufferSize Number of words of the bitvectors that are buffered
+     */
+    BWTReprWriter(const Alphabet<S>& sigma, size_t length,
+                  const std::string& filename, size_t bufferSize)
+        : sigma(sigma), ofs(filename, std::ios::binary), dollarPos(length),
+          numChars(0), words() {
+        if (!ofs)
+            throw std::runtime_error("Cannot open file: " + filename);
+
+        // the position of the dollar is filled in by finish()
+        ofs.write((char*)&dollarPos, sizeof(dollarPos));
+        writer.reset(new BitvecWriter<S - 1>(
+            ofs, length + 1, BitvecIntl<S - 1>::getCountsSize(length + 1),
+            bufferSize));
+    }
+
+    /**
+     * Append the next character of the BWT
+     * @param c Character
+     */
+    void push(char c) {
+        // The $-character (cIdx == 0) is not encoded in the bitvector.
+        // Hence, use index cIdx-1 in the bitvector.
+        if (c == '$') {
+            dollarPos = numChars;
+        } else {
+            size_t bit = 1ull << (numChars % 64);
+            for (size_t cIdx = sigma.c2i(c); cIdx < S; cIdx++)
+                words[cIdx - 1] |= bit;
+        }
+
+        if (++numChars % 64 == 0) {
+            writer->push(words);
+            std::fill(words, words + S - 1, 0);
+        }
+    }
+
+    /**
+     * Write the remaining bitvectors and the position of the dollar
+     */
+    void finish() {
+        if (numChars % 64 != 0)
+            writer->push(words);
+        writer->finish();
+
+        ofs.seekp(0);
+        ofs.write((char*)&dollarPos, sizeof(dollarPos));
+        ofs.close();
+        if (!ofs)
+            throw std::runtime_error("Cannot write BWT representation");
+    }
+};
+
 #endif
\ No newline at end of file
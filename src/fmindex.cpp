@@ -18,6 +18,9 @@
  ******************************************************************************/
 #include "fmindex.h"
 
+#include <chrono>
+#include <random>
+
 using namespace std;
 
 ostream& operator<<(ostream& os, const Range& r) {
@@ -52,25 +55,45 @@ ostream& operator<<(ostream& os, const Search& obj) {
     return os;
 }
 
+// ============================================================================
+// CLASS CLUSTER
+// ============================================================================
+
+void Cluster::reportCentersAtEnd(uint lowerBound, Occurrences& occ) {
+    for (length_t i = 0; i <= lastCell; i++) {
+        if (eds[i] <= maxED && eds[i] >= lowerBound &&
+            (i == 0 || eds[i] <= eds[i - 1]) &&
+            (i == lastCell || eds[i] <= eds[i + 1])) {
+            FMOcc m;
+            nodes[i].report(m, startDepth, eds[i], true, shift);
+            if (m.isValid()) {
+                occ.addFMOcc(m);
+            }
+        }
+    }
+}
+
 // ============================================================================
 // CLASS FMIndex
 // ============================================================================
 thread_local length_t Counters::nodeCounter;
 thread_local length_t Counters::abortedInTextVerificationCounter;
 thread_local length_t Counters::totalReportedPositions;
-thread_local length_t Counters::cigarsInTextVerification;
-thread_local length_t Counters::cigarsInIndex;
+thread_local length_t Counters::inTextReported;
+thread_local length_t Counters::cigarsComputed;
 thread_local length_t Counters::inTextStarted;
-thread_local length_t Counters::usefulCigarsInText;
 thread_local length_t Counters::immediateSwitch;
 thread_local length_t Counters::approximateSearchStarted;
 
+constexpr length_t FMIndex::MAX_IN_TEXT_ED;
+
 thread_local Direction FMIndex::dir = BACKWARD;
-thread_local ExtraCharPtr FMIndex::extraChar;
-thread_local FindDiffPtr FMIndex::findDiff;
+thread_local bool FMIndex::inTextEnabled = true;
 
 thread_local vector<vector<FMPosExt>> FMIndex::stacks;
 thread_local vector<BitParallelED> FMIndex::matrices;
+thread_local vector<PartScratch> FMIndex::scratch;
+thread_local EncodedPattern FMIndex::encodedPattern;
 
 // ----------------------------------------------------------------------------
 // ROUTINES FOR ACCESSING DATA STRUCTURE
@@ -90,10 +113,37 @@ length_t FMIndex::findSA(length_t index) const {
     return sparseSA.get(index) + l;
 }
 
+vector<pair<string, size_t>> FMIndex::getMemoryUsage() const {
+    typedef decltype(table)::value_type TableEntry;
+    vector<pair<string, size_t>> usage;
+    usage.emplace_back("text", text.capacity());
+    usage.emplace_back("bwt", bwt.capacity());
+    usage.emplace_back("counts", counts.capacity() * sizeof(length_t));
+    usage.emplace_back("sparseSA", sparseSA.getSizeInBytes());
+    usage.emplace_back("fwdRepr", fwdRepr.getSizeInBytes());
+    usage.emplace_back("revRepr", revRepr.getSizeInBytes());
+    // a sparse hash map stores its entries densely and about 2.7 bits of
+    // bookkeeping per bucket
+    usage.emplace_back("table", table.size() * sizeof(TableEntry) +
+                                    table.bucket_count() / 3);
+    return usage;
+}
+
 // ----------------------------------------------------------------------------
 // ROUTINES FOR INITIALIZATION
 // ----------------------------------------------------------------------------
 
+length_t FMIndex::findSparsestSA(const string& baseFile) {
+    for (length_t sf = 256; sf >= 1; sf /= 2) {
+        ifstream sa(baseFile + ".sa." + to_string(sf));
+        ifstream bv(baseFile + ".sa.bv." + to_string(sf));
+        if (sa && bv) {
+            return sf;
+        }
+    }
+    return 0;
+}
+
 void FMIndex::fromFiles(const string& baseFile, bool verbose) {
     if (verbose) {
 
@@ -204,6 +254,95 @@ void FMIndex::populateTable(bool verbose) {
     }
 }
 
+void FMIndex::calibrateInTextSwitch(bool verbose) {
+    typedef chrono::steady_clock Clock;
+    const length_t numSamples = 1 << 14; // number of timed samples
+    const length_t walkLength = 12;      // nodes per walk in the index
+    const length_t patternLength = 100;  // pattern size of the alignments
+    const length_t maxED = 4;            // distance of the alignments
+
+    adaptiveSwitch = true;
+    switchModel.textLength = textLength;
+    if (textLength < 4 * patternLength) {
+        if (verbose) {
+            cout << "Text too short to calibrate the in-text switch, using "
+                    "default costs"
+                 << endl;
+        }
+        return;
+    }
+
+    mt19937 rng(42);
+    uniform_int_distribution<length_t> textDist(0,
+                                                textLength - 2 * patternLength);
+    uniform_int_distribution<length_t> saDist(0, bwt.size() - 1);
+    vector<length_t> textPos(numSamples), saPos(numSamples);
+    for (length_t i = 0; i < numSamples; i++) {
+        textPos[i] = textDist(rng);
+        saPos[i] = saDist(rng);
+    }
+    length_t checksum = 0; // keeps the timed calls from being optimized away
+
+    // A) a look-up in the suffix array, the number of LF steps it takes
+    // depends on the sparseness factor
+    auto start = Clock::now();
+    for (length_t i = 0; i < numSamples; i++) {
+        checksum += findSA(saPos[i]);
+    }
+    chrono::duration<double, nano> elapsed = Clock::now() - start;
+    double locateCost = elapsed.count() / numSamples;
+
+    // B) a row of an alignment, the reference equals the pattern so that
+    // the alignments are never aborted
+    BitParallelED matrix;
+    length_t numRows = 0;
+    start = Clock::now();
+    for (length_t i = 0; i < numSamples / 16; i++) {
+        length_t b = textPos[i];
+        matrix.setSequence(Substring(&text, b, b + patternLength));
+        matrix.initializeMatrix(maxED);
+        for (length_t row = 1; row < matrix.getNumberOfRows(); row++) {
+            checksum += matrix.computeRow(row, text[b + row - 1]);
+        }
+        numRows += matrix.getNumberOfRows() - 1;
+    }
+    elapsed = Clock::now() - start;
+    double rowCost = elapsed.count() / numRows;
+
+    // C) a node in the index, every node that is visited is extended with
+    // all characters and adds a row to the matrix of the search
+    Counters counters;
+    length_t nodeCounter = counters.nodeCounter;
+    vector<FMPosExt> stack;
+    length_t numNodes = 0;
+    start = Clock::now();
+    for (length_t i = 0; i < numSamples; i++) {
+        SARangePair ranges = getCompleteRange();
+        for (length_t t = 0; t < walkLength && !ranges.empty(); t++) {
+            extendFMPos<FORWARD>(ranges, stack, counters, t);
+            stack.clear();
+            int c = sigma.c2i((unsigned char)text[textPos[i] + t]);
+            findRangesWithExtraChar<FORWARD>(c, ranges, ranges);
+            numNodes++;
+        }
+    }
+    elapsed = Clock::now() - start;
+    counters.nodeCounter = nodeCounter;
+    double nodeCost = elapsed.count() / numNodes + rowCost;
+
+    switchModel.locateCost = locateCost;
+    switchModel.rowCost = rowCost;
+    switchModel.nodeCost = nodeCost;
+
+    if (verbose) {
+        cout << "Calibrated in-text switch: look-up " << locateCost
+             << " ns, node " << nodeCost << " ns, row " << rowCost << " ns"
+             << endl;
+    }
+    volatile length_t sink = checksum;
+    (void)sink;
+}
+
 // ----------------------------------------------------------------------------
 // ROUTINES FOR EXACT PATTERN MATCHING
 // ----------------------------------------------------------------------------
@@ -261,28 +400,62 @@ vector<length_t> FMIndex::exactMatches(const string& s,
     return positions;
 }
 
+vector<TextOcc> FMIndex::exactMatchesOutput(const string& s,
+                                            Counters& counters,
+                                            Occurrences& occ) const {
+    setDirection(BACKWARD);
+    Range range;
+    {
+        ScopedPhase scope(EXACT_SEEDING);
+        range = matchString(s, counters);
+    }
+    if (!range.empty()) {
+        // exact matches are gapless, so they are located as hamming matches
+        occ.addFMOcc(SARangePair(range, Range()), 0, s.size());
+    }
+    return occ.getTextOccurrencesHamming(*this, s.size(), counters);
+}
+
 SARangePair FMIndex::matchStringBidirectionally(const Substring& pattern,
                                                 SARangePair rangesOfPrev,
                                                 Counters& counters) const {
 
-    for (length_t i = 0; i < pattern.size(); i++) {
+    // select the directions once for the entire pattern
+    if (dir == FORWARD) {
+        return (pattern.getDirection() == FORWARD)
+                   ? matchView<FORWARD>(pattern.view<FORWARD>(), rangesOfPrev,
+                                        counters)
+                   : matchView<FORWARD>(pattern.view<BACKWARD>(),
+                                        rangesOfPrev, counters);
+    }
+    return (pattern.getDirection() == FORWARD)
+               ? matchView<BACKWARD>(pattern.view<FORWARD>(), rangesOfPrev,
+                                     counters)
+               : matchView<BACKWARD>(pattern.view<BACKWARD>(), rangesOfPrev,
+                                     counters);
+}
 
-        char c = pattern[i];
-        if (!addChar(c, rangesOfPrev, counters)) {
-            // rangesOfPrev was made empty
+template <Direction D, Direction P>
+SARangePair FMIndex::matchView(const SubstringView<P>& pattern,
+                               SARangePair ranges, Counters& counters) const {
+    for (length_t i = 0; i < pattern.size(); i++) {
+        if (!addChar<D>(pattern[i], ranges, counters)) {
+            // ranges was made empty
             break;
         }
     }
-
-    return rangesOfPrev;
+    return ranges;
 }
+
+template <Direction D>
 bool FMIndex::addChar(const char& c, SARangePair& startRange,
                       Counters& counters) const {
 
     int posInAlphabet = sigma.c2i((unsigned char)c);
     if (posInAlphabet > -1) {
 
-        if ((this->*extraChar)(posInAlphabet, startRange, startRange)) {
+        if (findRangesWithExtraChar<D>(posInAlphabet, startRange,
+                                       startRange)) {
             // each character that we look at is a new node that is visited
             counters.nodeCounter++;
             return true;
@@ -293,59 +466,96 @@ bool FMIndex::addChar(const char& c, SARangePair& startRange,
     return false;
 }
 
+bool FMIndex::addChar(const char& c, SARangePair& startRange,
+                      Counters& counters) const {
+    return (dir == FORWARD) ? addChar<FORWARD>(c, startRange, counters)
+                            : addChar<BACKWARD>(c, startRange, counters);
+}
+
 // ----------------------------------------------------------------------------
 // ROUTINES FOR APPROXIMATE PATTERN MATCHING
 // ----------------------------------------------------------------------------
 
 vector<TextOcc> FMIndex::approxMatchesNaive(const string& pattern,
-                                            length_t maxED,
-                                            Counters& counters) {
+                                            length_t maxED, Counters& counters,
+                                            Occurrences& occurrences) const {
 
     counters.resetCounters();
-    Occurrences occurrences;
 
-    BandMatrix matrix(pattern.size() + maxED + 1, maxED);
+    // the wide matrix is only needed for distances the 64-bit one cannot hold
+    if (maxED > BitParallelED::MAX_ED) {
+        WideBitParallelED bpMatrix;
+        naiveSearch(pattern, maxED, occurrences, counters, bpMatrix);
+        return occurrences.getUniqueTextOccurrences(*this, maxED, bpMatrix,
+                                                    counters);
+    }
+
+    BitParallelED bpMatrix;
+    naiveSearch(pattern, maxED, occurrences, counters, bpMatrix);
+
+    return occurrences.getUniqueTextOccurrences(*this, maxED, bpMatrix,
+                                                counters);
+}
+
+vector<length_t> FMIndex::countApproxNaive(const string& pattern,
+                                           length_t maxED,
+                                           Counters& counters) const {
+    counters.resetCounters();
+    CigarArena cigars;
+    Occurrences occurrences(cigars, false);
+
+    if (maxED > BitParallelED::MAX_ED) {
+        WideBitParallelED bpMatrix;
+        naiveSearch(pattern, maxED, occurrences, counters, bpMatrix);
+    } else {
+        BitParallelED bpMatrix;
+        naiveSearch(pattern, maxED, occurrences, counters, bpMatrix);
+    }
+
+    return occurrences.getCounts(maxED);
+}
+
+template <typename Matrix>
+void FMIndex::naiveSearch(const string& pattern, length_t maxED,
+                          Occurrences& occurrences, Counters& counters,
+                          Matrix& matrix) const {
+    ScopedPhase scope(APPROXIMATE_SEARCH);
+
+    encodePattern(pattern);
+    matrix.setSequence(Substring(pattern), encodedPattern);
+    matrix.initializeMatrix(maxED);
+    const length_t lastCol = matrix.getNumberOfCols() - 1;
 
     setDirection(FORWARD);
 
     vector<FMPosExt> stack;
     stack.reserve((pattern.size() + maxED + 1) * (sigma.size() - 1));
 
-    extendFMPos(getCompleteRange(), stack, counters, 0);
+    extendFMPos<FORWARD>(getCompleteRange(), stack, counters, 0);
 
     while (!stack.empty()) {
         const FMPosExt currentNode = stack.back();
         stack.pop_back();
-        int row = currentNode.getDepth();
-        length_t first = matrix.getFirstColumn(row);
-        length_t last = matrix.getLastColumn(row);
-        length_t minimalED = maxED + 1;
-        for (length_t j = first; j <= last; j++) {
-            matrix.updateMatrix(currentNode.getCharacter() != pattern[j - 1],
-                                row, j);
-            minimalED = min(minimalED, matrix(row, j));
-        }
+        const length_t row = currentNode.getDepth();
 
-        if (minimalED > maxED) {
-            // backtrack
+        if (!matrix.computeRow(row, currentNode.getCharacter())) {
+            // all values on this row exceed maxED -> backtrack
             continue;
         }
 
-        if (last == (length_t)matrix.getLastColumn()) {
+        if (matrix.getLastColumn(row) == lastCol) {
             // full pattern was matched
-            if (matrix(row, last) <= maxED) {
-                occurrences.addFMOcc(currentNode, matrix(row, last));
+            length_t ED = matrix(row, lastCol);
+            if (ED <= maxED) {
+                occurrences.addFMOcc(currentNode, ED);
             }
         }
 
-        extendFMPos(currentNode, stack, counters);
+        if (row + 1 < matrix.getNumberOfRows()) {
+            extendFMPos<FORWARD>(currentNode.getRanges(), stack, counters,
+                                 row);
+        }
     }
-
-    BitParallelED bpMatrix;
-    bpMatrix.setSequence(pattern);
-
-    return occurrences.getUniqueTextOccurrences(*this, maxED, bpMatrix,
-                                                counters);
 }
 
 bool FMIndex::findRangesWithExtraCharBackward(
@@ -424,12 +634,38 @@ bool FMIndex::findRangesWithExtraCharForward(length_t positionInAlphabet,
     return !childRanges.empty();
 }
 
-void FMIndex::recApproxMatchEditNaive(const Search& s, const FMOcc& startMatch,
+/**
+ * Annotates the span of a part of a search
+ * @param span the span of the part
+ * @param s a search that processes the part
+ * @param idx the index of the part in the search
+ * @param startMatch the match the part starts from
+ * @param counters the performance counters
+ */
+static void tracePart(TraceSpan& span, const Search& s, length_t idx,
+                      const FMOcc& startMatch, Counters& counters) {
+    if (span.isActive()) {
+        span.arg("part", s.getPart(idx));
+        span.arg("phase", idx);
+        span.arg("lowerBound", s.getLowerBound(idx));
+        span.arg("upperBound", s.getUpperBound(idx));
+        span.arg("width", startMatch.getRanges().width());
+        span.track("nodes", counters.nodeCounter);
+    }
+}
+
+void FMIndex::recApproxMatchEditNaive(const PhaseNode& phase,
+                                      const FMOcc& startMatch,
                                       Occurrences& occ,
                                       const vector<Substring>& parts,
                                       BitParallelED& inTextMatrix,
-                                      Counters& counters, const int& idx) {
-    const Substring& p = parts[s.getPart(idx)];           // this part
+                                      Counters& counters,
+                                      const int& idx) const {
+    const Search& s = phase.getSearch();
+    TraceSpan span("part", "search");
+    tracePart(span, s, idx, startMatch, counters);
+
+    const Substring p = s.getDirectedPart(parts, idx);    // this part
     const length_t& maxED = s.getUpperBound(idx);         // maxED for this part
     const length_t& minED = s.getLowerBound(idx);         // minED for this part
     const length_t& W = maxED - startMatch.getDistance(); // Width of matrix
@@ -444,13 +680,15 @@ void FMIndex::recApproxMatchEditNaive(const Search& s, const FMOcc& startMatch,
                          startMatch.getDepth());
         } else {
             // go to the next index
-            recApproxMatchEditNaive(
-                s,
-                FMOcc(startMatch.getRanges(), matrix(0, pSize),
-                      startMatch.getDepth()),
-                occ, parts, inTextMatrix, counters, idx + 1);
-            // set direction correct again
-            setDirection(dir);
+            for (const PhaseNode& next : phase.getChildren()) {
+                recApproxMatchEditNaive(
+                    next,
+                    FMOcc(startMatch.getRanges(), matrix(0, pSize),
+                          startMatch.getDepth()),
+                    occ, parts, inTextMatrix, counters, idx + 1);
+                // set direction correct again
+                setDirection(dir);
+            }
         }
     }
 
@@ -491,13 +729,15 @@ void FMIndex::recApproxMatchEditNaive(const Search& s, const FMOcc& startMatch,
             } else {
                 // go deeper in search
                 Direction originalDir = dir;
-                recApproxMatchEditNaive(
-                    s,
-                    FMOcc(currentNode.getRanges(), matrix(row, pSize),
-                          startMatch.getDepth() + currentNode.getDepth()),
-                    occ, parts, inTextMatrix, counters, idx + 1);
-                // set direction correct again
-                setDirection(originalDir);
+                for (const PhaseNode& next : phase.getChildren()) {
+                    recApproxMatchEditNaive(
+                        next,
+                        FMOcc(currentNode.getRanges(), matrix(row, pSize),
+                              startMatch.getDepth() + currentNode.getDepth()),
+                        occ, parts, inTextMatrix, counters, idx + 1);
+                    // set direction correct again
+                    setDirection(originalDir);
+                }
             }
         }
         if (firstCol == pSize) {
@@ -511,40 +751,47 @@ void FMIndex::recApproxMatchEditNaive(const Search& s, const FMOcc& startMatch,
 }
 
 void FMIndex::recApproxMatchEditOptimized(
-    BitParallelED& intextMatrix, const Search& s, const FMOcc& startMatch,
-    Occurrences& occ, const vector<Substring>& parts, Counters& counters,
-    const int& idx, const vector<FMPosExt>& descPrevDir,
-    const vector<uint>& initPrevDir, const vector<FMPosExt>& descNotPrevDir,
-    const vector<uint>& initNotPrevDir) {
+    BitParallelED& intextMatrix, const PhaseNode& phase,
+    const FMOcc& startMatch, Occurrences& occ, const vector<Substring>& parts,
+    Counters& counters,
+    const int& idx, const ArrayView<FMPosExt>& descPrevDir,
+    const ArrayView<uint>& initPrevDir,
+    const ArrayView<FMPosExt>& descNotPrevDir,
+    const ArrayView<uint>& initNotPrevDir) const {
 
     // shortcut Variables
-    const Substring& p = parts[s.getPart(idx)];      // this part
+    const Search& s = phase.getSearch();             // a search of this phase
+    TraceSpan span("part", "search");
+    tracePart(span, s, idx, startMatch, counters);
+    const Substring p = s.getDirectedPart(parts, idx); // this part
     const length_t& maxED = s.getUpperBound(idx);    // maxED for this part
     const Direction& dir = s.getDirection(idx);      // direction
     const bool& dSwitch = s.getDirectionSwitch(idx); // has direction switched?
     auto& stack = stacks[idx];                       // stack for this partition
     size_t matrixIdx = s.getPart(idx) + (dir == BACKWARD) * s.getNumParts();
     BitParallelED& bpED = matrices[matrixIdx]; // matrix for this partition
+    PartScratch& buffers = scratch[idx]; // scratch space for this partition
 
     // get the correct initED and descendants based on switch
-    const vector<uint>& initEds = dSwitch ? initNotPrevDir : initPrevDir;
-    const vector<FMPosExt>& descendants =
+    const ArrayView<uint>& initEds = dSwitch ? initNotPrevDir : initPrevDir;
+    const ArrayView<FMPosExt>& descendants =
         dSwitch ? descNotPrevDir : descPrevDir;
-    const vector<uint>& initOther = dSwitch ? initPrevDir : initNotPrevDir;
-    const vector<FMPosExt>& descOther = dSwitch ? descPrevDir : descNotPrevDir;
+    const ArrayView<uint>& initOther = dSwitch ? initPrevDir : initNotPrevDir;
+    const ArrayView<FMPosExt>& descOther =
+        dSwitch ? descPrevDir : descNotPrevDir;
 
     // set the direction
     setDirection(dir);
 
     // calculate necessary increase for first column of bandmatrix
-    vector<uint> initED;
+    vector<uint>& initED = buffers.initED;
     if (initEds.empty()) {
-        initED = vector<uint>(1, startMatch.getDistance());
+        initED.assign(1, startMatch.getDistance());
     } else {
         uint prevED = (dSwitch ? *min_element(initEds.begin(), initEds.end())
                                : initEds[0]);
         uint increase = startMatch.getDistance() - prevED;
-        initED = vector<uint>(initEds.size());
+        initED.resize(initEds.size());
         for (size_t i = 0; i < initED.size(); i++) {
             initED[i] = initEds[i] + increase;
         }
@@ -553,14 +800,15 @@ void FMIndex::recApproxMatchEditOptimized(
     // encode the sequence of this partition in the matrix if this has not been
     // done before
     if (!bpED.sequenceSet())
-        bpED.setSequence(p);
+        bpED.setSequence(p, encodedPattern);
 
     // initialize bit-parallel matrix
     bpED.initializeMatrix(maxED, initED);
 
     // initialize matrix and cluster
-    Cluster clus(bpED.getSizeOfFinalColumn(), maxED, startMatch.getDepth(),
-                 startMatch.getShift());
+    Cluster& clus = buffers.cluster;
+    clus.reset(bpED.getSizeOfFinalColumn(), maxED, startMatch.getDepth(),
+               startMatch.getShift());
 
     if (bpED.inFinalColumn(0)) {
         // the first row is part of the final column of the banded matrix
@@ -582,10 +830,9 @@ void FMIndex::recApproxMatchEditOptimized(
              i < descendants.size() && descendants[i].getDepth() <= maxRow;
              i++) {
 
-            if (branchAndBound(
-                    intextMatrix, clus, descendants[i], s, idx, parts, occ,
-                    counters, initOther, descOther,
-                    {descendants.begin() + i + 1, descendants.end()})) {
+            if (branchAndBound(intextMatrix, clus, descendants[i], phase,
+                               idx, parts, occ, counters, initOther,
+                               descOther, descendants.suffix(i + 1))) {
                 return;
             }
         }
@@ -611,20 +858,28 @@ void FMIndex::recApproxMatchEditOptimized(
 
     bool idxZero = idx == 0;
 
+    // the state of the search that the switch to in-text verification
+    // depends on, besides the width and depth of a node
+    const length_t pSizeFull = parts.back().end();
+    const length_t budget = phase.getMaxED() - startMatch.getDistance();
+
     while (!stack.empty()) {
         const FMPosExt currentNode = stack.back();
         stack.pop_back();
 
-        if (branchAndBound(intextMatrix, clus, currentNode, s, idx, parts, occ,
-                           counters, initOther, descOther)) {
+        if (branchAndBound(intextMatrix, clus, currentNode, phase, idx, parts,
+                           occ, counters, initOther, descOther)) {
 
             continue;
         }
 
         bool lastCol = bpED.inFinalColumn(currentNode.getRow());
 
-        if (lastCol || currentNode.getRanges().width() > inTextSwitchPoint ||
-            idxZero) {
+        length_t matched = startMatch.getDepth() + currentNode.getDepth();
+        length_t remaining = (matched < pSizeFull) ? pSizeFull - matched : 0;
+        if (lastCol || idxZero ||
+            !switchToInText(currentNode.getRanges().width(), matched,
+                            remaining, budget)) {
             // continue the search for children of this node in-index
             extendFMPos(currentNode, stack, counters);
             continue;
@@ -634,7 +889,8 @@ void FMIndex::recApproxMatchEditOptimized(
         FMOcc fmocc(currentNode.getRanges(), 0,
                     startMatch.getDepth() + currentNode.getDepth(),
                     startMatch.getShift());
-        const auto& textOcc = convertToMatchesInText(fmocc);
+        vector<TextOcc>& textOcc = buffers.textOcc;
+        convertToMatchesInText(fmocc, textOcc);
 
         // find the decrease and increase as compared to partialStart
         length_t lStartDec = 0, hStartDec = 0, hStartInc = 0;
@@ -642,23 +898,35 @@ void FMIndex::recApproxMatchEditOptimized(
         length_t startBeforeThis =
             parts[s.getLowestPartProcessedBefore(idx)].begin();
 
-        (this->*findDiff)(lStartDec, hStartDec, hStartInc, startBeforeThis,
-                          s.getMaxED(), bpED, currentNode.getRow(), maxED,
-                          descOther.size(), initOther);
+        if (dir == FORWARD) {
+            findDiffStartPositionForward(
+                lStartDec, hStartDec, hStartInc, startBeforeThis,
+                phase.getMaxED(), bpED, currentNode.getRow(), maxED,
+                descOther.size(), initOther);
+        } else {
+            findDiffStartPositionBackward(
+                lStartDec, hStartDec, hStartInc, startBeforeThis,
+                phase.getMaxED(), bpED, currentNode.getRow(), maxED,
+                descOther.size(), initOther);
+        }
 
-        inTextVerification(textOcc, s.getMaxED(), s.getMinED(), intextMatrix,
-                           occ, counters, lStartDec, hStartDec, hStartInc);
+        // all searches that share this phase are verified at once
+        inTextVerification(textOcc, phase.getMaxED(), phase.getMinED(),
+                           intextMatrix, occ, counters, lStartDec, hStartDec,
+                           hStartInc);
     }
 }
 
 bool FMIndex::branchAndBound(BitParallelED& inTextMatrix, Cluster& clus,
-                             const FMPosExt& currentNode, const Search& s,
-                             const length_t& idx,
+                             const FMPosExt& currentNode,
+                             const PhaseNode& phase, const length_t& idx,
                              const vector<Substring>& parts, Occurrences& occ,
-                             Counters& counters, const vector<uint>& initOther,
-                             const vector<FMPosExt>& descOther,
-                             const vector<FMPosExt>& remainingDesc) {
+                             Counters& counters,
+                             const ArrayView<uint>& initOther,
+                             const ArrayView<FMPosExt>& descOther,
+                             const ArrayView<FMPosExt>& remainingDesc) const {
     // get the appropriate matrix
+    const Search& s = phase.getSearch();
     size_t matrixIdx = s.getPart(idx) + (dir == BACKWARD) * s.getNumParts();
     BitParallelED& bpED = matrices[matrixIdx];
 
@@ -677,7 +945,7 @@ bool FMIndex::branchAndBound(BitParallelED& inTextMatrix, Cluster& clus,
         if (!validED || bpED.onlyVerticalGapsLeft(row)) {
             // no need to further explore this branch for this part -> go to
             // next part
-            goDeeper(inTextMatrix, clus, idx + 1, s, parts, occ,
+            goDeeper(inTextMatrix, clus, idx + 1, phase, parts, occ,
                      s.getLowerBound(idx), counters, descOther, initOther,
                      remainingDesc);
             return true;
@@ -688,35 +956,32 @@ bool FMIndex::branchAndBound(BitParallelED& inTextMatrix, Cluster& clus,
 }
 
 void FMIndex::goDeeper(BitParallelED& inTextMatrix, Cluster& cluster,
-                       const length_t& nextIdx, const Search& s,
+                       const length_t& nextIdx, const PhaseNode& phase,
                        const vector<Substring>& parts, Occurrences& occ,
                        const length_t& lowerBound, Counters& counters,
-                       const vector<FMPosExt>& descOtherD,
-                       const vector<uint>& initOtherD,
-                       const vector<FMPosExt>& remainingDesc) {
+                       const ArrayView<FMPosExt>& descOtherD,
+                       const ArrayView<uint>& initOtherD,
+                       const ArrayView<FMPosExt>& remainingDesc) const {
 
-    bool isEdge = s.isEdge(nextIdx - 1);
+    bool isEdge = phase.getSearch().isEdge(nextIdx - 1);
 
     if (isEdge) {
         // if this is final piece report highest minimum (to get shortest
         // match)
         if (nextIdx == parts.size()) {
-            auto matches = cluster.reportCentersAtEnd();
-            for (const auto& match : matches) {
-                if (match.isValid() && match.getDistance() >= lowerBound) {
-                    occ.addFMOcc(match);
-                }
-            }
+            cluster.reportCentersAtEnd(lowerBound, occ);
         } else {
             FMOcc match = cluster.reportDeepestMinimum(this->dir);
             if (match.isValid() && match.getDistance() >= lowerBound) {
-                // go deeper in search
+                // go deeper in search, once for every next phase
                 Direction originalDir = this->dir;
-                recApproxMatchEditOptimized(inTextMatrix, s, match, occ, parts,
-                                            counters, nextIdx, {}, {},
-                                            descOtherD, initOtherD);
-                // set direction back again
-                setDirection(originalDir);
+                for (const PhaseNode& next : phase.getChildren()) {
+                    recApproxMatchEditOptimized(inTextMatrix, next, match, occ,
+                                                parts, counters, nextIdx, {},
+                                                {}, descOtherD, initOtherD);
+                    // set direction back again
+                    setDirection(originalDir);
+                }
             }
         }
 
@@ -724,9 +989,12 @@ void FMIndex::goDeeper(BitParallelED& inTextMatrix, Cluster& cluster,
     }
 
     // one of the later stages will return to this point, so keep track of
-    // the descendants and eds at this branch
-    vector<FMPosExt> descendants;
-    vector<uint> initEds;
+    // the descendants and eds at this branch, the partition of the next part
+    // owns them until this function returns
+    vector<FMPosExt>& descendants = scratch[nextIdx].descendants;
+    vector<uint>& initEds = scratch[nextIdx].initEds;
+    descendants.clear();
+    initEds.clear();
 
     FMOcc newMatch = cluster.getClusterCentra(lowerBound, descendants, initEds);
     if (!newMatch.isValid()) {
@@ -742,41 +1010,51 @@ void FMIndex::goDeeper(BitParallelED& inTextMatrix, Cluster& cluster,
     for (length_t i = 0; i < descendants.size(); i++) {
         descendants[i].setDepth(i + 1);
     }
-    length_t maxEDNext = s.getUpperBound(nextIdx);
 
-    // remove trailing initEds that are higher than maxEDNext
-    while (initEds.back() > maxEDNext) {
-        initEds.pop_back();
-    }
-
-    // is the next direction equal to this direction?
-    bool switchAfter = s.getDirectionSwitch(nextIdx);
+    // the descendants are shared by all next phases, only the bound and
+    // direction of the next phase can differ
+    for (const PhaseNode& next : phase.getChildren()) {
+        const Search& s = next.getSearch();
+        length_t maxEDNext = s.getUpperBound(nextIdx);
 
-    if (switchAfter) {
-        // switching direction as this is not the end of a search direction,
-        // this means we'll get back here, thus range of newmatch should be
-        // deepest point in branch
-        if (!descendants.empty()) {
-            newMatch.setRanges(descendants.back().getRanges());
-
-            //  edit distance for search in other direction should be lowest
-            //  value possible
-            newMatch.setDistance(*min_element(initEds.begin(), initEds.end()));
+        // leave out trailing initEds that are higher than maxEDNext
+        length_t numEds = initEds.size();
+        while (initEds[numEds - 1] > maxEDNext) {
+            numEds--;
         }
+        ArrayView<uint> initEdsNext(initEds.data(), initEds.data() + numEds);
+
+        // is the next direction equal to this direction?
+        bool switchAfter = s.getDirectionSwitch(nextIdx);
+
+        if (switchAfter) {
+            // switching direction as this is not the end of a search
+            // direction, this means we'll get back here, thus range of
+            // newmatch should be deepest point in branch
+            FMOcc match = newMatch;
+            if (!descendants.empty()) {
+                match.setRanges(descendants.back().getRanges());
+
+                //  edit distance for search in other direction should be
+                //  lowest value possible
+                match.setDistance(
+                    *min_element(initEdsNext.begin(), initEdsNext.end()));
+            }
 
-        Direction originalDir = this->dir;
+            Direction originalDir = this->dir;
 
-        recApproxMatchEditOptimized(inTextMatrix, s, newMatch, occ, parts,
-                                    counters, nextIdx, descendants, initEds,
-                                    descOtherD, initOtherD);
+            recApproxMatchEditOptimized(inTextMatrix, next, match, occ, parts,
+                                        counters, nextIdx, descendants,
+                                        initEdsNext, descOtherD, initOtherD);
 
-        // set direction back again
-        setDirection(originalDir);
-    } else {
-        // go deeper on next piece
-        recApproxMatchEditOptimized(inTextMatrix, s, newMatch, occ, parts,
-                                    counters, nextIdx, descendants, initEds,
-                                    descOtherD, initOtherD);
+            // set direction back again
+            setDirection(originalDir);
+        } else {
+            // go deeper on next piece
+            recApproxMatchEditOptimized(inTextMatrix, next, newMatch, occ,
+                                        parts, counters, nextIdx, descendants,
+                                        initEdsNext, descOtherD, initOtherD);
+        }
     }
 }
 
@@ -784,11 +1062,11 @@ void FMIndex::findDiffStartPositionBackward(
     length_t& lStartDec, length_t& hStartDec, length_t& hStartInc,
     const length_t& startBeforeThis, const length_t& maxED,
     const BitParallelED& bpED, const length_t& row, const length_t& maxEDPart,
-    const length_t& descOtherSize, const vector<uint>& initOther) const {
+    const length_t& descOtherSize, const ArrayView<uint>& initOther) const {
     assert(dir == BACKWARD);
     // the cluster centers of the final row
-    vector<pair<uint, uint>> centers;
-    centers.reserve(2 * maxEDPart + 1);
+    thread_local vector<pair<uint, uint>> centers;
+    centers.clear();
 
     // find the local minima
     bpED.findLocalMinimaRow(row, maxEDPart, centers);
@@ -813,7 +1091,7 @@ void FMIndex::findDiffStartPositionForward(
     length_t& lStartDec, length_t& hStartDec, length_t& hStartInc,
     const length_t& startBeforeThis, const length_t& maxED,
     const BitParallelED& bpED, const length_t& row, const length_t& maxEDPart,
-    const length_t& descOtherSize, const vector<uint>& initOther) const {
+    const length_t& descOtherSize, const ArrayView<uint>& initOther) const {
     assert(dir == FORWARD),
 
         lStartDec = 0, hStartDec = numeric_limits<length_t>::max();
@@ -861,11 +1139,19 @@ void FMIndex::inTextVerification(const vector<TextOcc>& tos,
                                  Counters& counters, const length_t& lStartDec,
                                  const length_t& hStartDec,
                                  const length_t& hStartInc) const {
+    ScopedPhase scope(IN_TEXT_VERIFICATION);
+    TraceSpan span("in-text verification", "in-text");
+    span.arg("occurrences", tos.size());
+    span.track("reported", counters.inTextReported);
 
     // initialize matrix with correct number of zeros
-    vector<uint> zeros(lStartDec - hStartDec + hStartInc + 1, 0);
+    thread_local vector<uint> zeros;
+    zeros.assign(lStartDec - hStartDec + hStartInc + 1, 0);
     intextMatrix.initializeMatrix(maxED, zeros);
 
+    // the ends of the occurrences in the reference
+    thread_local vector<uint> refEnds;
+
     counters.inTextStarted += tos.size();
     for (const auto& to : tos) {
         const length_t& partialStart = to.getRange().getBegin();
@@ -878,10 +1164,11 @@ void FMIndex::inTextVerification(const vector<TextOcc>& tos,
         Substring ref(&text, lStart, hEnd, FORWARD);
 
         // D) fill in the matrix row by row
+        const SubstringView<FORWARD> refChars = ref.view<FORWARD>();
         length_t i;
 
-        for (i = 0; i < ref.size(); i++) {
-            if (!intextMatrix.computeRow(i + 1, ref[i])) {
+        for (i = 0; i < refChars.size(); i++) {
+            if (!intextMatrix.computeRow(i + 1, refChars[i])) {
                 break;
             }
         }
@@ -892,7 +1179,7 @@ void FMIndex::inTextVerification(const vector<TextOcc>& tos,
             continue;
         }
 
-        vector<uint> refEnds;
+        refEnds.clear();
         intextMatrix.findClusterCenters(i, refEnds, maxED, minED);
 
         if (refEnds.empty()) {
@@ -900,28 +1187,32 @@ void FMIndex::inTextVerification(const vector<TextOcc>& tos,
             continue;
         }
 
-        // for each valid end -> calculate CIGAR string and report
+        // for each valid end -> find the begin and report, the CIGAR string
+        // is only calculated if this occurrence turns out to be non-redundant
         for (const auto& refEnd : refEnds) {
             length_t bestScore = maxED + 1, bestBegin = 0;
 
-            vector<pair<char, uint>> CIGAR;
-            intextMatrix.trackBack(ref, refEnd, bestBegin, bestScore, CIGAR);
-            counters.cigarsInTextVerification++;
+            intextMatrix.trackBack(ref, refEnd, bestBegin, bestScore);
+            counters.inTextReported++;
 
             // make an occurrence
             occ.addTextOcc(Range(lStart + bestBegin, lStart + refEnd),
-                           bestScore, CIGAR);
+                           bestScore);
         }
     }
 }
 
-void FMIndex::recApproxMatchHamming(const Search& s, const FMOcc& startMatch,
-                                    Occurrences& occ,
+void FMIndex::recApproxMatchHamming(const PhaseNode& phase,
+                                    const FMOcc& startMatch, Occurrences& occ,
                                     const vector<Substring>& parts,
-                                    Counters& counters, const int& idx) {
+                                    Counters& counters, const int& idx) const {
 
     // shortcut variables
-    const Substring& p = parts[s.getPart(idx)]; // the current part
+    const Search& s = phase.getSearch();        // a search of this phase
+    TraceSpan span("part", "search");
+    tracePart(span, s, idx, startMatch, counters);
+
+    const Substring p = s.getDirectedPart(parts, idx); // the current part
     const length_t& pSize = p.size();           // the size of the current part
     const Direction& d = s.getDirection(idx);   // direction of current part
     const length_t& maxED = s.getUpperBound(idx); // upper bound of current part
@@ -934,6 +1225,8 @@ void FMIndex::recApproxMatchHamming(const Search& s, const FMOcc& startMatch,
     vec[0] = startMatch.getDistance();
     // get stack for current part
     auto& stack = stacks[idx];
+    // the size of the pattern, for the switch to in-text verification
+    const length_t pSizeFull = parts.back().end();
 
     extendFMPos(startMatch.getRanges(), stack, counters);
 
@@ -941,8 +1234,12 @@ void FMIndex::recApproxMatchHamming(const Search& s, const FMOcc& startMatch,
         const FMPosExt node = stack.back();
         stack.pop_back();
 
-        if (node.getRanges().width() <= inTextSwitchPoint) {
-            inTextVerificationHamming(node, s, parts, idx, occ);
+        // the character of the node is not yet compared
+        length_t matched = startMatch.getDepth() + node.getRow() - 1;
+        length_t budget = phase.getMaxED() - vec[node.getRow() - 1];
+        if (switchToInText(node.getRanges().width(), matched,
+                           pSizeFull - matched, budget)) {
+            inTextVerificationHamming(node, phase, parts, idx, occ);
             continue;
         }
 
@@ -965,10 +1262,12 @@ void FMIndex::recApproxMatchHamming(const Search& s, const FMOcc& startMatch,
                     // end of search
                     occ.addFMOcc(match);
                 } else {
-                    // continue search
-                    recApproxMatchHamming(s, match, occ, parts, counters,
-                                          idx + 1);
-                    setDirection(s.getDirection(idx));
+                    // continue search, once for every next phase
+                    for (const PhaseNode& next : phase.getChildren()) {
+                        recApproxMatchHamming(next, match, occ, parts,
+                                              counters, idx + 1);
+                        setDirection(s.getDirection(idx));
+                    }
                 }
             }
             continue;
@@ -977,10 +1276,15 @@ void FMIndex::recApproxMatchHamming(const Search& s, const FMOcc& startMatch,
     }
 }
 
-void FMIndex::inTextVerificationHamming(const FMPosExt& node, const Search& s,
+void FMIndex::inTextVerificationHamming(const FMPosExt& node,
+                                        const PhaseNode& phase,
                                         const vector<Substring>& parts,
                                         const length_t idx,
                                         Occurrences& occ) const {
+    ScopedPhase scope(IN_TEXT_VERIFICATION);
+    TraceSpan span("in-text verification", "in-text");
+    span.arg("occurrences", node.getRanges().width());
+    const Search& s = phase.getSearch();
 
     // A) find length before and the partial occurrence
     length_t lengthBefore =
@@ -988,8 +1292,9 @@ void FMIndex::inTextVerificationHamming(const FMPosExt& node, const Search& s,
         (dir == BACKWARD) * (node.getDepth());
     length_t pSize = parts.back().end();
 
-    length_t maxEDFull = s.getMaxED();
-    length_t minEDFull = s.getMinED();
+    // all searches that share this phase are verified at once
+    length_t maxEDFull = phase.getMaxED();
+    length_t minEDFull = phase.getMinED();
 
     const Range& r = node.getRanges().getRangeSA(); // SA range of current node
 
@@ -1004,41 +1309,70 @@ void FMIndex::inTextVerificationHamming(const FMPosExt& node, const Search& s,
         // textlength
         length_t Te = min(textLength, Tb + pSize);
 
-        // Create the reference and pattern sequence
-        Substring ref(&text, Tb, Te, FORWARD);
+        // compare the reference with the pattern, a word at a time
         Substring pattern(parts[0], 0, pSize, FORWARD);
+        assert(Te - Tb == pattern.size());
+
+        length_t score = hammingDistance(text.data() + Tb, pattern.data(),
+                                         Te - Tb, maxEDFull);
+        if (score <= maxEDFull && score >= minEDFull) {
+            // in text verification succeeded
+            occ.addTextOcc(Range(Tb, Te), score);
+        }
+    }
+}
+
+void FMIndex::verifyExactPartialMatchInTextHamming(
+    const FMOcc& startMatch, const vector<Substring>& parts,
+    const length_t& beginInPattern, const length_t& maxED, Occurrences& occ,
+    Counters& counters) const {
+    ScopedPhase scope(IN_TEXT_VERIFICATION);
+    TraceSpan span("in-text verification", "in-text");
+    span.arg("occurrences", startMatch.getRanges().width());
+    span.track("reported", counters.inTextReported);
+    // Immediately switch to in-text verification
+    counters.immediateSwitch++;
 
-        assert(ref.size() == pattern.size());
+    length_t pSize = parts.back().end();
+    Substring pattern(parts[0], 0, pSize, FORWARD);
 
-        length_t score = 0;
+    const Range& r = startMatch.getRanges().getRangeSA();
+    counters.inTextStarted += r.width();
 
-        for (length_t i = 0; i < ref.size(); i++) {
-            // update the score
-            score = score + (ref[i] != pattern[i]);
-            if (score > maxEDFull) {
-                // in text verification failed
-                break;
-            }
+    for (length_t i = r.getBegin(); i < r.getEnd(); i++) {
+        // the pattern starts beginInPattern characters before the exact part
+        length_t Tb = findSA(i);
+        if (Tb < beginInPattern || Tb - beginInPattern + pSize > textLength) {
+            // the pattern does not fit in the text at this position
+            counters.abortedInTextVerificationCounter++;
+            continue;
         }
-        if (score <= maxEDFull && score >= minEDFull) {
-            // in text verification succeeded
-            vector<pair<char, uint>> CIGAR = {make_pair('M', pSize)};
-            occ.addTextOcc(Range(Tb, Te), score, CIGAR);
+        Tb -= beginInPattern;
+
+        length_t score =
+            hammingDistance(text.data() + Tb, pattern.data(), pSize, maxED);
+
+        if (score <= maxED) {
+            counters.inTextReported++;
+            occ.addTextOcc(Range(Tb, Tb + pSize), score);
+        } else {
+            counters.abortedInTextVerificationCounter++;
         }
     }
 }
 
+template <Direction D>
 void FMIndex::extendFMPos(const SARangePair& parentRanges,
                           vector<FMPosExt>& stack, Counters& counters,
                           length_t row) const {
 
-    // iterate over the entire alphabet
-    for (length_t i = 1; i < sigma.size(); i++) {
+    // iterate over the entire alphabet, its size is known at compile time
+    for (length_t i = 1; i < ALPHABET; i++) {
 
         SARangePair pairForNewChar;
 
         // check if this character occurs in the specified range
-        if ((this->*extraChar)(i, parentRanges, pairForNewChar)) {
+        if (findRangesWithExtraChar<D>(i, parentRanges, pairForNewChar)) {
             // push this range and character for the next iteration
             stack.emplace_back(sigma.i2c(i), pairForNewChar, row + 1);
 
@@ -1047,6 +1381,16 @@ void FMIndex::extendFMPos(const SARangePair& parentRanges,
     }
 }
 
+void FMIndex::extendFMPos(const SARangePair& parentRanges,
+                          vector<FMPosExt>& stack, Counters& counters,
+                          length_t row) const {
+    if (dir == FORWARD) {
+        extendFMPos<FORWARD>(parentRanges, stack, counters, row);
+    } else {
+        extendFMPos<BACKWARD>(parentRanges, stack, counters, row);
+    }
+}
+
 void FMIndex::extendFMPos(const FMPosExt& pos, vector<FMPosExt>& stack,
                           Counters& counters) const {
     extendFMPos(pos.getRanges(), stack, counters, pos.getDepth());
@@ -1056,9 +1400,13 @@ void FMIndex::extendFMPos(const FMPosExt& pos, vector<FMPosExt>& stack,
 // POST-PROCESSING ROUTINES FOR APPROXIMATE PATTERN MATCHING
 // ----------------------------------------------------------------------------
 
-vector<TextOcc> FMIndex::convertToMatchesInText(const FMOcc& saMatch) const {
+void FMIndex::convertToMatchesInText(const FMOcc& saMatch,
+                                     vector<TextOcc>& textMatches) const {
+    ScopedPhase scope(LOCATE);
+    TraceSpan span("locate", "locate");
+    span.arg("width", saMatch.getRanges().width());
 
-    vector<TextOcc> textMatches;
+    textMatches.clear();
     textMatches.reserve(saMatch.getRanges().width());
 
     for (length_t i = saMatch.getRanges().getRangeSA().getBegin();
@@ -1071,5 +1419,4 @@ vector<TextOcc> FMIndex::convertToMatchesInText(const FMOcc& saMatch) const {
         textMatches.emplace_back(Range(startPos, endPos),
                                  saMatch.getDistance());
     }
-    return textMatches;
 }
\ No newline at end of file
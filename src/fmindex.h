@@ -24,10 +24,13 @@
 #include "alphabet.h"
 #include "bandmatrix.h"
 #include "bwtrepr.h"
+#include "profiler.h"
+#include "tracer.h"
 #include "suffixArray.h"
 #include "tkmer.h"
 
 #include <algorithm> //used for sorting
+#include <cstring>   // memcpy
 #include <fstream>   // used for reading in files
 #include <iostream>  // used for printing
 #include <math.h>    //for taking the log
@@ -41,6 +44,31 @@ template <typename T> T abs_diff(T a, T b) {
     return a > b ? a - b : b - a;
 }
 
+// count the positions at which a[0, n) and b[0, n) differ, eight characters
+// per word operation, and stop once more than maxDiff differences are found
+inline length_t hammingDistance(const char* a, const char* b, length_t n,
+                                length_t maxDiff) {
+    const uint64_t low7 = 0x7F7F7F7F7F7F7F7Full; // low 7 bits of each byte
+    length_t score = 0, i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        uint64_t diff = x ^ y;
+        // the high bit of a byte is set if and only if the byte is not zero
+        uint64_t nonZero = (((diff & low7) + low7) | diff) & ~low7;
+        score += __builtin_popcountll(nonZero);
+        if (score > maxDiff) {
+            return score;
+        }
+    }
+    for (; i < n; i++) {
+        score += (a[i] != b[i]);
+    }
+    return score;
+}
+
 // ============================================================================
 // (TYPE) DEFINITIONS AND PROTOTYPES
 // ============================================================================
@@ -116,12 +144,11 @@ std::ostream& operator<<(std::ostream& output, const Range& r);
 // ============================================================================
 class TextOcc {
   private:
-    Range range;       // the range in the text
-    length_t distance; // the distance to this range (edit or hamming)
-    std::vector<std::pair<char, uint>> CIGAR; // The CIGAR string of the match
-
-    std::string output; // the corresponding output for this occurrence (for
-                        // now a custom format)
+    Range range;          // the range in the text
+    length_t distance;    // the distance to this range (edit or hamming)
+    length_t cigarOffset; // the offset of the CIGAR string in the CigarArena
+    length_t cigarLength; // the number of CIGAR operations, 0 if the CIGAR
+                          // string has not been calculated
 
   public:
     /**
@@ -131,7 +158,7 @@ class TextOcc {
      * this occurrence
      */
     TextOcc(Range range, length_t distance)
-        : range(range), distance(distance), CIGAR(), output() {
+        : range(range), distance(distance), cigarOffset(0), cigarLength(0) {
     }
 
     /**
@@ -139,33 +166,20 @@ class TextOcc {
      * @param range, the range of this occurrence in the text
      * @param distance, the (edit or hamming) distance to the mapped read of
      * this occurrence
-     * @param CIGAR the CIGAR string of the match
+     * @param cigarOffset the offset of the CIGAR string of the match in the
+     * CigarArena
+     * @param cigarLength the number of operations in the CIGAR string
      */
-    TextOcc(Range range, length_t distance,
-            std::vector<std::pair<char, uint>>& CIGAR)
-        : range(range), distance(distance), CIGAR(CIGAR), output() {
+    TextOcc(Range range, length_t distance, length_t cigarOffset,
+            length_t cigarLength)
+        : range(range), distance(distance), cigarOffset(cigarOffset),
+          cigarLength(cigarLength) {
     }
 
     /**
      * Constructor for an invalid text occurrence
      */
-    TextOcc() : range(0, 0) {
-    }
-
-    /**
-     * Generates the output of this occurrence, for now in format:
-     * startposition\twidth\tdistance\tCIGAR, where startposition is the
-     * beginning of thetext occurrence, width is the length of this occurrence,
-     * distance is the (edit or hamming) distance to the mapped read and CIGAR
-     * is the CIGAR string of the match
-     */
-    void generateOutput() {
-        output = std::to_string(range.getBegin()) + "\t" +
-                 std::to_string(range.width()) + "\t" +
-                 std::to_string(distance) + "\t";
-        for (const auto& p : CIGAR) {
-            output += std::to_string(p.second) + p.first;
-        }
+    TextOcc() : range(0, 0), distance(0), cigarOffset(0), cigarLength(0) {
     }
 
     const Range getRange() const {
@@ -175,8 +189,12 @@ class TextOcc {
         return distance;
     }
 
-    const std::string& getOutput() const {
-        return output;
+    length_t getCigarOffset() const {
+        return cigarOffset;
+    }
+
+    length_t getCigarLength() const {
+        return cigarLength;
     }
 
     /**
@@ -214,11 +232,85 @@ class TextOcc {
     }
 
     bool hasCigar() const {
-        return !CIGAR.empty();
+        return cigarLength != 0;
+    }
+
+    void setCigar(length_t offset, length_t length) {
+        cigarOffset = offset;
+        cigarLength = length;
+    }
+};
+
+// ============================================================================
+// CLASS CIGARARENA
+// ============================================================================
+
+/**
+ * Storage for the CIGAR strings of a batch of text occurrences. A text
+ * occurrence only refers to its CIGAR string by offset and length, so that it
+ * stays a plain record that can be copied without touching the heap. Clearing
+ * the arena between batches keeps the allocated memory.
+ */
+class CigarArena {
+  private:
+    std::vector<std::pair<char, uint>> ops; // the CIGAR operations
+
+  public:
+    CigarArena(length_t reserve = 0) {
+        ops.reserve(reserve);
+    }
+
+    /**
+     * Appends a CIGAR string to the arena
+     * @param CIGAR the CIGAR string
+     * @returns the offset of the CIGAR string in the arena
+     */
+    length_t add(const std::vector<std::pair<char, uint>>& CIGAR) {
+        length_t offset = ops.size();
+        ops.insert(ops.end(), CIGAR.begin(), CIGAR.end());
+        return offset;
+    }
+
+    /**
+     * Appends a CIGAR string consisting of a single operation to the arena
+     * @param op the operation
+     * @param length the number of times the operation is repeated
+     * @returns the offset of the CIGAR string in the arena
+     */
+    length_t add(char op, uint length) {
+        ops.emplace_back(op, length);
+        return ops.size() - 1;
+    }
+
+    const std::pair<char, uint>& operator[](length_t i) const {
+        return ops[i];
+    }
+
+    /**
+     * @param occ a text occurrence with its CIGAR string in this arena
+     * @returns a pointer to the first CIGAR operation of the occurrence
+     */
+    const std::pair<char, uint>* begin(const TextOcc& occ) const {
+        return ops.data() + occ.getCigarOffset();
+    }
+
+    /**
+     * @param occ a text occurrence with its CIGAR string in this arena
+     * @returns a pointer past the last CIGAR operation of the occurrence
+     */
+    const std::pair<char, uint>* end(const TextOcc& occ) const {
+        return ops.data() + occ.getCigarOffset() + occ.getCigarLength();
+    }
+
+    /**
+     * Removes all CIGAR strings, the allocated memory is kept
+     */
+    void clear() {
+        ops.clear();
     }
 
-    void setCigar(std::vector<std::pair<char, uint>>& cigar) {
-        CIGAR = cigar;
+    length_t size() const {
+        return ops.size();
     }
 };
 
@@ -524,10 +616,82 @@ class FMPosExt : public FMPos {
     }
 };
 
+// ============================================================================
+// CLASS ARRAYVIEW
+// ============================================================================
+
+/**
+ * A read-only view on a contiguous sequence of elements that are owned
+ * elsewhere. Copying a view never copies the elements, the owner must outlive
+ * the view and may not reallocate while the view is in use.
+ */
+template <class T> class ArrayView {
+  private:
+    const T* first; // pointer to the first element
+    const T* last;  // pointer past the last element
+
+  public:
+    /**
+     * Default constructor, creates an empty view
+     */
+    ArrayView() : first(nullptr), last(nullptr) {
+    }
+
+    /**
+     * Constructor
+     * @param first pointer to the first element
+     * @param last pointer past the last element
+     */
+    ArrayView(const T* first, const T* last) : first(first), last(last) {
+    }
+
+    /**
+     * Constructor, creates a view on all elements of a vector
+     * @param v the vector
+     */
+    ArrayView(const std::vector<T>& v)
+        : first(v.data()), last(v.data() + v.size()) {
+    }
+
+    length_t size() const {
+        return last - first;
+    }
+
+    bool empty() const {
+        return first == last;
+    }
+
+    const T& operator[](length_t i) const {
+        return first[i];
+    }
+
+    const T& back() const {
+        return *(last - 1);
+    }
+
+    const T* begin() const {
+        return first;
+    }
+
+    const T* end() const {
+        return last;
+    }
+
+    /**
+     * @param i the index of the first element of the suffix
+     * @returns a view on the elements from index i onwards
+     */
+    ArrayView suffix(length_t i) const {
+        return ArrayView(first + i, last);
+    }
+};
+
 // ============================================================================
 // CLASS CLUSTER
 // ============================================================================
 
+class Occurrences;
+
 class Cluster {
   private:
     std::vector<uint> eds;       // the edit distances of this cluster
@@ -552,6 +716,30 @@ class Cluster {
           startDepth(startDepth), shift(shift) {
     }
 
+    /**
+     * Default constructor, creates an empty cluster
+     */
+    Cluster() : lastCell(-1), maxED(0), startDepth(0), shift(0) {
+    }
+
+    /**
+     * Empties the cluster and gives it new dimensions, the allocated memory
+     * is kept
+     * @param size, the size of the cluster
+     * @param maxED, the maximal allowed edit distance
+     * @param startDepth, the depth before this cluster
+     * @param shift, the right shift of the occurrences in the text
+     */
+    void reset(length_t size, length_t maxED, length_t startDepth,
+               length_t shift) {
+        eds.assign(size, maxED + 1);
+        nodes.assign(size, FMPosExt());
+        lastCell = -1;
+        this->maxED = maxED;
+        this->startDepth = startDepth;
+        this->shift = shift;
+    }
+
     /**
      * Sets the ed and node at index idx to ed and node. Also updates
      * lastCell to be idx
@@ -573,28 +761,15 @@ class Cluster {
     }
 
     /**
-     * @returns vector with all nodes in the cluster that are a centre and
-     * under the maximal allowed distance, be aware that if there are
+     * Adds all nodes in the cluster that are a centre and under the maximal
+     * allowed distance to the occurrences, be aware that if there are
      * multiple centers in the cluster it is very likely that only one of
      * them will be redundant, but the others might eliminate another
      * occurrence
+     * @param lowerBound, only centres with at least this distance are added
+     * @param occ, the occurrences to add the centres to
      */
-    std::vector<FMOcc> reportCentersAtEnd() {
-
-        std::vector<FMOcc> centers;
-        centers.reserve(lastCell + 1);
-
-        for (length_t i = 0; i <= lastCell; i++) {
-            if (eds[i] <= maxED && (i == 0 || eds[i] <= eds[i - 1]) &&
-                (i == lastCell || eds[i] <= eds[i + 1])) {
-                FMOcc m;
-                nodes[i].report(m, startDepth, eds[i], true, shift);
-                centers.emplace_back(m);
-            }
-        }
-
-        return centers;
-    }
+    void reportCentersAtEnd(uint lowerBound, Occurrences& occ);
 
     /**
      * @returns approximate match that corresponds to the ranges of the
@@ -635,19 +810,17 @@ class Cluster {
      * is lower than the lower bound will be updated in the initEds vector
      * @param lowerBound, the lower bound for this iteration
      * @param desc, the descendants of the highest cluster centre, these
-     * will be inserted during the method
+     * will be appended during the method
      * @param initEds, the initialization eds for the next iteration, these
      * correspond to the eds of the highest centre and its descendants,
      * where eds part of a cluster of which the centre is below the
-     * lower bound are updated. These values will be inserted during the
-     * method
+     * lower bound are updated. These values will be appended during the
+     * method, the vector must be empty on entry
      * @returns The occurrence corresponding to the upper cluster centre
      * which has a valid distance
      */
     FMOcc getClusterCentra(uint lowerBound, std::vector<FMPosExt>& desc,
                            std::vector<uint>& initEds) {
-        desc.reserve(eds.size());
-        initEds.reserve(eds.size());
         FMOcc m;
         for (length_t i = 0; i <= lastCell; i++) {
             if (eds[i] > maxED || eds[i] < lowerBound) {
@@ -854,6 +1027,20 @@ class Search {
         }
     }
 
+    /**
+     * Gets the part of a phase in the direction of that phase. Searches that
+     * share the phases before idx can process this part in another
+     * direction, so the direction stored in the part is not relied upon.
+     * @param parts, the parts of the pattern
+     * @param idx, the index of the phase
+     * @returns the part of phase idx in the direction of phase idx
+     */
+    Substring getDirectedPart(const std::vector<Substring>& parts,
+                              length_t idx) const {
+        const Substring& part = parts[order[idx]];
+        return Substring(part, part.begin(), part.end(), directions[idx]);
+    }
+
     /**
      * @returns the lower bound for the idx'th part
      */
@@ -985,6 +1172,153 @@ class Search {
  */
 std::ostream& operator<<(std::ostream& os, const Search& obj);
 
+// ============================================================================
+// CLASS PHASENODE
+// ============================================================================
+
+/**
+ * A node in the prefix tree of the searches of a search scheme. Each node is a
+ * phase (part, direction and bounds) that is shared by all searches that
+ * process the same phases up to and including this one, so the index is only
+ * explored once for such a shared prefix. The children of a node are the
+ * distinct next phases of these searches.
+ */
+class PhaseNode {
+  private:
+    const Search* search; // a search through this node, its phases up to
+                          // this node are those of all searches through it
+    length_t idx;         // the index of this phase in the searches
+    length_t minED; // the lowest minimal distance of the searches through
+                    // this node
+    length_t maxED; // the highest maximal distance of the searches through
+                    // this node
+    std::vector<PhaseNode> children; // the distinct next phases
+
+    /**
+     * Checks if a search processes the phase of this node in the same way
+     * @param s the search to check, it must share all previous phases
+     */
+    bool sharedBy(const Search& s) const {
+        return s.getPart(idx) == search->getPart(idx) &&
+               s.getDirection(idx) == search->getDirection(idx) &&
+               s.getLowerBound(idx) == search->getLowerBound(idx) &&
+               s.getUpperBound(idx) == search->getUpperBound(idx);
+    }
+
+    /**
+     * Adds the phases of a search from phase idx onwards to a level of the
+     * tree
+     * @param nodes the nodes of phase idx that share the previous phases of s
+     * @param s the search to add
+     * @param idx the phase to add
+     */
+    static void addSearch(std::vector<PhaseNode>& nodes, const Search& s,
+                          length_t idx) {
+        for (PhaseNode& node : nodes) {
+            if (node.sharedBy(s)) {
+                node.minED = std::min(node.minED, s.getMinED());
+                node.maxED = std::max(node.maxED, s.getMaxED());
+                if (!s.isEnd(idx)) {
+                    addSearch(node.children, s, idx + 1);
+                }
+                return;
+            }
+        }
+        nodes.emplace_back(s, idx);
+        if (!s.isEnd(idx)) {
+            addSearch(nodes.back().children, s, idx + 1);
+        }
+    }
+
+  public:
+    /**
+     * Constructor, creates a node without children
+     * @param s the search that follows this phase
+     * @param idx the index of the phase in the search
+     */
+    PhaseNode(const Search& s, length_t idx)
+        : search(&s), idx(idx), minED(s.getMinED()), maxED(s.getMaxED()) {
+    }
+
+    /**
+     * Merges the searches of a scheme into a prefix tree. The searches must
+     * outlive the tree.
+     * @param searches the searches of the scheme
+     * @param roots the first phases of the searches (output)
+     */
+    static void createTree(const std::vector<Search>& searches,
+                           std::vector<PhaseNode>& roots) {
+        roots.clear();
+        for (const Search& s : searches) {
+            addSearch(roots, s, 0);
+        }
+    }
+
+    /**
+     * @returns a search through this node, only its phases up to and
+     * including this one are shared by all searches through this node
+     */
+    const Search& getSearch() const {
+        return *search;
+    }
+
+    /**
+     * @returns the index of this phase in the searches
+     */
+    length_t getPhase() const {
+        return idx;
+    }
+
+    /**
+     * @returns the lowest minimal distance of the searches through this node
+     */
+    length_t getMinED() const {
+        return minED;
+    }
+
+    /**
+     * @returns the highest maximal distance of the searches through this
+     * node
+     */
+    length_t getMaxED() const {
+        return maxED;
+    }
+
+    const std::vector<PhaseNode>& getChildren() const {
+        return children;
+    }
+};
+
+// ============================================================================
+// STRUCT COUNTERSNAPSHOT
+// ============================================================================
+// The values of the performance counters at some point in time
+struct CounterSnapshot {
+    length_t nodeCounter = 0;
+    length_t totalReportedPositions = 0;
+    length_t cigarsComputed = 0;
+    length_t inTextStarted = 0;
+    length_t abortedInTextVerificationCounter = 0;
+    length_t inTextReported = 0;
+    length_t immediateSwitch = 0;
+    length_t approximateSearchStarted = 0;
+
+    /**
+     * Adds the values of another snapshot to this snapshot
+     * @param o the other snapshot
+     */
+    void add(const CounterSnapshot& o) {
+        nodeCounter += o.nodeCounter;
+        totalReportedPositions += o.totalReportedPositions;
+        cigarsComputed += o.cigarsComputed;
+        inTextStarted += o.inTextStarted;
+        abortedInTextVerificationCounter += o.abortedInTextVerificationCounter;
+        inTextReported += o.inTextReported;
+        immediateSwitch += o.immediateSwitch;
+        approximateSearchStarted += o.approximateSearchStarted;
+    }
+};
+
 // ============================================================================
 // STRUCT COUNTERS
 // ============================================================================
@@ -1000,9 +1334,9 @@ struct Counters {
                                 // matching)
 
     thread_local static length_t
-        cigarsInIndex; // counts the number of cigar strings calculated for
-                       // matches in the index, note that this is only
-                       // calculated if the match is non-redundant
+        cigarsComputed; // counts the number of cigar strings calculated, note
+                        // that this is only calculated for non-redundant
+                        // matches
 
     thread_local static length_t
         inTextStarted; // counts the number of times in-text verification was
@@ -1013,15 +1347,9 @@ struct Counters {
                                           // in-text verifications
 
     thread_local static length_t
-        cigarsInTextVerification; // counts the number of cigars strings
-                                  // calculated for matches in the text, note
-                                  // that this is done for each match in the
-                                  // text as at the point of calculation it is
-                                  // not known if this match will turn out to be
-                                  // redundant
-    thread_local static length_t
-        usefulCigarsInText; // counts the number of cigar strings calculated for
-                            // non-redundant matches in the text
+        inTextReported; // counts the number of matches reported by in-text
+                        // verification, including those that later turn out
+                        // to be redundant
 
     thread_local static length_t
         immediateSwitch; // Counts the number of times the partial matches after
@@ -1036,9 +1364,145 @@ struct Counters {
      */
     void resetCounters() {
         nodeCounter = 0, abortedInTextVerificationCounter = 0,
-        totalReportedPositions = 0, cigarsInIndex = 0,
-        cigarsInTextVerification = 0, inTextStarted = 0, usefulCigarsInText = 0,
-        immediateSwitch = 0, approximateSearchStarted = 0;
+        totalReportedPositions = 0, cigarsComputed = 0, inTextReported = 0,
+        inTextStarted = 0, immediateSwitch = 0, approximateSearchStarted = 0;
+    }
+
+    /**
+     * @returns the current values of the counters
+     */
+    CounterSnapshot getSnapshot() const {
+        CounterSnapshot snapshot;
+        snapshot.nodeCounter = nodeCounter;
+        snapshot.totalReportedPositions = totalReportedPositions;
+        snapshot.cigarsComputed = cigarsComputed;
+        snapshot.inTextStarted = inTextStarted;
+        snapshot.abortedInTextVerificationCounter =
+            abortedInTextVerificationCounter;
+        snapshot.inTextReported = inTextReported;
+        snapshot.immediateSwitch = immediateSwitch;
+        snapshot.approximateSearchStarted = approximateSearchStarted;
+        return snapshot;
+    }
+
+    /**
+     * Sets the counters to the values of a snapshot
+     * @param snapshot the values to set
+     */
+    void restoreSnapshot(const CounterSnapshot& snapshot) {
+        nodeCounter = snapshot.nodeCounter;
+        totalReportedPositions = snapshot.totalReportedPositions;
+        cigarsComputed = snapshot.cigarsComputed;
+        inTextStarted = snapshot.inTextStarted;
+        abortedInTextVerificationCounter =
+            snapshot.abortedInTextVerificationCounter;
+        inTextReported = snapshot.inTextReported;
+        immediateSwitch = snapshot.immediateSwitch;
+        approximateSearchStarted = snapshot.approximateSearchStarted;
+    }
+};
+
+// ============================================================================
+// STRUCT SWITCHCOSTMODEL
+// ============================================================================
+
+/**
+ * A cost model for the cross-over from in-index search to in-text
+ * verification. At a node with a range of a given width, continuing in the
+ * index costs one node per distinct text prefix below the node, while
+ * switching costs one look-up in the suffix array and one alignment in the
+ * text per occurrence. The occurrences of a node are split in random hits,
+ * that are pruned a few characters deeper, and true hits, that are followed
+ * up to the end of the pattern. The costs per unit are fitted on the loaded
+ * index by FMIndex::calibrateInTextSwitch().
+ */
+struct SwitchCostModel {
+    double nodeCost = 100.0;   // ns to visit a node in the index
+    double locateCost = 500.0; // ns for a look-up in the sparse suffix array
+    double rowCost = 5.0;      // ns to compute a row of the in-text matrix
+    double textLength = 0;     // the length of the text
+
+    /**
+     * Estimates the depth below a node at which the search for a random
+     * occurrence is pruned. A random character mismatches with probability
+     * 3/4 and every mismatch consumes one error of the budget.
+     * @param remaining the number of characters of the pattern left to match
+     * @param budget the number of errors that can still be made
+     * @returns the expected depth of the search below the node
+     */
+    static length_t expectedDepth(length_t remaining, length_t budget) {
+        return std::min(remaining + budget, (4 * (budget + 1) + 2) / 3);
+    }
+
+    /**
+     * Estimates the number of occurrences of a node that are random hits
+     * @param width the width of the range of the node
+     * @param matched the number of characters of the pattern already matched
+     * @returns the expected number of random hits among the occurrences
+     */
+    double randomHits(length_t width, length_t matched) const {
+        // a string of length l occurs n / 4^l times in a random text
+        return std::min((double)width, ldexp(textLength, -2 * (int)matched));
+    }
+
+    /**
+     * Estimates the cost of continuing the search in the index
+     * @param width the width of the range of the node
+     * @param matched the number of characters of the pattern already matched
+     * @param remaining the number of characters of the pattern left to match
+     * @param budget the number of errors that can still be made
+     * @returns the expected cost in ns
+     */
+    double inIndexCost(length_t width, length_t matched, length_t remaining,
+                       length_t budget) const {
+        double random = randomHits(width, matched), hits = width - random;
+
+        // at depth t the random hits have at most min(random, 4^t) distinct
+        // prefixes
+        length_t depth = expectedDepth(remaining, budget);
+        double nodes = 0, prefixes = 1;
+        for (length_t t = 1; t <= depth; t++) {
+            prefixes = std::min(prefixes * 4, random);
+            nodes += prefixes;
+        }
+        // the true hits branch off at most once per error, they are located
+        // at the end of the search
+        nodes += (remaining + budget) * std::min(hits, (double)budget + 1);
+        return nodeCost * nodes + locateCost * hits;
+    }
+
+    /**
+     * Estimates the cost of verifying the occurrences of a node in the text
+     * @param width the width of the range of the node
+     * @param matched the number of characters of the pattern already matched
+     * @param remaining the number of characters of the pattern left to match
+     * @param budget the number of errors that can still be made
+     * @returns the expected cost in ns
+     */
+    double inTextCost(length_t width, length_t matched, length_t remaining,
+                      length_t budget) const {
+        double random = randomHits(width, matched), hits = width - random;
+
+        // the alignment of a random hit is aborted after the expected depth,
+        // the alignment of a true hit covers the entire pattern
+        double rows =
+            random * (std::min(remaining, expectedDepth(remaining, budget))) +
+            hits * remaining + width * (matched + budget);
+        return width * locateCost + rowCost * rows;
+    }
+
+    /**
+     * @param width the width of the range of the node
+     * @param matched the number of characters of the pattern already matched
+     * @param remaining the number of characters of the pattern left to match
+     * @param budget the number of errors that can still be made
+     * @returns true if verifying the occurrences in the text is expected to
+     * be cheaper than continuing the search in the index
+     */
+    bool inTextIsCheaper(length_t width, length_t matched, length_t remaining,
+                         length_t budget) const {
+        return inTextCost(width, matched, remaining, budget) <=
+               inIndexCost(width, matched, remaining, budget);
     }
 };
 
@@ -1047,14 +1511,19 @@ struct Counters {
 // ============================================================================
 class Occurrences;
 class FMIndex;
-typedef bool (FMIndex::*ExtraCharPtr)(length_t, const SARangePair&,
-                                      SARangePair&) const;
 
-typedef void (FMIndex::*FindDiffPtr)(length_t&, length_t&, length_t&,
-                                     const length_t&, const length_t&,
-                                     const BitParallelED&, const length_t&,
-                                     const length_t&, const length_t&,
-                                     const std::vector<uint>&) const;
+/**
+ * The scratch space of the optimized edit distance search for one partition.
+ * It is kept per thread and reused for every read, so that once the buffers
+ * have grown to their working size the recursive search no longer allocates.
+ */
+struct PartScratch {
+    Cluster cluster;           // the cluster of the final column of the matrix
+    std::vector<uint> initED;  // the first column of the matrix
+    std::vector<FMPosExt> descendants; // descendants handed to this partition
+    std::vector<uint> initEds;         // initialization eds of descendants
+    std::vector<TextOcc> textOcc; // in-text occurrences of a crossing-over
+};
 
 class FMIndex {
   private:
@@ -1079,19 +1548,26 @@ class FMIndex {
 
     // in-text verification
     length_t inTextSwitchPoint = 5;
+    bool adaptiveSwitch = false; // true if switchModel decides the switch
+    SwitchCostModel switchModel; // the cost model of the adaptive switch
+    thread_local static bool inTextEnabled; // false if the searches on this
+                                            // thread must stay in the index
+
+    friend class MicroBench; // times the primitives of the index in isolation
+    friend class IndexStats; // probes the throughput of the index
 
     // direction variables
     thread_local static Direction dir; // the direction of the index
-    thread_local static ExtraCharPtr
-        extraChar; // pointer to extra char method (for direction)
-
-    thread_local static FindDiffPtr findDiff; // pointer to correct finddiffmode
 
     // stacks for search schemes
     thread_local static std::vector<std::vector<FMPosExt>>
         stacks; // stacks of nodes for the different partitions
     thread_local static std::vector<BitParallelED>
         matrices; // alignment matrices for the different partitions
+    thread_local static std::vector<PartScratch>
+        scratch; // scratch space of the edit distance search per partition
+    thread_local static EncodedPattern
+        encodedPattern; // the pattern the matrices are sliced from
 
     // sparse hash info
     static const size_t wordSize =
@@ -1234,7 +1710,8 @@ class FMIndex {
      * met) using the edit distance metric. This function uses all
      * optimizations for eliminating redundancy in the edit distance metric
      * @param intextMatrix the bit-parallel matrix for in-text verification
-     * @param search, the search to follow
+     * @param phase, the node of the phase to match in the prefix tree of the
+     * searches
      * @param startMatch, the approximate match found for all previous
      * partitions of the search
      * @param occ, a datastructure with matches of the complete search, if  such
@@ -1253,14 +1730,14 @@ class FMIndex {
      * defaults to empty vector
      */
     void recApproxMatchEditOptimized(
-        BitParallelED& intextMatrix, const Search& search,
+        BitParallelED& intextMatrix, const PhaseNode& phase,
         const FMOcc& startMatch, Occurrences& occ,
         const std::vector<Substring>& parts, Counters& counters,
         const int& idx = 1,
-        const std::vector<FMPosExt>& descPrevDir = std::vector<FMPosExt>(),
-        const std::vector<uint>& initPrevDir = std::vector<uint>(),
-        const std::vector<FMPosExt>& descNotPrevDir = std::vector<FMPosExt>(),
-        const std::vector<uint>& initNotPrevDir = std::vector<uint>());
+        const ArrayView<FMPosExt>& descPrevDir = ArrayView<FMPosExt>(),
+        const ArrayView<uint>& initPrevDir = ArrayView<uint>(),
+        const ArrayView<FMPosExt>& descNotPrevDir = ArrayView<FMPosExt>(),
+        const ArrayView<uint>& initNotPrevDir = ArrayView<uint>()) const;
 
     /**
      * Finds the ranges of cP using the principle explained in the paper of
@@ -1286,6 +1763,52 @@ class FMIndex {
                                         const SARangePair& rangesOfP,
                                         SARangePair& childRanges) const;
 
+    /**
+     * Finds the ranges of the pattern extended with one character in a
+     * direction that is known at compile time, such that the call can be
+     * inlined
+     * @tparam D the direction in which the character is added
+     * @param positionInAlphabet the position in alphabet of the character
+     * @param rangesOfP the ranges of pattern P
+     * @param childRanges the ranges of cP (BACKWARD) or Pc (FORWARD)
+     * @returns true if the extended pattern occurs
+     */
+    template <Direction D>
+    bool findRangesWithExtraChar(length_t positionInAlphabet,
+                                 const SARangePair& rangesOfP,
+                                 SARangePair& childRanges) const {
+        return (D == FORWARD)
+                   ? findRangesWithExtraCharForward(positionInAlphabet,
+                                                    rangesOfP, childRanges)
+                   : findRangesWithExtraCharBackward(positionInAlphabet,
+                                                     rangesOfP, childRanges);
+    }
+
+    /**
+     * Adds one character in a direction that is known at compile time
+     * @tparam D the direction in which the character is added
+     * @param c the character to be added
+     * @param range the range to extend
+     * @param counters the performance counters
+     * @returns true if the extended range is not empty
+     */
+    template <Direction D>
+    bool addChar(const char& c, SARangePair& range, Counters& counters) const;
+
+    /**
+     * Matches the characters of a view exactly, in a direction of the index
+     * that is known at compile time
+     * @tparam D the direction in which the characters are added
+     * @tparam P the direction in which the characters are read
+     * @param pattern the characters to match
+     * @param ranges the ranges to start from
+     * @param counters the performance counters
+     * @returns the pair of ranges after matching the characters
+     */
+    template <Direction D, Direction P>
+    SARangePair matchView(const SubstringView<P>& pattern, SARangePair ranges,
+                          Counters& counters) const;
+
     /**
      * Goes deeper in a search if a valid approximate match is found in the
      * cluster
@@ -1293,7 +1816,8 @@ class FMIndex {
      * current pattern
      * @param cluster, the cluster to search for a valid approximate match
      * @param nextIdx, the idx of next part to research
-     * @param s, the search
+     * @param phase, the node of the current phase in the prefix tree of the
+     * searches, the search continues with each of its children
      * @param parts, the parts of the pattern
      * @param occ Datastructure with the in-index and in-text occurrences, if an
      * occurrence is found it will be added to this datastructure
@@ -1308,12 +1832,12 @@ class FMIndex {
      * be checked for the next part, defaults to an empty vector
      */
     void goDeeper(BitParallelED& intextMatrix, Cluster& cluster,
-                  const length_t& nextIdx, const Search& s,
+                  const length_t& nextIdx, const PhaseNode& phase,
                   const std::vector<Substring>& parts, Occurrences& occ,
                   const length_t& lowerBound, Counters& counters,
-                  const std::vector<FMPosExt>& descendantsOtherD = {},
-                  const std::vector<uint>& initEdsOtherD = {},
-                  const std::vector<FMPosExt>& remainingDesc = {});
+                  const ArrayView<FMPosExt>& descendantsOtherD = {},
+                  const ArrayView<uint>& initEdsOtherD = {},
+                  const ArrayView<FMPosExt>& remainingDesc = {}) const;
 
     /**
      * Helper function for the approximate matching. This function fills in
@@ -1325,7 +1849,8 @@ class FMIndex {
      * @param clus, the cluster corresponding to the final column of the
      * matrix
      * @param currentnode, the node for which the matrix is filled in
-     * @param s, the current search
+     * @param phase, the node of the current phase in the prefix tree of the
+     * searches
      * @param idx, the idx of the current part
      * @param parts, the parts of the pattern
      * @param bpEDv Vector containing an alignment matrix per part
@@ -1341,12 +1866,29 @@ class FMIndex {
      * current part, true if the search can backtrack
      */
     bool branchAndBound(BitParallelED& intextMatrix, Cluster& clus,
-                        const FMPosExt& currentNode, const Search& s,
+                        const FMPosExt& currentNode, const PhaseNode& phase,
                         const length_t& idx,
                         const std::vector<Substring>& parts, Occurrences& occ,
-                        Counters& counters, const std::vector<uint>& initOther,
-                        const std::vector<FMPosExt>& descOther,
-                        const std::vector<FMPosExt>& remainingDesc = {});
+                        Counters& counters, const ArrayView<uint>& initOther,
+                        const ArrayView<FMPosExt>& descOther,
+                        const ArrayView<FMPosExt>& remainingDesc = {}) const;
+
+    /**
+     * Naive backtracking search with a bit-parallel matrix, all occurrences
+     * are found in the index. A branch is pruned as soon as all values on its
+     * row exceed maxED.
+     * @param pattern the pattern to match
+     * @param maxED the maximum edit distance
+     * @param occurrences the occurrences, found occurrences are added to this
+     * @param counters the performance counters
+     * @param matrix the bit-parallel matrix, its words must be wide enough for
+     * maxED. Afterwards it holds the pattern, so it can be reused to find the
+     * CIGAR strings.
+     */
+    template <typename Matrix>
+    void naiveSearch(const std::string& pattern, length_t maxED,
+                     Occurrences& occurrences, Counters& counters,
+                     Matrix& matrix) const;
 
     // ----------------------------------------------------------------------------
     // IN TEXT VERIFICATION ROUTINES
@@ -1406,7 +1948,7 @@ class FMIndex {
         const length_t& startBeforeThis, const length_t& maxED,
         const BitParallelED& bpED, const length_t& row,
         const length_t& maxEDPart, const length_t& descOtherSize,
-        const std::vector<uint>& initOther) const;
+        const ArrayView<uint>& initOther) const;
 
     /**
      * Helper function, needed for in-text verification for the edit distance.
@@ -1434,20 +1976,22 @@ class FMIndex {
         const length_t& startBeforeThis, const length_t& maxED,
         const BitParallelED& bpED, const length_t& row,
         const length_t& maxEDPart, const length_t& descOtherSize,
-        const std::vector<uint>& initOther) const;
+        const ArrayView<uint>& initOther) const;
 
     /**
      * In text verification for the Hamming distance.
      * @param node the node in the index at which the switch to in-text
      * verification will happen
-     * @param s the current search
+     * @param phase the node of the current phase in the prefix tree of the
+     * searches
      * @param parts the parts of the pattern for this search
      * @param idx the current index in the search
      * @param occ Datastructure with all occurrences, both in FM Index and in
      * text. If in-text verification leads to valid text occurrences, these will
      * be added to occ
      */
-    void inTextVerificationHamming(const FMPosExt& node, const Search& s,
+    void inTextVerificationHamming(const FMPosExt& node,
+                                   const PhaseNode& phase,
                                    const std::vector<Substring>& parts,
                                    const length_t idx, Occurrences& occ) const;
     /**
@@ -1461,6 +2005,20 @@ class FMIndex {
     void extendFMPos(const SARangePair& ranges, std::vector<FMPosExt>& stack,
                      Counters& counters, length_t row = 0) const;
 
+    /**
+     * Pushes all the children corresponding to the node with ranges equal
+     * to ranges, in a direction that is known at compile time. The loop over
+     * the alphabet is then free of indirect calls.
+     * @tparam D the direction of the index
+     * @param ranges the ranges to get the children of
+     * @param stack, the stack to push the children on
+     * @param counters the performance counters
+     * @param row, the row of the parentNode
+     */
+    template <Direction D>
+    void extendFMPos(const SARangePair& ranges, std::vector<FMPosExt>& stack,
+                     Counters& counters, length_t row) const;
+
     /**
      * Pushes all the children corresponding to the this position
      * @param pos, the position to get the children of
@@ -1475,9 +2033,26 @@ class FMIndex {
      * @param matchInSA the match that will be converted
      * @returns a vector with the corresponding text occurrences
      */
-    std::vector<TextOcc> convertToMatchesInText(const FMOcc& matchInSA) const;
+    std::vector<TextOcc> convertToMatchesInText(const FMOcc& matchInSA) const {
+        std::vector<TextOcc> textMatches;
+        convertToMatchesInText(matchInSA, textMatches);
+        return textMatches;
+    }
+
+    /**
+     * Converts a match in the suffix array to matches in the text.
+     * @param matchInSA the match that will be converted
+     * @param textMatches the corresponding text occurrences (output), its
+     * previous content is discarded
+     */
+    void convertToMatchesInText(const FMOcc& matchInSA,
+                                std::vector<TextOcc>& textMatches) const;
 
   public:
+    // the largest edit distance for which in-text verification fits in the
+    // band of the matrix, the band grows to three times the edit distance
+    static constexpr length_t MAX_IN_TEXT_ED = 2 * BitParallelED::MAX_ED / 3;
+
     // ----------------------------------------------------------------------------
     // INITIALIZATION ROUTINES
     // ----------------------------------------------------------------------------
@@ -1492,7 +2067,8 @@ class FMIndex {
     FMIndex(const std::string& baseFile, length_t inTextSwitch,
             int sa_sparse = 1, bool verbose = true)
         : baseFile(baseFile), sparseFactorSA(sa_sparse),
-          logSparseFactorSA(log2(sa_sparse)), sparseSA(baseFile, sa_sparse),
+          logSparseFactorSA(log2(sa_sparse)),
+          sparseSA(baseFile, sa_sparse, verbose),
           inTextSwitchPoint(inTextSwitch) {
         // read in files
         fromFiles(baseFile, verbose);
@@ -1501,6 +2077,14 @@ class FMIndex {
         populateTable(verbose);
     }
 
+    /**
+     * Finds the largest sparseness factor of which the suffix array files of
+     * an index are present, the index is the fastest to load with it
+     * @param baseFile the base file of the index
+     * @returns the sparseness factor, 0 if there is none
+     */
+    static length_t findSparsestSA(const std::string& baseFile);
+
     /**
      * Get the complete range of this index
      * @returns an SARangePair with both ranges the complete range of the
@@ -1528,6 +2112,79 @@ class FMIndex {
         return inTextSwitchPoint;
     }
 
+    /**
+     * Checks whether the switch to in-text verification is decided by the
+     * calibrated cost model rather than by a fixed switch point
+     */
+    bool isSwitchAdaptive() const {
+        return adaptiveSwitch;
+    }
+
+    /**
+     * Get the cost model of the adaptive switch to in-text verification
+     */
+    const SwitchCostModel& getSwitchModel() const {
+        return switchModel;
+    }
+
+    /**
+     * Get the memory used by the components of the index: the text, the
+     * BWT, the counts, the sparse suffix array, the forward and reverse BWT
+     * representations and the k-mer table. The size of the table is an
+     * estimate.
+     * @returns the name and the number of bytes of every component
+     */
+    std::vector<std::pair<std::string, size_t>> getMemoryUsage() const;
+
+    /**
+     * Fits the cost model of the switch to in-text verification on this
+     * index by timing look-ups in the suffix array, node extensions and
+     * alignment rows, and lets the cost model decide the switch from then on.
+     * Must not be called while patterns are being matched.
+     * @param verbose if true the fitted costs are written to cout
+     */
+    void calibrateInTextSwitch(bool verbose = true);
+
+    /**
+     * Checks whether a search should switch to in-text verification for a
+     * range of a certain width. With a fixed switch point only the width
+     * matters, with the adaptive switch the cost model compares both options.
+     * @param width the width of the range
+     * @param matched the number of characters of the pattern already matched
+     * @param remaining the number of characters of the pattern left to match
+     * @param budget the number of errors that can still be made
+     * @returns true if the occurrences of the range should be verified in the
+     * text
+     */
+    bool switchToInText(length_t width, length_t matched, length_t remaining,
+                        length_t budget) const {
+        if (!inTextEnabled) {
+            return false;
+        }
+        if (!adaptiveSwitch) {
+            return width <= inTextSwitchPoint;
+        }
+        return switchModel.inTextIsCheaper(width, matched, remaining, budget);
+    }
+
+    /**
+     * Enables or disables in-text verification for the searches on the
+     * calling thread. If disabled, all occurrences are found in the index and
+     * are never located during the search.
+     * @param enabled true if in-text verification is allowed
+     */
+    void setInTextVerification(bool enabled) const {
+        inTextEnabled = enabled;
+    }
+
+    /**
+     * @returns true if in-text verification is allowed for the searches on
+     * the calling thread
+     */
+    bool isInTextVerificationEnabled() const {
+        return inTextEnabled;
+    }
+
     /**
      * @returns the wordsize of the mers stored in the table
      */
@@ -1596,25 +2253,14 @@ class FMIndex {
      * with their CIGAR string
      * @param s the string to match in the reference genome
      * @param counters the performance counters
-     * @returns a sorted vector containing the start positions of all exact
-     * substring matches of s in the reference sequence
+     * @param occ the occurrences, determines the CIGAR strings and maximal
+     * number of hits
+     * @returns a sorted vector containing the exact matches of s in the
+     * reference sequence
      */
     std::vector<TextOcc> exactMatchesOutput(const std::string& s,
-                                            Counters& counters) {
-        setDirection(BACKWARD);
-        const auto& positions = exactMatches(s, counters);
-
-        length_t length = s.size();
-        // create CIGAR string of all matches
-        std::vector<std::pair<char, uint>> CIGAR(1, {'M', length});
-        std::vector<TextOcc> textOccurrences;
-        // Create text occurrences and set CIGAR string
-        for (const auto p : positions) {
-            textOccurrences.emplace_back(Range(p, p + length), 0, CIGAR);
-            textOccurrences.back().generateOutput();
-        }
-        return textOccurrences;
-    }
+                                            Counters& counters,
+                                            Occurrences& occ) const;
 
     /**
      * This function matches a string exactly and returns the ranges in the
@@ -1660,18 +2306,46 @@ class FMIndex {
      * @param number, the number of stacks required
      * @param size, the size of the pattern
      */
-    void reserveStacks(const length_t number, const length_t size) {
+    void reserveStacks(const length_t number, const length_t size) const {
         stacks.resize(number);
         length_t stackSize = size * sigma.size();
         for (auto& stack : stacks) {
             stack.reserve(stackSize);
         }
     }
+    /**
+     * Makes sure there is scratch space for the edit distance search of each
+     * partition, existing scratch space and its memory are kept
+     * @param number the number of partitions
+     */
+    void reserveScratch(const length_t number) const {
+        if (scratch.size() < number) {
+            scratch.resize(number);
+        }
+    }
+
+    /**
+     * Encodes the pattern that is currently searched. The matrices of the
+     * partitions are sliced from this encoding, so it must be set before the
+     * search starts.
+     * @param pattern the pattern, the parts must be substrings of it
+     */
+    void encodePattern(const std::string& pattern) const {
+        encodedPattern.encode(pattern);
+    }
+
+    /**
+     * @returns the encoding of the pattern that is currently searched
+     */
+    const EncodedPattern& getEncodedPattern() const {
+        return encodedPattern;
+    }
+
     /**
      * Reset the in-text matrices to be empty matrices
      * @param number the number of partitions
      */
-    void resetMatrices(const length_t number) {
+    void resetMatrices(const length_t number) const {
         matrices.resize(2 * number);
 
         for (auto& matrix : matrices) {
@@ -1689,29 +2363,42 @@ class FMIndex {
      * @param pattern the pattern to match
      * @param maxED the maximum edit distance
      * @param counters the performance counters
+     * @param occ the occurrences, determines the CIGAR strings and maximal
+     * number of hits
      * @returns a vector with matches which contain a range (the range of
      * the text that matched) and the edit distance this substring is away
      * from the pattern
      */
     std::vector<TextOcc> approxMatchesNaive(const std::string& pattern,
-                                            length_t maxED, Counters& counters);
+                                            length_t maxED, Counters& counters,
+                                            Occurrences& occ) const;
+
+    /**
+     * Counts the approximate occurrences of the pattern per edit distance
+     * with a naive backtracking search, the occurrences are never located
+     * @param pattern the pattern to match
+     * @param maxED the maximum edit distance
+     * @param counters the performance counters
+     * @returns a vector with at index d the number of occurrences at edit
+     * distance d
+     */
+    std::vector<length_t> countApproxNaive(const std::string& pattern,
+                                           length_t maxED,
+                                           Counters& counters) const;
 
     /**
      * Sets the search direction of the fm-index
      * @param d the direction to search in, either FORWARD or BACKWARD
      */
-    void setDirection(Direction d) {
+    void setDirection(Direction d) const {
         dir = d;
-        extraChar = (d == FORWARD) ? &FMIndex::findRangesWithExtraCharForward
-                                   : &FMIndex::findRangesWithExtraCharBackward;
-        findDiff = (d == FORWARD) ? &FMIndex::findDiffStartPositionForward
-                                  : &FMIndex::findDiffStartPositionBackward;
     }
     /**
      * Matches a search recursively with a depth first approach (each branch
      * of the tree is fully examined until the backtracking condition is
      * met) using hamming distance metric
-     * @param search, the search to follow
+     * @param phase, the node of the phase to match in the prefix tree of the
+     * searches
      * @param startMatch, the approximate match found for all previous parts
      * of the search
      * @param occ, a datastructure with matches of the complete search, if  such
@@ -1720,17 +2407,18 @@ class FMIndex {
      * @param idx, the index of the partition to match, defaults to 1 as an
      * exact search for the zeroth part is assumed
      */
-    void recApproxMatchHamming(const Search& s, const FMOcc& startMatch,
+    void recApproxMatchHamming(const PhaseNode& phase, const FMOcc& startMatch,
                                Occurrences& occ,
                                const std::vector<Substring>& parts,
-                               Counters& counters, const int& idx = 1);
+                               Counters& counters, const int& idx = 1) const;
 
     /**
      * Entry to the recusive approximate matching procedure for the edit
      * distance
      * @param intextMatrix the matrix for in-text verification, setSequence MUST
      * have been called before this function
-     * @param search, the search to follow
+     * @param phase, the node of the phase to match in the prefix tree of the
+     * searches
      * @param startMatch the match containing the SA ranges corresponding to
      * the match of the first part of the search
      * @param occ, a datastructure with matches of the complete search, if  such
@@ -1741,24 +2429,30 @@ class FMIndex {
      * exact search for the zeroth partition is assumed
      */
     void recApproxMatchEditOptimizedEntry(BitParallelED& intextMatrix,
-                                          const Search& search,
+                                          const PhaseNode& phase,
                                           const FMOcc& startMatch,
                                           Occurrences& occ,
                                           const std::vector<Substring>& parts,
                                           Counters& counters,
-                                          const int& idx = 1) {
-
-        if (startMatch.getRanges().width() > inTextSwitchPoint) {
+                                          const int& idx = 1) const {
+
+        // the depth in the text can exceed the matched part of the pattern
+        length_t matched = startMatch.getDepth();
+        length_t pSize = parts.back().end();
+        length_t remaining = (matched < pSize) ? pSize - matched : 0;
+        length_t budget = phase.getMaxED() - startMatch.getDistance();
+        if (!switchToInText(startMatch.getRanges().width(), matched, remaining,
+                            budget)) {
             counters.approximateSearchStarted++;
-            recApproxMatchEditOptimized(intextMatrix, search, startMatch, occ,
+            recApproxMatchEditOptimized(intextMatrix, phase, startMatch, occ,
                                         parts, counters, idx);
             return;
         }
         // verify the partial match in text
         verifyExactPartialMatchInText(
             intextMatrix, startMatch,
-            parts[search.getLowestPartProcessedBefore(idx)].begin(),
-            search.getMaxED(), occ, counters);
+            parts[phase.getSearch().getLowestPartProcessedBefore(idx)].begin(),
+            phase.getMaxED(), occ, counters);
     }
 
     /**
@@ -1779,7 +2473,8 @@ class FMIndex {
                                        const FMOcc& startMatch,
                                        const length_t& beginInPattern,
                                        const length_t& maxED, Occurrences& occ,
-                                       Counters& counters) {
+                                       Counters& counters) const {
+        ScopedPhase scope(IN_TEXT_VERIFICATION);
         // Immediately switch to in-text verification
         counters.immediateSwitch++;
 
@@ -1794,6 +2489,24 @@ class FMIndex {
         inTextVerification(to, maxED, 0, intextMatrix, occ, counters, lStartDec,
                            hStartDec, hStartInc);
     }
+
+    /**
+     * Verifies an exact partial match in the text for all occurrences of that
+     * exact partial match using the hamming distance
+     * @param startMatch the match containing the SA ranges corresponding to
+     * this exact match and depth of the exact match
+     * @param parts the parts of the pattern
+     * @param beginInPattern the begin position of the exact part in the pattern
+     * to be searched
+     * @param maxED the maximal allowed hamming distance
+     * @param occ the occurrences, to this vector new in-text verified
+     * occurrences can be added during the function
+     * @param counters the performace counters
+     */
+    void verifyExactPartialMatchInTextHamming(
+        const FMOcc& startMatch, const std::vector<Substring>& parts,
+        const length_t& beginInPattern, const length_t& maxED,
+        Occurrences& occ, Counters& counters) const;
     /**
      * Matches a search recursively with a depth first approach (each branch
      * of the tree is fully examined until the backtracking condition is
@@ -1802,7 +2515,8 @@ class FMIndex {
      * It simply matches the current part starting from startrange and each
      * node found that has an edit distance between the lower and upper
      * bound is used to start a search for the next part
-     * @param search, the search to follow
+     * @param phase, the node of the phase to match in the prefix tree of the
+     * searches
      * @param startMatch, the approximate match found for all previous
      * partitions of the search
      * @param occ, a datastructure with matches of the complete search, if
@@ -1812,11 +2526,11 @@ class FMIndex {
      * @param idx, the index of the partition to match, defaults to 1 as an
      * exact search for the zeroth partition is assumed
      */
-    void recApproxMatchEditNaive(const Search& s, const FMOcc& startMatch,
-                                 Occurrences& occ,
+    void recApproxMatchEditNaive(const PhaseNode& phase,
+                                 const FMOcc& startMatch, Occurrences& occ,
                                  const std::vector<Substring>& parts,
                                  BitParallelED& inTextMatrix,
-                                 Counters& counters, const int& idx);
+                                 Counters& counters, const int& idx) const;
     // ----------------------------------------------------------------------------
     // POST-PROCESSING ROUTINES FOR APPROXIMATE MATCHING
     // ----------------------------------------------------------------------------
@@ -1849,6 +2563,43 @@ class FMIndex {
     }
 };
 
+// ============================================================================
+// CLASS ScopedInTextVerification
+// ============================================================================
+
+/**
+ * Enables or disables in-text verification on the calling thread for as long
+ * as it is in scope, the previous setting is restored on exit, also if an
+ * exception is thrown
+ */
+class ScopedInTextVerification {
+  private:
+    const FMIndex& index; // the index whose setting is changed
+    bool previous;        // the setting to restore
+
+  public:
+    /**
+     * Constructor, changes the setting
+     * @param index the index
+     * @param enabled true if in-text verification is allowed
+     */
+    ScopedInTextVerification(const FMIndex& index, bool enabled)
+        : index(index), previous(index.isInTextVerificationEnabled()) {
+        index.setInTextVerification(enabled);
+    }
+
+    /**
+     * Destructor, restores the previous setting
+     */
+    ~ScopedInTextVerification() {
+        index.setInTextVerification(previous);
+    }
+
+    ScopedInTextVerification(const ScopedInTextVerification&) = delete;
+    ScopedInTextVerification&
+    operator=(const ScopedInTextVerification&) = delete;
+};
+
 // ============================================================================
 // CLASS Occurrences
 // ============================================================================
@@ -1858,6 +2609,261 @@ class Occurrences {
   private:
     std::vector<TextOcc> inTextOcc; // the in-text occurrences
     std::vector<FMOcc> inFMOcc;     // the in-index occurrences
+    CigarArena& cigars; // the arena in which the CIGAR strings are stored
+    bool generateCigars; // calculate the CIGAR strings of the unique
+                         // occurrences
+    length_t maxHits;    // the maximal number of occurrences that are located,
+                         // 0 if there is no maximum
+    bool sampleRepeats;  // report a sample of the occurrences of a repetitive
+                         // pattern instead of none
+    length_t hits = 0; // the number of occurrences as counted in count mode,
+                       // only counted if there is a maximal number of hits
+
+    /**
+     * Collapses the in-index occurrences as in count mode: of the occurrences
+     * with the same shift, nested SA ranges are only counted once, at their
+     * lowest distance. Sorts the in-index occurrences on distance.
+     * @param visit called with every in-index occurrence that holds SA rows
+     * that were not counted before, and the sorted, disjoint SA ranges nested
+     * in it that were counted before
+     */
+    template <typename Visit> void collapseFMOcc(Visit visit) {
+        eraseDoublesFM();
+        // process the occurrences from low to high distance, such that SA rows
+        // that are already counted are skipped at a higher distance
+        std::stable_sort(inFMOcc.begin(), inFMOcc.end(),
+                         [](const FMOcc& a, const FMOcc& b) {
+                             return a.getDistance() < b.getDistance();
+                         });
+
+        std::vector<FMOcc> counted;
+        std::vector<Range> inside, outer;
+        for (const auto& o : inFMOcc) {
+            const Range& r = o.getRanges().getRangeSA();
+            bool covered = false;
+            inside.clear();
+            for (const auto& c : counted) {
+                const Range& cr = c.getRanges().getRangeSA();
+                if (c.getShift() != o.getShift() ||
+                    cr.getEnd() <= r.getBegin() ||
+                    cr.getBegin() >= r.getEnd()) {
+                    continue;
+                }
+                // SA ranges are either nested or disjoint
+                if (cr.getBegin() <= r.getBegin() &&
+                    cr.getEnd() >= r.getEnd()) {
+                    covered = true;
+                    break;
+                }
+                inside.emplace_back(cr);
+            }
+            if (covered) {
+                continue;
+            }
+
+            // keep the outermost of the ranges that are already counted
+            std::sort(inside.begin(), inside.end(),
+                      [](const Range& a, const Range& b) {
+                          // outer ranges before the ranges nested in them
+                          return (a.getBegin() != b.getBegin())
+                                     ? a.getBegin() < b.getBegin()
+                                     : a.getEnd() > b.getEnd();
+                      });
+            outer.clear();
+            for (const auto& cr : inside) {
+                if (outer.empty() || cr.getEnd() > outer.back().getEnd()) {
+                    outer.emplace_back(cr);
+                }
+            }
+
+            visit(o, outer);
+            counted.emplace_back(o);
+        }
+    }
+
+    /**
+     * Removes the redundant occurrences: of the occurrences that begin within
+     * 2 * maxED positions of each other, only the one with the lowest
+     * distance, and then the shortest, is kept
+     * @param occs the occurrences, sorted and without doubles
+     * @param maxED the maximum allowed edit distance
+     * @returns the non-redundant occurrences
+     */
+    static std::vector<TextOcc>
+    removeRedundant(const std::vector<TextOcc>& occs, length_t maxED) {
+        std::vector<TextOcc> nonRedundantOcc;
+        nonRedundantOcc.reserve(occs.size());
+
+        length_t maxDiff = 2 * maxED;
+        length_t prevBegin = std::numeric_limits<length_t>::max();
+        length_t prevDepth = std::numeric_limits<length_t>::max();
+
+        length_t prevED = maxED + 1;
+
+        for (const auto& o : occs) {
+            // find the difference between this and the previous
+            // occurrence
+            auto diff = abs_diff<length_t>(o.getRange().getBegin(), prevBegin);
+
+            if (diff == 0) {
+                // same location -> skip
+                continue;
+            }
+
+            if (diff <= maxDiff) {
+                // check if this later occurrence is better than the
+                // previous one
+                if (o.getDistance() > prevED) {
+                    continue;
+                }
+                if (o.getDistance() == prevED &&
+                    o.getRange().width() >= prevDepth) {
+                    continue;
+                }
+
+                // prev was worse so pop_back
+                nonRedundantOcc.pop_back();
+            }
+
+            prevBegin = o.getRange().getBegin();
+            prevED = o.getDistance();
+            prevDepth = o.getRange().width();
+
+            nonRedundantOcc.emplace_back(o);
+        }
+        return nonRedundantOcc;
+    }
+
+    /**
+     * Counts the occurrences as in count mode: the non-redundant in-text
+     * occurrences and the SA rows of the collapsed in-index occurrences
+     * @param maxED the maximum allowed edit distance, 0 for the hamming
+     * distance, whose occurrences are never redundant
+     * @returns the number of occurrences
+     */
+    length_t countHits(length_t maxED) {
+        eraseDoublesText();
+        length_t count = removeRedundant(inTextOcc, maxED).size();
+        collapseFMOcc([&count](const FMOcc& o, const std::vector<Range>& in) {
+            count += o.getRanges().getRangeSA().width();
+            for (const auto& r : in) {
+                count -= r.width();
+            }
+        });
+        return count;
+    }
+
+    /**
+     * Locates one SA row of an in-index occurrence and adds it to the in-text
+     * occurrences
+     * @param index the FM index to use
+     * @param fmocc the in-index occurrence
+     * @param row the SA row, within the SA range of fmocc
+     */
+    void locateRow(const FMIndex& index, const FMOcc& fmocc, length_t row) {
+        // find the startPosition in the text by looking at the SA
+        length_t startPos = index.findSA(row) + fmocc.getShift();
+        inTextOcc.emplace_back(Range(startPos, startPos + fmocc.getDepth()),
+                               fmocc.getDistance());
+    }
+
+    /**
+     * Locates the sample of a repetitive pattern: at most maxHits SA rows of
+     * the collapsed in-index occurrences, from low to high distance and in SA
+     * order, such that the time spent locating stays bounded. The sampled
+     * occurrences are only deduplicated among themselves, so the sample may
+     * hold near-duplicates of each other or occurrences that are redundant
+     * with an occurrence that was not sampled.
+     * @param index the FM index to use
+     */
+    void locateSample(const FMIndex& index) {
+        length_t located = 0;
+        collapseFMOcc([&](const FMOcc& o, const std::vector<Range>& in) {
+            const Range& r = o.getRanges().getRangeSA();
+            auto next = in.begin();
+            length_t row = r.getBegin();
+            while (row < r.getEnd() && located < maxHits) {
+                if (next != in.end() && row == next->getBegin()) {
+                    // skip the rows that were sampled at a lower distance
+                    row = next->getEnd();
+                    next++;
+                    continue;
+                }
+                locateRow(index, o, row++);
+                located++;
+            }
+        });
+    }
+
+    /**
+     * Converts the in-index occurrences to in-text occurrences by locating
+     * them in the suffix array. If there is a maximal number of hits, the
+     * occurrences are first counted as in count mode. If there are more than
+     * maxHits, the pattern is repetitive: nothing is located, unless a sample
+     * is requested, in which case at most maxHits SA rows are located.
+     * @param index the FM index to use
+     * @param maxED the maximum allowed edit distance, 0 for the hamming
+     * distance
+     * @param counters performance counters
+     * @returns false if the pattern is repetitive and nothing should be
+     * reported
+     */
+    bool locate(const FMIndex& index, length_t maxED, Counters& counters) {
+        // erase equal occurrences from the in-index occurrences
+        eraseDoublesFM();
+
+        ScopedPhase scope(LOCATE);
+        TraceSpan span("locate", "locate");
+        span.arg("ranges", inFMOcc.size());
+        length_t rows = inTextOcc.size();
+        for (const auto& fmocc : inFMOcc) {
+            rows += fmocc.getRanges().width();
+        }
+        // increment reported positions counter
+        counters.totalReportedPositions += rows;
+        span.arg("rows", rows);
+
+        if (maxHits != 0) {
+            hits = countHits(maxED);
+            span.arg("hits", hits);
+        }
+        if (isRepetitive()) {
+            if (!sampleRepeats) {
+                inTextOcc.clear();
+                return false;
+            }
+            locateSample(index);
+            return true;
+        }
+
+        // convert the in-index occurrences to in-text occurrences
+        for (const auto& fmocc : inFMOcc) {
+            const Range saRange = fmocc.getRanges().getRangeSA();
+            for (length_t i = saRange.getBegin(); i < saRange.getEnd(); i++) {
+                locateRow(index, fmocc, i);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @returns true if there are more than maxHits hits
+     */
+    bool isRepetitive() const {
+        return maxHits != 0 && hits > maxHits;
+    }
+
+    /**
+     * Cuts the sample of a repetitive pattern to the maxHits occurrences
+     * with the lowest positions, as the in-text occurrences are part of the
+     * sample as well
+     * @param unique the unique sampled occurrences, sorted on position
+     */
+    void sample(std::vector<TextOcc>& unique) const {
+        if (isRepetitive() && unique.size() > maxHits) {
+            unique.resize(maxHits);
+        }
+    }
 
     /**
      * Erase all double in-index occurrences and sorts the occurrences
@@ -1877,11 +2883,36 @@ class Occurrences {
     }
 
   public:
-    Occurrences(const length_t reserve = 200) {
+    /**
+     * Constructor
+     * @param cigars the arena in which the CIGAR strings of the text
+     * occurrences are stored
+     * @param generateCigars if false, no CIGAR strings are calculated
+     * @param maxHits the maximal number of occurrences that are located, 0 if
+     * there is no maximum
+     * @param sampleRepeats if true, a sample of maxHits occurrences is
+     * reported for a repetitive pattern, otherwise none are reported
+     * @param reserve the number of occurrences to reserve space for
+     */
+    Occurrences(CigarArena& cigars, bool generateCigars = true,
+                length_t maxHits = 0, bool sampleRepeats = false,
+                const length_t reserve = 200)
+        : cigars(cigars), generateCigars(generateCigars), maxHits(maxHits),
+          sampleRepeats(sampleRepeats) {
         inTextOcc.reserve(reserve);
         inFMOcc.reserve(reserve);
     }
 
+    /**
+     * @returns the number of occurrences as counted in count mode, 0 if there
+     * is no maximal number of hits. Only valid after the text occurrences
+     * were requested. If this exceeds the maximal number of hits, the pattern
+     * is repetitive.
+     */
+    length_t getHits() const {
+        return hits;
+    }
+
     /**
      * Add an FM occurrence
      */
@@ -1905,11 +2936,11 @@ class Occurrences {
     }
 
     /**
-     * Add an i-text occurrence
+     * Add an in-text occurrence, its CIGAR string is calculated when the
+     * unique occurrences are requested
      */
-    void addTextOcc(const Range& range, const length_t& score,
-                    std::vector<std::pair<char, uint>>& CIGAR) {
-        inTextOcc.emplace_back(range, score, CIGAR);
+    void addTextOcc(const Range& range, const length_t& score) {
+        inTextOcc.emplace_back(range, score);
     }
 
     /**
@@ -1921,28 +2952,22 @@ class Occurrences {
     std::vector<TextOcc> getTextOccurrencesHamming(const FMIndex& index,
                                                    length_t patternSize,
                                                    Counters& counters) {
+        ScopedPhase scope(DEDUP_CIGAR);
 
-        eraseDoublesFM();
-
-        counters.totalReportedPositions += inTextOcc.size();
-
-        for (const auto& fmOcc : inFMOcc) {
-            const Range saRange = fmOcc.getRanges().getRangeSA();
-            counters.totalReportedPositions += saRange.width();
-            for (length_t i = saRange.getBegin(); i < saRange.getEnd(); i++) {
-                length_t b = index.findSA(i);
-
-                std::vector<std::pair<char, uint>> CIGAR = {
-                    std::make_pair('M', patternSize)};
-                inTextOcc.emplace_back(Range(b, b + patternSize),
-                                       fmOcc.getDistance(), CIGAR);
-            }
+        if (!locate(index, 0, counters)) {
+            return inTextOcc;
         }
 
         // remove doubles
         eraseDoublesText();
-        for (auto& t : inTextOcc) {
-            t.generateOutput();
+        sample(inTextOcc);
+
+        if (generateCigars && !inTextOcc.empty()) {
+            // all occurrences share the same CIGAR string
+            length_t cigarOffset = cigars.add('M', patternSize);
+            for (auto& t : inTextOcc) {
+                t.setCigar(cigarOffset, 1);
+            }
         }
 
         return inTextOcc;
@@ -1954,108 +2979,76 @@ class Occurrences {
      * @param maxED the maximum allowed edit distance, needed for filtering
      * redundant occurrences
      * @param patternMatrix the bit parallel matrix needed to find the CIGAR
-     * strings of the in-index occurrences
+     * strings of the reported occurrences, its words must be wide enough for
+     * maxED
      * @param counters performance counters
      */
+    template <typename Matrix>
     std::vector<TextOcc> getUniqueTextOccurrences(const FMIndex& index,
                                                   const length_t& maxED,
-                                                  BitParallelED& patternMatrix,
+                                                  Matrix& patternMatrix,
                                                   Counters& counters) {
+        ScopedPhase scope(DEDUP_CIGAR);
 
-        // increment reporte position counter
-        counters.totalReportedPositions += inTextOcc.size();
-
-        // erase equal occurrences from the in-index occurrences
-        eraseDoublesFM();
-
-        // convert the in-index occurrences to in-text occurrences
-        for (const auto& fmocc : inFMOcc) {
-
-            const Range saRange = fmocc.getRanges().getRangeSA();
-
-            // increment reported positions counter
-            counters.totalReportedPositions += saRange.width();
-
-            for (length_t i = saRange.getBegin(); i < saRange.getEnd(); i++) {
-                // find the startPosition in the text by looking at the
-                // SA
-                length_t startPos = index.findSA(i) + fmocc.getShift();
-
-                inTextOcc.emplace_back(
-                    Range(startPos, startPos + fmocc.getDepth()),
-                    fmocc.getDistance());
-            }
+        if (!locate(index, maxED, counters)) {
+            return inTextOcc;
         }
 
-        // erase equal occurrences from the in-text occurrences, note
-        // that an in-text occurrence with calculated CIGAR string takes
-        // preference over an equal one without CIGAR string
+        // erase equal occurrences from the in-text occurrences
         eraseDoublesText();
 
         // find the non-redundant occurrences
-        std::vector<TextOcc> nonRedundantOcc;
-        nonRedundantOcc.reserve(inTextOcc.size());
-
-        length_t maxDiff = 2 * maxED;
-        length_t prevBegin = std::numeric_limits<length_t>::max();
-        length_t prevDepth = std::numeric_limits<length_t>::max();
-
-        length_t prevED = maxED + 1;
+        std::vector<TextOcc> nonRedundantOcc =
+            removeRedundant(inTextOcc, maxED);
+        sample(nonRedundantOcc);
 
-        for (const auto& o : inTextOcc) {
-            // find the difference between this and the previous
-            // occurrence
-            auto diff = abs_diff<length_t>(o.getRange().getBegin(), prevBegin);
+        if (!generateCigars) {
+            return nonRedundantOcc;
+        }
 
-            if (diff == 0) {
-                // same location -> skip
-                continue;
-            }
+        // only the occurrences that are reported get a CIGAR string
+        std::vector<std::pair<char, uint>> CIGAR;
+        for (TextOcc& occ : nonRedundantOcc) {
+            // find the reference sequence
+            Substring ref = index.getSubstring(occ.getRange());
+            // calculate the cigar string
+            patternMatrix.findCIGAR(ref, occ.getDistance(), CIGAR);
+            occ.setCigar(cigars.add(CIGAR), CIGAR.size());
 
-            if (diff <= maxDiff) {
-                // check if this later occurrence is better than the
-                // previous one
-                if (o.getDistance() > prevED) {
-                    continue;
-                }
-                if (o.getDistance() == prevED &&
-                    o.getRange().width() >= prevDepth) {
-                    continue;
-                }
+            counters.cigarsComputed++;
+        }
 
-                // prev was worse so pop_back
-                nonRedundantOcc.pop_back();
-            }
+        return nonRedundantOcc;
+    }
 
-            prevBegin = o.getRange().getBegin();
-            prevED = o.getDistance();
-            prevDepth = o.getRange().width();
+    /**
+     * Counts the occurrences per distance without locating the in-index
+     * occurrences. In-index occurrences are only deduplicated in the index: of
+     * the occurrences with the same shift, nested SA ranges are only counted
+     * once, at their lowest distance.
+     * @param maxED the maximum allowed distance
+     * @returns a vector with at index d the number of occurrences at distance
+     * d
+     */
+    std::vector<length_t> getCounts(const length_t& maxED) {
+        ScopedPhase scope(DEDUP_CIGAR);
+        std::vector<length_t> counts(maxED + 1, 0);
 
-            nonRedundantOcc.emplace_back(o);
+        // in-text occurrences have been located already
+        eraseDoublesText();
+        for (const auto& t : inTextOcc) {
+            counts[t.getDistance()]++;
         }
 
-        for (TextOcc& occ : nonRedundantOcc) {
-            if (!occ.hasCigar()) {
-                // this was an in-index occurrence which needs to
-                // calculate the CIGAR string find the reference
-                // sequence
-                Substring ref = index.getSubstring(occ.getRange());
-                // calculate the cigar string
-                std::vector<std::pair<char, uint>> CIGAR;
-                patternMatrix.findCIGAR(ref, occ.getDistance(), CIGAR);
-                occ.setCigar(CIGAR);
-
-                counters.cigarsInIndex++;
-
-            } else {
-                // this was a useful in-text cigar
-                counters.usefulCigarsInText++;
+        collapseFMOcc([&counts](const FMOcc& o, const std::vector<Range>& in) {
+            // subtract the rows that are already counted
+            length_t width = o.getRanges().getRangeSA().width();
+            for (const auto& r : in) {
+                width -= r.width();
             }
-            // convert the information to text-format
-            occ.generateOutput();
-        }
-
-        return nonRedundantOcc;
+            counts[o.getDistance()] += width;
+        });
+        return counts;
     }
 
     length_t getMaxSize() const {
@@ -0,0 +1,763 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#include "sample.h"
+
+#include <cmath>
+#include <numeric>
+#include <set>
+#include <string.h>
+
+using namespace std;
+
+// the number of uncovered patterns a greedy step builds candidates from
+const length_t numSeeds = 4;
+
+// the maximal number of part orders that are tried per seed and start part
+const length_t maxOrders = 8;
+
+// the local search keeps a change if it lowers the cost by this fraction
+const double tolerance = 0.001;
+
+// ============================================================================
+// PLANS
+// ============================================================================
+
+/**
+ * A search under construction, it is turned into a Search once the scheme is
+ * complete
+ */
+struct Plan {
+    vector<length_t> order; // the order in which the parts are processed
+    vector<length_t> lower; // the lower bound of every phase
+    vector<length_t> upper; // the upper bound of every phase
+};
+
+/**
+ * @param plan the plan
+ * @param idx the index of a phase
+ * @returns whether the phase extends the match to the right
+ */
+bool isForward(const Plan& plan, length_t idx) {
+    // the first phase has the direction of the second one
+    idx = max<length_t>(idx, 1);
+    return plan.order[idx] > plan.order[idx - 1];
+}
+
+/**
+ * Creates the plans of the pigeonhole scheme, which searches every part
+ * exactly and the rest of the pattern with all errors
+ * @param numParts the number of parts
+ * @param maxED the maximal distance
+ */
+vector<Plan> pigeonhole(length_t numParts, length_t maxED) {
+    vector<Plan> plans;
+    for (length_t s = 0; s < numParts; s++) {
+        Plan plan;
+        for (length_t p = s; p < numParts; p++) {
+            plan.order.push_back(p);
+        }
+        for (length_t p = s; p-- > 0;) {
+            plan.order.push_back(p);
+        }
+        plan.lower.assign(numParts, 0);
+        plan.upper.assign(numParts, maxED);
+        plan.upper[0] = 0;
+        plans.push_back(plan);
+    }
+    return plans;
+}
+
+// ============================================================================
+// COST MODEL
+// ============================================================================
+
+/**
+ * Estimates the number of nodes a search scheme visits in the index for a
+ * random read. A string of length d occurs min(1, n / 4^d) times in a random
+ * text of length n, so the nodes at depth d are the strings the scheme allows
+ * at that depth weighted by this number. The strings are counted as for the
+ * Hamming distance, where every error is one of three substitutions; the edit
+ * distance allows more strings per error but ranks schemes the same way.
+ * Phases that searches share are counted once, as the search tree of a scheme
+ * explores them once.
+ */
+class SchemeCostModel {
+  private:
+    double textLength;          // the length of the text
+    vector<length_t> partSizes; // the size of every part of the read
+
+  public:
+    /**
+     * Constructor
+     * @param textLength the length of the text
+     * @param readLength the length of the reads
+     * @param numParts the number of parts, the read is split uniformly
+     */
+    SchemeCostModel(length_t textLength, length_t readLength,
+                    length_t numParts)
+        : textLength(textLength) {
+        length_t previous = 0;
+        for (length_t i = 1; i <= numParts; i++) {
+            length_t begin = (readLength * i) / numParts;
+            partSizes.push_back(begin - previous);
+            previous = begin;
+        }
+    }
+
+    /**
+     * @param plan the plan
+     * @returns the expected number of nodes visited in every phase
+     */
+    vector<double> phaseCosts(const Plan& plan) const {
+        length_t maxED = plan.upper.back();
+        // strings[e] is the number of allowed strings with e errors
+        vector<double> strings(maxED + 1, 0), next(maxED + 1);
+        strings[0] = 1;
+
+        vector<double> costs;
+        length_t depth = 0;
+        for (length_t i = 0; i < plan.order.size(); i++) {
+            double cost = 0;
+            for (length_t c = 0; c < partSizes[plan.order[i]]; c++) {
+                depth++;
+                double total = 0;
+                for (length_t e = 0; e <= plan.upper[i]; e++) {
+                    next[e] = strings[e] + ((e > 0) ? 3 * strings[e - 1] : 0);
+                    total += next[e];
+                }
+                fill(next.begin() + plan.upper[i] + 1, next.end(), 0);
+                strings.swap(next);
+                cost += total * min(1.0, ldexp(textLength, -2 * (int)depth));
+            }
+            // strings with too few errors are abandoned at the end of a part
+            fill(strings.begin(), strings.begin() + plan.lower[i], 0);
+            costs.push_back(cost);
+        }
+        return costs;
+    }
+
+    /**
+     * Calculates the cost a plan adds to a set of selected plans
+     * @param plan the plan to add
+     * @param phases the phases of the selected plans, the phases of plan are
+     * added if add is true
+     * @param add whether the phases of plan should be added to phases
+     * @returns the expected number of nodes of the phases of plan that are not
+     * in phases
+     */
+    double addedCost(const Plan& plan, set<vector<length_t>>& phases,
+                     bool add = false) const {
+        vector<double> costs = phaseCosts(plan);
+        vector<length_t> prefix;
+        double cost = 0;
+        for (length_t i = 0; i < plan.order.size(); i++) {
+            prefix.insert(prefix.end(), {plan.order[i], isForward(plan, i),
+                                         plan.lower[i], plan.upper[i]});
+            if (phases.count(prefix)) {
+                continue;
+            }
+            cost += costs[i];
+            if (add) {
+                phases.insert(prefix);
+            }
+        }
+        return cost;
+    }
+
+    /**
+     * @param plans the plans of a scheme
+     * @returns the expected number of nodes the scheme visits
+     */
+    double cost(const vector<Plan>& plans) const {
+        set<vector<length_t>> phases;
+        double cost = 0;
+        for (const Plan& plan : plans) {
+            cost += addedCost(plan, phases, true);
+        }
+        return cost;
+    }
+};
+
+// ============================================================================
+// GENERATING
+// ============================================================================
+
+/**
+ * Generates a search scheme in two steps. First a greedy set cover picks
+ * searches with lower bounds of zero, every step chooses the candidate that
+ * covers the most uncovered error patterns per node it adds. The candidates
+ * start from uncovered patterns: the parts are ordered such that the pattern
+ * has as few errors as possible early on and the upper bounds are those of the
+ * pattern, relaxed towards the maximal distance. Then redundancy is removed:
+ * upper bounds are lowered, lower bounds are raised and searches are dropped
+ * as long as every pattern stays covered. Finally a local search replaces
+ * single searches by a new greedy cover of the patterns they leave.
+ */
+class SchemeGenerator {
+  private:
+    length_t numParts;             // the number of parts
+    length_t maxED;                // the maximal distance
+    const SchemeCostModel& model;  // the cost model
+    vector<uint8_t> patterns;      // the error patterns, numParts per pattern
+    length_t numPatterns;          // the number of error patterns
+
+    /**
+     * @param p the index of a pattern
+     * @returns the errors of the pattern in every part
+     */
+    const uint8_t* pattern(length_t p) const {
+        return patterns.data() + p * numParts;
+    }
+
+    /**
+     * Calculates the errors of a pattern accumulated over the phases of an
+     * order
+     * @param p the index of the pattern
+     * @param order the order of the parts
+     * @param sums the accumulated errors per phase (output)
+     */
+    void prefixSums(length_t p, const vector<length_t>& order,
+                    uint8_t* sums) const {
+        length_t sum = 0;
+        for (length_t i = 0; i < numParts; i++) {
+            sum += pattern(p)[order[i]];
+            sums[i] = sum;
+        }
+    }
+
+    /**
+     * @param p the index of a pattern
+     * @param plan the plan
+     * @returns whether the plan covers the pattern
+     */
+    bool covers(length_t p, const Plan& plan) const {
+        length_t sum = 0;
+        for (length_t i = 0; i < numParts; i++) {
+            sum += pattern(p)[plan.order[i]];
+            if (sum < plan.lower[i] || sum > plan.upper[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Extends the orders of a pattern, every step takes the neighbouring part
+     * with the fewest errors, ties are both tried
+     * @param p the index of the pattern
+     * @param order the order so far
+     * @param orders the complete orders (output)
+     */
+    void extendOrder(length_t p, vector<length_t>& order,
+                     vector<vector<length_t>>& orders, length_t cap) const {
+        if (orders.size() >= cap) {
+            return;
+        }
+        if (order.size() == numParts) {
+            orders.push_back(order);
+            return;
+        }
+        length_t low = *min_element(order.begin(), order.end());
+        length_t high = *max_element(order.begin(), order.end());
+        int left = (low > 0) ? pattern(p)[low - 1] : maxED + 1;
+        int right = (high + 1 < numParts) ? pattern(p)[high + 1] : maxED + 1;
+        if (left <= right) {
+            order.push_back(low - 1);
+            extendOrder(p, order, orders, cap);
+            order.pop_back();
+        }
+        if (right <= left) {
+            order.push_back(high + 1);
+            extendOrder(p, order, orders, cap);
+            order.pop_back();
+        }
+    }
+
+    /**
+     * Finds the best candidate of the greedy step that covers a pattern
+     * @param seed the index of the uncovered pattern
+     * @param uncovered the indices of the uncovered patterns
+     * @param phases the phases of the selected plans
+     * @param best the best candidate so far, updated if a better one is found
+     * @param bestRatio the patterns per node of best
+     */
+    void bestCandidate(length_t seed, const vector<length_t>& uncovered,
+                       set<vector<length_t>>& phases, Plan& best,
+                       double& bestRatio) const {
+        vector<vector<length_t>> orders;
+        for (length_t s = 0; s < numParts; s++) {
+            if (pattern(seed)[s] == 0) {
+                vector<length_t> order = {s};
+                extendOrder(seed, order, orders, orders.size() + maxOrders);
+            }
+        }
+
+        vector<uint8_t> sums(uncovered.size() * numParts);
+        vector<uint8_t> seedSums(numParts);
+        for (const auto& order : orders) {
+            for (length_t u = 0; u < uncovered.size(); u++) {
+                prefixSums(uncovered[u], order, &sums[u * numParts]);
+            }
+            prefixSums(seed, order, seedSums.data());
+
+            // the upper bounds follow the seed and are relaxed by r, from
+            // phase j onwards they are the maximal distance
+            set<vector<length_t>> tried;
+            for (length_t j = 1; j < numParts; j++) {
+                for (length_t r = 0; r <= maxED; r++) {
+                    Plan plan;
+                    plan.order = order;
+                    plan.lower.assign(numParts, 0);
+                    plan.upper.assign(numParts, maxED);
+                    plan.upper[0] = seedSums[0];
+                    for (length_t i = 1; i < j; i++) {
+                        plan.upper[i] = min(maxED, seedSums[i] + r);
+                    }
+                    if (!tried.insert(plan.upper).second) {
+                        continue;
+                    }
+
+                    length_t count = 0;
+                    for (length_t u = 0; u < uncovered.size(); u++) {
+                        const uint8_t* s = &sums[u * numParts];
+                        length_t i = 0;
+                        while (i < numParts && s[i] <= plan.upper[i]) {
+                            i++;
+                        }
+                        count += (i == numParts);
+                    }
+                    double cost = model.addedCost(plan, phases);
+                    double ratio = count / max(cost, 1e-9);
+                    if (ratio > bestRatio) {
+                        bestRatio = ratio;
+                        best = plan;
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Narrows a bound of a plan by one if every pattern this loses is covered
+     * by another plan
+     * @param plan the plan
+     * @param i the phase of the bound
+     * @param bound the lower or upper bound of plan at phase i
+     * @param step 1 to raise a lower bound, -1 to lower an upper bound
+     * @param numCovers the number of plans that cover each pattern
+     * @returns whether the bound was narrowed
+     */
+    bool narrow(const Plan& plan, length_t i, length_t& bound, int step,
+                vector<length_t>& numCovers) const {
+        // the lost patterns are those with exactly bound errors after phase i
+        vector<uint8_t> sums(numParts);
+        vector<length_t> lost;
+        for (length_t p = 0; p < numPatterns; p++) {
+            if (!covers(p, plan)) {
+                continue;
+            }
+            prefixSums(p, plan.order, sums.data());
+            if (sums[i] == bound) {
+                if (numCovers[p] < 2) {
+                    return false;
+                }
+                lost.push_back(p);
+            }
+        }
+        for (length_t p : lost) {
+            numCovers[p]--;
+        }
+        bound += step;
+        return true;
+    }
+
+    /**
+     * Narrows the bounds of the plans and drops plans, as long as every
+     * pattern stays covered. Expensive plans are handled first.
+     * @param plans the plans of a complete scheme
+     */
+    void removeRedundancy(vector<Plan>& plans) const {
+        sort(plans.begin(), plans.end(), [this](const Plan& a, const Plan& b) {
+            return model.cost({a}) > model.cost({b});
+        });
+
+        // the number of plans that cover each pattern
+        vector<length_t> numCovers(numPatterns, 0);
+        for (const Plan& plan : plans) {
+            for (length_t p = 0; p < numPatterns; p++) {
+                numCovers[p] += covers(p, plan);
+            }
+        }
+
+        // the bounds must not decrease and the last upper bound stays the
+        // maximal distance
+        for (Plan& plan : plans) {
+            // the upper bounds of the early phases matter most
+            for (length_t i = 1; i + 1 < numParts; i++) {
+                while (plan.upper[i] > max(plan.lower[i], plan.upper[i - 1]) &&
+                       narrow(plan, i, plan.upper[i], -1, numCovers)) {
+                }
+            }
+            for (length_t i = numParts; i-- > 1;) {
+                length_t limit = (i + 1 == numParts) ? plan.upper[i]
+                                                     : plan.lower[i + 1];
+                while (plan.lower[i] < limit &&
+                       narrow(plan, i, plan.lower[i], 1, numCovers)) {
+                }
+            }
+        }
+
+        vector<Plan> kept;
+        for (const Plan& plan : plans) {
+            bool needed = false;
+            for (length_t p = 0; p < numPatterns && !needed; p++) {
+                needed = covers(p, plan) && numCovers[p] < 2;
+            }
+            if (needed) {
+                kept.push_back(plan);
+                continue;
+            }
+            for (length_t p = 0; p < numPatterns; p++) {
+                numCovers[p] -= covers(p, plan);
+            }
+        }
+        plans.swap(kept);
+    }
+
+    /**
+     * Completes a scheme with the greedy set cover
+     * @param plans the plans of the scheme so far, plans are added until all
+     * patterns are covered
+     */
+    void cover(vector<Plan>& plans) const {
+        set<vector<length_t>> phases;
+        vector<bool> covered(numPatterns, false);
+        for (const Plan& plan : plans) {
+            model.addedCost(plan, phases, true);
+            for (length_t p = 0; p < numPatterns; p++) {
+                covered[p] = covered[p] || covers(p, plan);
+            }
+        }
+
+        while (true) {
+            vector<length_t> uncovered;
+            length_t mostErrors = 0;
+            for (length_t p = 0; p < numPatterns; p++) {
+                if (covered[p]) {
+                    continue;
+                }
+                uncovered.push_back(p);
+                const uint8_t* e = pattern(p);
+                mostErrors = max<length_t>(
+                    mostErrors, accumulate(e, e + numParts, 0));
+            }
+            if (uncovered.empty()) {
+                break;
+            }
+
+            // the seeds are spread over the patterns with the most errors,
+            // as these are the hardest to cover
+            vector<length_t> hardest;
+            for (length_t p : uncovered) {
+                const uint8_t* e = pattern(p);
+                if ((length_t)accumulate(e, e + numParts, 0) == mostErrors) {
+                    hardest.push_back(p);
+                }
+            }
+            Plan best;
+            double bestRatio = -1;
+            length_t seeds = min<length_t>(numSeeds, hardest.size());
+            for (length_t s = 0; s < seeds; s++) {
+                bestCandidate(hardest[s * hardest.size() / seeds], uncovered,
+                              phases, best, bestRatio);
+            }
+
+            model.addedCost(best, phases, true);
+            for (length_t p : uncovered) {
+                covered[p] = covers(p, best);
+            }
+            plans.push_back(best);
+        }
+    }
+
+  public:
+    /**
+     * Constructor
+     * @param numParts the number of parts, larger than maxED
+     * @param maxED the maximal distance
+     * @param model the cost model for numParts parts
+     */
+    SchemeGenerator(length_t numParts, length_t maxED,
+                    const SchemeCostModel& model)
+        : numParts(numParts), maxED(maxED), model(model) {
+        vector<Pattern> all;
+        SearchStrategy::genErrorPatterns(numParts, maxED, all);
+        numPatterns = all.size();
+        for (const Pattern& p : all) {
+            patterns.insert(patterns.end(), p.begin(), p.end());
+        }
+    }
+
+    /**
+     * @returns the plans of the generated scheme
+     */
+    vector<Plan> generate() const {
+        vector<Plan> plans;
+        cover(plans);
+        removeRedundancy(plans);
+        double cost = model.cost(plans);
+
+        // local search: replace a plan by a greedy cover of the patterns it
+        // leaves uncovered, as long as this lowers the cost
+        bool improved = true;
+        while (improved) {
+            improved = false;
+            for (length_t t = 0; t < plans.size() && !improved; t++) {
+                vector<Plan> candidate = plans;
+                candidate.erase(candidate.begin() + t);
+                cover(candidate);
+                removeRedundancy(candidate);
+                double c = model.cost(candidate);
+                if (c < cost * (1 - tolerance)) {
+                    plans.swap(candidate);
+                    cost = c;
+                    improved = true;
+                }
+            }
+        }
+        return plans;
+    }
+};
+
+/**
+ * Turns plans into searches
+ * @param plans the plans
+ */
+vector<Search> toSearches(const vector<Plan>& plans) {
+    vector<Search> searches;
+    for (const Plan& plan : plans) {
+        searches.push_back(
+            Search::makeSearch(plan.order, plan.lower, plan.upper));
+    }
+    return searches;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+void showUsage() {
+    cout << "Usage: ./columba_generate [options] basefilename "
+            "outputfolder\n\n";
+    cout << "Generates a search scheme for a maximal distance and an index and "
+            "writes it as a custom search scheme to outputfolder, to be used "
+            "with -ss "
+            "custom outputfolder. Generating for several distances into the "
+            "same folder adds them to the scheme.\n\n";
+    cout << " [options]\n";
+    cout << "  -e  --max-ed\t\tmaximum edit distance, in [1, "
+         << CustomSearchStrategy::MAX_SCORE << "] [default = 5]\n";
+    cout << "  -l  --read-length\tthe length of the reads [default = 100]\n";
+    cout << "  -p  --parts\t\tthe number of parts, or 0 to try maxED + 1 and "
+            "maxED + 2 [default = 0]\n";
+    cout << "  -r  --reads\t\ta file with reads, the scheme that matches a "
+            "sample of them fastest in the index is chosen, otherwise the "
+            "cost model decides\n";
+    cout << "  -n  --num-reads\tnumber of reads in the sample, both strands "
+            "are matched [default = 1000]\n";
+    cout << "  -s  --sa-sparseness\tsuffix array sparseness factor "
+            "[default = 1]\n";
+    cout << "  -m   --metric\tdistance metric (editnaive/editopt/hamming) "
+            "[default = editopt]\n";
+    cout << "  -i  --in-text\tThe tipping point for in-text verification, "
+            "or auto [default = 5]\n\n";
+}
+
+int main(int argc, char* argv[]) {
+
+    int requiredArguments = 2; // baseFile and output folder
+
+    if (argc == 2 && strcmp("help", argv[1]) == 0) {
+        showUsage();
+        return EXIT_SUCCESS;
+    }
+    if (argc <= requiredArguments) {
+        cerr << "Insufficient number of arguments" << endl;
+        showUsage();
+        return EXIT_FAILURE;
+    }
+
+    cout << "Welcome to Columba's search scheme generator!\n";
+
+    string maxED = "5";
+    string readLength = "100";
+    string parts = "0";
+    string readsFile = "";
+    string numReads = "1000";
+    string saSparse = "1";
+    string inTextPoint = "5";
+    DistanceMetric metric = EDITOPTIMIZED;
+
+    // process optional arguments
+    for (int i = 1; i < argc - requiredArguments; i++) {
+        const string& arg = argv[i];
+
+        if (i + 1 >= argc - requiredArguments) {
+            throw runtime_error(arg + " takes 1 argument as input");
+        }
+        if (arg == "-e" || arg == "--max-ed") {
+            maxED = argv[++i];
+        } else if (arg == "-l" || arg == "--read-length") {
+            readLength = argv[++i];
+        } else if (arg == "-p" || arg == "--parts") {
+            parts = argv[++i];
+        } else if (arg == "-r" || arg == "--reads") {
+            readsFile = argv[++i];
+        } else if (arg == "-n" || arg == "--num-reads") {
+            numReads = argv[++i];
+        } else if (arg == "-s" || arg == "--sa-sparseness") {
+            saSparse = argv[++i];
+        } else if (arg == "-i" || arg == "--in-text") {
+            inTextPoint = argv[++i];
+        } else if (arg == "-m" || arg == "--metric") {
+            string s = argv[++i];
+            if (s == "editopt") {
+                metric = EDITOPTIMIZED;
+            } else if (s == "editnaive") {
+                metric = EDITNAIVE;
+            } else if (s == "hamming") {
+                metric = HAMMING;
+            } else {
+                throw runtime_error(s + " is not a metric option\nOptions are: "
+                                        "editopt, editnaive, hamming");
+            }
+        } else {
+            cerr << "Unknown argument: " << arg << " is not an option" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    length_t ed = stoi(maxED);
+    if (ed < 1 || ed > CustomSearchStrategy::MAX_SCORE) {
+        cerr << ed << " is not allowed as maxED should be in [1, "
+             << CustomSearchStrategy::MAX_SCORE << "]" << endl;
+        return EXIT_FAILURE;
+    }
+    length_t numParts = stoi(parts);
+    if (numParts != 0 && numParts <= ed) {
+        cerr << "A scheme for distance " << ed << " needs at least " << ed + 1
+             << " parts" << endl;
+        return EXIT_FAILURE;
+    }
+    length_t saSF = stoi(saSparse);
+    if (saSF == 0 || saSF > 256 || (saSF & (saSF - 1)) != 0) {
+        cerr << saSF
+             << " is not allowed as sparse factor, should be in 2^[0, 8]"
+             << endl;
+        return EXIT_FAILURE;
+    }
+    bool adaptiveSwitch = inTextPoint == "auto";
+    length_t inTextSwitchPoint = adaptiveSwitch ? 0 : stoi(inTextPoint);
+
+    string baseFile = argv[argc - 2];
+    string outputFolder = argv[argc - 1];
+
+    try {
+        FMIndex index(baseFile, inTextSwitchPoint, saSF);
+        if (adaptiveSwitch) {
+            index.calibrateInTextSwitch();
+        }
+        length_t n = index.getText().size();
+        vector<string> sample;
+        if (!readsFile.empty()) {
+            sample = getSample(readsFile, stoul(numReads));
+            cout << "Choosing on " << sample.size() << " sequences" << endl;
+        }
+
+        vector<length_t> partCounts = {ed + 1, ed + 2};
+        if (numParts != 0) {
+            partCounts = {numParts};
+        }
+
+        // the generated schemes, and pigeonhole as a baseline
+        vector<pair<string, vector<Plan>>> candidates;
+        for (length_t P : partCounts) {
+            SchemeCostModel model(n, stoul(readLength), P);
+            vector<Plan> plans = SchemeGenerator(P, ed, model).generate();
+            cout << P << " parts: " << plans.size() << " searches, "
+                 << model.cost(plans) << " expected nodes" << endl;
+            candidates.emplace_back(to_string(P) + " parts", plans);
+        }
+        {
+            SchemeCostModel model(n, stoul(readLength), ed + 1);
+            vector<Plan> plans = pigeonhole(ed + 1, ed);
+            cout << "pigeonhole: " << plans.size() << " searches, "
+                 << model.cost(plans) << " expected nodes" << endl;
+            candidates.emplace_back("pigeonhole", plans);
+        }
+
+        // choose by sampled runs if there are reads, otherwise by the model
+        length_t best = 0;
+        if (!sample.empty()) {
+            Cost reference;
+            double bestScore = 0;
+            for (length_t c = 0; c < candidates.size(); c++) {
+                CustomSearchStrategy strategy(index, candidates[c].first, ed,
+                                              toSearches(candidates[c].second),
+                                              DYNAMIC, metric);
+                strategy.setGenerateCigars(false);
+                Cost cost = measure(strategy, sample, ed);
+                if (c == 0) {
+                    reference = cost;
+                }
+                cout << candidates[c].first << ": " << cost.nodes
+                     << " nodes, " << cost.seconds << "s" << endl;
+                if (c == 0 || score(cost, reference) < bestScore) {
+                    bestScore = score(cost, reference);
+                    best = c;
+                }
+            }
+        } else {
+            double bestCost = 0;
+            for (length_t c = 0; c < candidates.size(); c++) {
+                SchemeCostModel model(n, stoul(readLength),
+                                      candidates[c].second[0].order.size());
+                double cost = model.cost(candidates[c].second);
+                if (c == 0 || cost < bestCost) {
+                    bestCost = cost;
+                    best = c;
+                }
+            }
+        }
+        cout << "Chose " << candidates[best].first << endl;
+
+        // the scheme is written through a strategy, which checks that it
+        // covers all error patterns
+        CustomSearchStrategy strategy(index, "generated", ed,
+                                      toSearches(candidates[best].second));
+        strategy.writeToFolder(outputFolder, ed);
+        cout << "Wrote the generated search scheme to " << outputFolder
+             << endl;
+    } catch (const exception& e) {
+        cerr << "Fatal error: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
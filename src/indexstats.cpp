@@ -0,0 +1,193 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#include "indexstats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace std;
+
+// ============================================================================
+// CLASS INDEXSTATS
+// ============================================================================
+
+size_t IndexStats::getCurrentRSS() {
+#ifdef __linux__
+    // the second field is the number of resident pages
+    ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (statm >> pages >> resident) {
+        return resident * sysconf(_SC_PAGESIZE);
+    }
+#endif
+    return 0;
+}
+
+size_t IndexStats::getPeakRSS() {
+    size_t peak = 0;
+#ifdef __linux__
+    // the high water mark of the resident set size, reported in kB
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            peak = stoull(line.substr(6)) * 1024;
+            break;
+        }
+    }
+#endif
+    if (peak == 0) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        peak = usage.ru_maxrss; // reported in bytes
+#else
+        peak = usage.ru_maxrss * 1024; // reported in kB
+#endif
+    }
+    // the high water mark is updated lazily and can lag behind the current
+    // resident set size
+    return max(peak, getCurrentRSS());
+}
+
+double IndexStats::probeRank(const FMIndex& index) const {
+    mt19937 rng(42);
+    uniform_int_distribution<length_t> posDist(0, index.bwt.size());
+    uniform_int_distribution<length_t> charDist(1, ALPHABET - 1);
+    vector<pair<length_t, length_t>> queries(numOps);
+    for (auto& q : queries) {
+        q = make_pair(charDist(rng), posDist(rng));
+    }
+
+    length_t checksum = 0; // keeps the queries from being optimized away
+    auto start = chrono::steady_clock::now();
+    for (const auto& q : queries) {
+        checksum += index.fwdRepr.occ(q.first, q.second);
+    }
+    chrono::duration<double, nano> elapsed =
+        chrono::steady_clock::now() - start;
+
+    volatile length_t sink = checksum;
+    (void)sink;
+    return elapsed.count() / numOps;
+}
+
+double IndexStats::probeLocate(const FMIndex& index, length_t sf) const {
+    // a look-up takes sf / 2 LF steps on average
+    length_t numLookUps = max<length_t>(1 << 10, numOps / sf);
+    mt19937 rng(42);
+    uniform_int_distribution<length_t> rowDist(0, index.bwt.size() - 1);
+    vector<length_t> rows(numLookUps);
+    for (auto& r : rows) {
+        r = rowDist(rng);
+    }
+
+    length_t checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (length_t r : rows) {
+        checksum += index.findSA(r);
+    }
+    chrono::duration<double, nano> elapsed =
+        chrono::steady_clock::now() - start;
+
+    volatile length_t sink = checksum;
+    (void)sink;
+    return elapsed.count() / numLookUps;
+}
+
+void IndexStats::print(FMIndex& index, ostream& os) const {
+    const double MiB = 1024.0 * 1024.0;
+    const size_t n = index.bwt.size();
+    ios_base::fmtflags flags = os.flags();
+    streamsize precision = os.precision();
+    os << fixed << setprecision(2);
+
+    // A) the memory of the components
+    vector<pair<string, size_t>> usage = index.getMemoryUsage();
+    size_t total = 0, saBytes = 0;
+    os << "Index " << index.baseFile << ", " << n
+       << " characters, suffix array sparseness " << index.sparseFactorSA
+       << "\n";
+    os << left << setw(16) << "component" << right << setw(16) << "bytes"
+       << setw(12) << "MiB" << setw(12) << "bytes/char"
+       << "\n";
+    for (const auto& c : usage) {
+        os << left << setw(16) << c.first << right << setw(16) << c.second
+           << setw(12) << c.second / MiB << setw(12)
+           << (double)c.second / n << "\n";
+        total += c.second;
+        if (c.first == "sparseSA") {
+            saBytes = c.second;
+        }
+    }
+    os << left << setw(16) << "total" << right << setw(16) << total
+       << setw(12) << total / MiB << setw(12) << (double)total / n << "\n";
+
+    // the memory of the process that is not part of the index
+    size_t rss = getCurrentRSS();
+    size_t overhead = (rss > total) ? rss - total : 0;
+    os << "Resident memory: " << rss / MiB << " MiB, peak "
+       << getPeakRSS() / MiB << " MiB\n\n";
+
+    // B) the expected memory and locate throughput per sparseness factor
+    os << "Rank (BWTRepr::occ): " << probeRank(index) << " ns/op\n";
+    os << left << setw(12) << "sparseness" << right << setw(12) << "SA MiB"
+       << setw(16) << "expected MiB" << setw(16) << "locate ns/op"
+       << "\n";
+
+    SparseSuffixArray original = move(index.sparseSA);
+    length_t originalSF = index.sparseFactorSA;
+    for (length_t sf = 1; sf <= 256; sf *= 2) {
+        size_t sfBytes = SparseSuffixArray::getSizeInBytes(n, sf);
+        os << left << setw(12) << sf << right << setw(12) << sfBytes / MiB
+           << setw(16) << (overhead + total - saBytes + sfBytes) / MiB;
+
+        ifstream sa(index.baseFile + ".sa." + to_string(sf));
+        ifstream bv(index.baseFile + ".sa.bv." + to_string(sf));
+        if (sf == originalSF) {
+            index.sparseSA = move(original);
+        } else if (sa && bv) {
+            index.sparseSA = SparseSuffixArray(index.baseFile, sf, false);
+        } else {
+            os << setw(16) << "no files" << "\n";
+            continue;
+        }
+        index.sparseFactorSA = sf;
+        index.logSparseFactorSA = log2(sf);
+        os << setw(16) << probeLocate(index, sf) << "\n";
+        if (sf == originalSF) {
+            original = move(index.sparseSA);
+        }
+    }
+
+    // restore the suffix array the index was loaded with
+    index.sparseSA = move(original);
+    index.sparseFactorSA = originalSF;
+    index.logSparseFactorSA = log2(originalSF);
+
+    os << "Expected memory is the index with that suffix array plus "
+       << overhead / MiB << " MiB for the rest of the process\n";
+    os.flags(flags);
+    os.precision(precision);
+}
@@ -0,0 +1,86 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#ifndef INDEXSTATS_H
+#define INDEXSTATS_H
+
+#include "fmindex.h"
+
+#include <ostream>
+
+// ============================================================================
+// CLASS INDEXSTATS
+// ============================================================================
+
+/**
+ * Reports the memory used by the components of a loaded index, the expected
+ * resident set size for every sparseness factor of the suffix array, and the
+ * throughput of rank and locate queries, to choose a sparseness factor and
+ * memory limits for a machine.
+ */
+class IndexStats {
+  private:
+    length_t numOps; // the number of random queries of a probe
+
+    /**
+     * Times random rank queries on the forward BWT representation
+     * @param index the index
+     * @returns the time per query in ns
+     */
+    double probeRank(const FMIndex& index) const;
+
+    /**
+     * Times random look-ups in the suffix array of the index
+     * @param index the index
+     * @param sf the sparseness factor of the loaded suffix array
+     * @returns the time per look-up in ns
+     */
+    double probeLocate(const FMIndex& index, length_t sf) const;
+
+  public:
+    /**
+     * Constructor
+     * @param numOps the number of random queries of a probe, the look-ups
+     * in sparser suffix arrays are fewer as they are slower
+     */
+    IndexStats(length_t numOps = 1 << 16) : numOps(numOps) {
+    }
+
+    /**
+     * Prints the memory usage of the index, the expected memory for every
+     * sparseness factor and the throughput probes. The suffix array of every
+     * sparseness factor of which the files are present is loaded in turn,
+     * after which the original suffix array is restored.
+     * @param index the index
+     * @param os the stream to print to
+     */
+    void print(FMIndex& index, std::ostream& os) const;
+
+    /**
+     * @returns the resident set size of the process in bytes, 0 if unknown
+     */
+    static size_t getCurrentRSS();
+
+    /**
+     * @returns the peak resident set size of the process in bytes, never
+     * below the current resident set size
+     */
+    static size_t getPeakRSS();
+};
+
+#endif
@@ -0,0 +1,103 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#include "latency.h"
+
+#include <cmath>
+#include <iomanip>
+#include <string>
+
+using namespace std;
+
+// ============================================================================
+// CLASS LATENCYHISTOGRAM
+// ============================================================================
+
+const int LatencyHistogram::SUB_BITS;
+const uint64_t LatencyHistogram::SUB_COUNT;
+const uint64_t LatencyHistogram::HALF_COUNT;
+
+LatencyHistogram::LatencyHistogram()
+    : counts(SUB_COUNT + (64 - SUB_BITS) * HALF_COUNT, 0) {
+}
+
+size_t LatencyHistogram::getBucket(uint64_t value) {
+    if (value < SUB_COUNT) {
+        return value;
+    }
+    // shift the value such that it lies in [HALF_COUNT, SUB_COUNT)
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - (SUB_BITS - 1);
+    return SUB_COUNT + (shift - 1) * HALF_COUNT +
+           ((value >> shift) - HALF_COUNT);
+}
+
+uint64_t LatencyHistogram::getUpperBound(size_t bucket) {
+    if (bucket < SUB_COUNT) {
+        return bucket;
+    }
+    int shift = (bucket - SUB_COUNT) / HALF_COUNT + 1;
+    uint64_t sub = (bucket - SUB_COUNT) % HALF_COUNT + HALF_COUNT;
+    // the lowest value of the next bucket minus one, for the last bucket
+    // this is the largest 64-bit value
+    return (sub << shift) + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& o) {
+    for (size_t i = 0; i < counts.size(); i++) {
+        counts[i] += o.counts[i];
+    }
+    total += o.total;
+    sum += o.sum;
+    minimum = min(minimum, o.minimum);
+    maximum = max(maximum, o.maximum);
+}
+
+uint64_t LatencyHistogram::getPercentile(double percentile) const {
+    if (total == 0) {
+        return 0;
+    }
+    // the rank of the value at the percentile, at least the first value
+    uint64_t rank = ceil(percentile / 100.0 * total);
+    rank = max(rank, (uint64_t)1);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return min(getUpperBound(i), maximum);
+        }
+    }
+    return maximum;
+}
+
+void LatencyHistogram::print(ostream& os, const string& name) const {
+    auto micro = [](uint64_t nanos) { return nanos / 1000.0; };
+    ios_base::fmtflags flags = os.flags();
+    streamsize precision = os.precision();
+
+    os << "Latency per " << name << " (us): count " << total << ", mean "
+       << fixed << setprecision(1) << getMean() / 1000.0 << "\n";
+    os << "  min " << micro(getMin()) << ", p50 " << micro(getPercentile(50))
+       << ", p90 " << micro(getPercentile(90)) << ", p99 "
+       << micro(getPercentile(99)) << ", p99.9 " << micro(getPercentile(99.9))
+       << ", max " << micro(getMax()) << "\n";
+
+    os.flags(flags);
+    os.precision(precision);
+}
@@ -0,0 +1,132 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// CLASS LATENCYHISTOGRAM
+// ============================================================================
+
+/**
+ * A log-linear histogram of latencies in the style of HdrHistogram. Values
+ * below 2^SUB_BITS are recorded exactly, larger values fall in buckets of
+ * which the width doubles every power of two, with 2^(SUB_BITS - 1) buckets
+ * per power of two. The relative error of a reported percentile is thus at
+ * most 2^-(SUB_BITS - 1), over the full range of 64-bit values and in a
+ * fixed amount of memory.
+ */
+class LatencyHistogram {
+  private:
+    static const int SUB_BITS = 7;                    // the precision in bits
+    static const uint64_t SUB_COUNT = 1 << SUB_BITS;  // the linear range
+    static const uint64_t HALF_COUNT = SUB_COUNT / 2; // buckets per power
+
+    std::vector<uint64_t> counts;  // the number of values per bucket
+    uint64_t total = 0;            // the number of recorded values
+    uint64_t sum = 0;              // the sum of the recorded values
+    uint64_t minimum = UINT64_MAX; // the smallest recorded value
+    uint64_t maximum = 0;          // the largest recorded value
+
+    /**
+     * @param value the value
+     * @returns the index of the bucket of the value
+     */
+    static size_t getBucket(uint64_t value);
+
+    /**
+     * @param bucket the index of a bucket
+     * @returns the largest value that falls in the bucket
+     */
+    static uint64_t getUpperBound(size_t bucket);
+
+  public:
+    /**
+     * Constructor, creates an empty histogram
+     */
+    LatencyHistogram();
+
+    /**
+     * Records a value
+     * @param value the value to record
+     */
+    void record(uint64_t value) {
+        counts[getBucket(value)]++;
+        total++;
+        sum += value;
+        minimum = (value < minimum) ? value : minimum;
+        maximum = (value > maximum) ? value : maximum;
+    }
+
+    /**
+     * Adds the values of another histogram to this histogram
+     * @param o the other histogram
+     */
+    void merge(const LatencyHistogram& o);
+
+    /**
+     * @returns the number of recorded values
+     */
+    uint64_t getCount() const {
+        return total;
+    }
+
+    /**
+     * @returns the mean of the recorded values, 0 if there are none
+     */
+    double getMean() const {
+        return (total == 0) ? 0.0 : (double)sum / total;
+    }
+
+    /**
+     * @returns the largest recorded value, 0 if there are none
+     */
+    uint64_t getMax() const {
+        return maximum;
+    }
+
+    /**
+     * @returns the smallest recorded value, 0 if there are none
+     */
+    uint64_t getMin() const {
+        return (total == 0) ? 0 : minimum;
+    }
+
+    /**
+     * Finds the value below or at which a percentage of the recorded values
+     * lie, rounded up to the end of its bucket
+     * @param percentile the percentage, in [0, 100]
+     * @returns the value at the percentile, 0 if there are no values
+     */
+    uint64_t getPercentile(double percentile) const;
+
+    /**
+     * Prints the count, mean and percentiles of the histogram, the values
+     * are assumed to be in nanoseconds and printed in microseconds
+     * @param os the stream to print to
+     * @param name the name of the measured latencies
+     */
+    void print(std::ostream& os, const std::string& name) const;
+};
+
+#endif
@@ -16,9 +16,13 @@
  * You should have received a copy of the GNU Affero General Public License   *
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
  ******************************************************************************/
-#include "searchstrategy.h"
+#include "indexstats.h"
+#include "latency.h"
+#include "mapper.h"
+#include "reads.h"
 #include <algorithm>
 #include <chrono>
+#include <queue>
 #include <set>
 #include <string.h>
 
@@ -57,140 +61,124 @@ int editDistDP(string P, string O, int maxED) {
     return mat(m, n);
 }
 
-string getFileExt(const string& s) {
-
-    size_t i = s.rfind('.', s.length());
-    if (i != string::npos) {
-        return (s.substr(i + 1, s.length() - i));
+/**
+ * Writes an occurrence in the format:
+ * startposition\twidth\tdistance\tCIGAR, where startposition is the
+ * beginning of the text occurrence, width is the length of this occurrence,
+ * distance is the (edit or hamming) distance to the mapped read and CIGAR is
+ * the CIGAR string of the match or * if it was not calculated
+ * @param out the stream to write to
+ * @param occ the occurrence to write
+ * @param cigars the arena containing the CIGAR string of the occurrence
+ */
+void writeOcc(ostream& out, const TextOcc& occ, const CigarArena& cigars) {
+    out << occ.getRange().getBegin() << "\t" << occ.getRange().width() << "\t"
+        << occ.getDistance() << "\t";
+    if (!occ.hasCigar()) {
+        out << "*";
+    }
+    for (auto it = cigars.begin(occ); it != cigars.end(occ); it++) {
+        out << it->second << it->first;
     }
-
-    return ("");
 }
 
-vector<pair<string, string>> getReads(const string& file) {
-    vector<pair<string, string>> reads;
-    reads.reserve(200000);
+void writeToOutput(const string& file, const vector<vector<TextOcc>>& mPerRead,
+                   const vector<pair<string, string>>& reads,
+                   const CigarArena& cigars) {
 
-    const auto& extension = getFileExt(file);
+    cout << "Writing to output file " << file << " ..." << endl;
+    ofstream f2;
+    f2.open(file);
 
-    bool fasta =
-        (extension == "FASTA") || (extension == "fasta") || (extension == "fa");
-    bool fastq = (extension == "fq") || (extension == "fastq");
+    f2 << "identifier\tposition\tlength\tED\tCIGAR\treverseComplement\n";
+    for (unsigned int i = 0; i < reads.size(); i += 2) {
+        const auto& id = reads[i].first;
 
-    ifstream ifile(file.c_str());
-    if (!ifile) {
-        throw runtime_error("Cannot open file " + file);
-    }
-    if (!fasta && !fastq) {
-        // this is a csv file
-        if (extension != "csv") {
-            throw runtime_error("extension " + extension +
-                                " is not a valid extension for the readsfile");
+        for (const auto& m : mPerRead[i]) {
+            f2 << id << "\t";
+            writeOcc(f2, m, cigars);
+            f2 << "\t0\n";
         }
-        string line;
-        // get the first line we do not need this
-        getline(ifile, line);
-
-        while (getline(ifile, line)) {
-            istringstream iss{line};
 
-            vector<string> tokens;
-            string token;
-
-            while (getline(iss, token, ',')) {
-                tokens.push_back(token);
-            }
-            string position = tokens[1];
-            string read =
-                tokens[2]; // ED + 2 column contains a read with ED compared
-                           // to the read at position position with length
-            string p = position;
-            reads.push_back(make_pair(p, read));
+        for (const auto& m : mPerRead[i + 1]) {
+            f2 << id << "\t";
+            writeOcc(f2, m, cigars);
+            f2 << "\t1\n";
         }
-    } else if (fasta) {
-        // fasta file
-        string read = "";
-        string p = "";
-        string line;
-        while (getline(ifile, line)) {
-            if (!line.empty() && line[0] == '>') {
-
-                if (!read.empty()) {
-
-                    reads.push_back(make_pair(p, read));
-                    reads.push_back(
-                        make_pair(p, Nucleotide::getRevCompl(read)));
-                    read.clear();
-                }
+    }
 
-                p = (line.substr(1));
+    f2.close();
+}
 
-            } else {
-                read += line;
-            }
-        }
-        if (!read.empty()) {
+void writeRepetitiveToOutput(const string& file,
+                             const vector<length_t>& hitsPerRead,
+                             const vector<pair<string, string>>& reads,
+                             const SearchStrategy* strategy) {
 
-            reads.push_back(make_pair(p, read));
-            reads.push_back(make_pair(p, Nucleotide::getRevCompl(read)));
-            read.clear();
-        }
-    } else {
-        // fastQ
-        string read = "";
-        string id = "";
-        string line;
-        bool readLine = false;
-        while (getline(ifile, line)) {
-            if (!line.empty() && line[0] == '@') {
-                if (!read.empty()) {
-
-                    reads.push_back(make_pair(id, read));
-                    reads.push_back(
-                        make_pair(id, Nucleotide::getRevCompl(read)));
-                    read.clear();
-                }
-                id = (line.substr(1));
-                readLine = true;
-            } else if (readLine) {
-                read = line;
-                readLine = false;
-            }
-        }
-        if (!read.empty()) {
+    cout << "Writing repetitive reads to " << file << " ..." << endl;
+    ofstream f2;
+    f2.open(file);
 
-            reads.push_back(make_pair(id, read));
-            reads.push_back(make_pair(id, Nucleotide::getRevCompl(read)));
-            read.clear();
+    f2 << "identifier\thits\treverseComplement\n";
+    for (unsigned int i = 0; i < reads.size(); i++) {
+        if (strategy->isRepetitive(hitsPerRead[i])) {
+            f2 << reads[i - (i % 2)].first << "\t" << hitsPerRead[i] << "\t"
+               << i % 2 << "\n";
         }
     }
 
-    return reads;
+    f2.close();
 }
 
-void writeToOutput(const string& file, const vector<vector<TextOcc>>& mPerRead,
-                   const vector<pair<string, string>>& reads) {
+/**
+ * A read together with the time and the work it took to map it and its
+ * reverse complement
+ */
+struct SlowRead {
+    uint64_t nanos;       // the time to map the read
+    length_t index;       // the index of the read in the reads
+    CounterSnapshot work; // the counters for the read
+
+    bool operator>(const SlowRead& o) const {
+        return nanos > o.nanos;
+    }
+};
 
-    cout << "Writing to output file " << file << " ..." << endl;
+void writeSlowestToOutput(const string& file, vector<SlowRead>& slowReads,
+                          const vector<pair<string, string>>& reads) {
+
+    cout << "Writing slowest reads to " << file << " ..." << endl;
     ofstream f2;
     f2.open(file);
 
-    f2 << "identifier\tposition\tlength\tED\tCIGAR\treverseComplement\n";
-    for (unsigned int i = 0; i < reads.size(); i += 2) {
-        auto id = reads[i].first;
-
-        for (auto m : mPerRead[i]) {
-            f2 << id << "\t" << m.getOutput() << "\t0\n";
-        }
-
-        for (auto m : mPerRead[i + 1]) {
-            f2 << id << "\t" << m.getOutput() << "\t1\n";
-        }
+    // the slowest read first
+    sort(slowReads.begin(), slowReads.end(), greater<SlowRead>());
+
+    f2 << "identifier\tmicroseconds\tnodes\treportedPositions\tcigars\t"
+          "inTextStarted\tinTextAborted\tinTextReported\timmediateSwitches\t"
+          "searchesStarted\tsequence\n";
+    for (const SlowRead& r : slowReads) {
+        const CounterSnapshot& w = r.work;
+        f2 << reads[r.index].first << "\t" << r.nanos / 1000.0 << "\t"
+           << w.nodeCounter << "\t" << w.totalReportedPositions << "\t"
+           << w.cigarsComputed << "\t" << w.inTextStarted << "\t"
+           << w.abortedInTextVerificationCounter << "\t" << w.inTextReported
+           << "\t" << w.immediateSwitch << "\t" << w.approximateSearchStarted
+           << "\t" << reads[r.index].second << "\n";
     }
 
     f2.close();
 }
 
+/**
+ * @param ED the maximal edit distance
+ * @returns the number of reads between two progress updates, which
+ * decreases with the edit distance but is at least 1
+ */
+length_t getProgressInterval(length_t ED) {
+    return max<length_t>(1, 8192 >> min<length_t>(ED, 13));
+}
+
 double findMedian(vector<length_t> a, int n) {
 
     // If size of the arr[] is even
@@ -223,7 +211,8 @@ double findMedian(vector<length_t> a, int n) {
 }
 
 void doBench(vector<pair<string, string>>& reads, FMIndex& mapper,
-             SearchStrategy* strategy, string readsFile, length_t ED) {
+             SearchStrategy* strategy, string readsFile, length_t ED,
+             length_t slowest, length_t traceReads) {
 
     size_t totalUniqueMatches = 0, sizes = 0, mappedReads = 0;
 
@@ -231,8 +220,14 @@ void doBench(vector<pair<string, string>>& reads, FMIndex& mapper,
          << " strategy for max distance " << ED << " with "
          << strategy->getPartitioningStrategy() << " partitioning and using "
          << strategy->getDistanceMetric() << " distance " << endl;
-    cout << "Switching to in text verification at "
-         << strategy->getSwitchPoint() << endl;
+    if (mapper.isSwitchAdaptive()) {
+        cout << "Switching to in text verification by the calibrated cost "
+                "model"
+             << endl;
+    } else {
+        cout << "Switching to in text verification at "
+             << strategy->getSwitchPoint() << endl;
+    }
     cout.precision(2);
 
     vector<vector<TextOcc>> matchesPerRead = {};
@@ -241,8 +236,21 @@ void doBench(vector<pair<string, string>>& reads, FMIndex& mapper,
     std::vector<length_t> numberMatchesPerRead;
     numberMatchesPerRead.reserve(reads.size());
 
+    // the number of hits per strand, to detect repetitive reads
+    std::vector<length_t> hitsPerRead;
+    hitsPerRead.reserve(reads.size());
+    size_t repetitiveReads = 0;
+
     Counters counters;
 
+    // the CIGAR strings of all reads, the occurrences refer to these
+    CigarArena cigars;
+
+    // the time to map each read and its reverse complement
+    LatencyHistogram latencies;
+    // the slowest reads, the fastest of them on top
+    priority_queue<SlowRead, vector<SlowRead>, greater<SlowRead>> slowReads;
+
     auto start = chrono::high_resolution_clock::now();
     for (unsigned int i = 0; i < reads.size(); i += 2) {
 
@@ -252,30 +260,64 @@ void doBench(vector<pair<string, string>>& reads, FMIndex& mapper,
         string read = p.second;
         string revCompl = reads[i + 1].second;
 
-        if (((i >> 1) - 1) % (8192 / (1 << ED)) == 0) {
+        if (((i >> 1) - 1) % getProgressInterval(ED) == 0) {
             cout << "Progress: " << i / 2 << "/" << reads.size() / 2 << "\r";
             cout.flush();
         }
 
         sizes += read.size();
 
-        auto matches = strategy->matchApprox(read, ED, counters);
+        // trace the first reads only
+        Tracer::setActive(i / 2 < traceReads);
+        TraceSpan span("read", "read");
+        span.arg("identifier", originalPos);
+
+        // count the work for this read only, if it is to be reported
+        CounterSnapshot before;
+        if (slowest != 0) {
+            before = counters.getSnapshot();
+            counters.resetCounters();
+        }
+        auto readStart = chrono::steady_clock::now();
+
+        length_t hits, hitsRevCompl;
+        auto matches =
+            strategy->matchApprox(read, ED, counters, cigars, hits);
         totalUniqueMatches += matches.size();
 
         // do the same for the reverse complement
         vector<TextOcc> matchesRevCompl =
-            strategy->matchApprox(revCompl, ED, counters);
+            strategy->matchApprox(revCompl, ED, counters, cigars, hitsRevCompl);
         totalUniqueMatches += matchesRevCompl.size();
 
+        uint64_t nanos = chrono::duration_cast<chrono::nanoseconds>(
+                             chrono::steady_clock::now() - readStart)
+                             .count();
+        latencies.record(nanos);
+        if (slowest != 0) {
+            CounterSnapshot work = counters.getSnapshot();
+            if (slowReads.size() < slowest) {
+                slowReads.push({nanos, i, work});
+            } else if (nanos > slowReads.top().nanos) {
+                slowReads.pop();
+                slowReads.push({nanos, i, work});
+            }
+            before.add(work);
+            counters.restoreSnapshot(before);
+        }
+
+        hitsPerRead.emplace_back(hits);
+        hitsPerRead.emplace_back(hitsRevCompl);
+        repetitiveReads += strategy->isRepetitive(hits) ||
+                           strategy->isRepetitive(hitsRevCompl);
+
         // keep track of the number of mapped reads
         mappedReads += !(matchesRevCompl.empty() && matches.empty());
 
-        matchesPerRead.emplace_back(matches);
-        matchesPerRead.emplace_back(matchesRevCompl);
-
         numberMatchesPerRead.emplace_back(matches.size() +
                                           matchesRevCompl.size());
 
+
         // correctness check, comment this out if you want to check
         // For each reported match the reported edit distance is checked and
         // compared to a recalculated value using a single banded matrix this
@@ -329,14 +371,21 @@ void doBench(vector<pair<string, string>>& reads, FMIndex& mapper,
           if (matches.size() == 0 || (!originalFound)) {
               cout << "Could not find occurrence for " << originalPos << endl;
           }*/
+
+        matchesPerRead.emplace_back(move(matches));
+        matchesPerRead.emplace_back(move(matchesRevCompl));
     }
 
     auto finish = chrono::high_resolution_clock::now();
+    Tracer::setActive(false);
     chrono::duration<double> elapsed = finish - start;
     cout << "Progress: " << reads.size() << "/" << reads.size() << "\n";
     cout << "Results for " << strategy->getName() << endl;
 
     cout << "Total duration: " << fixed << elapsed.count() << "s\n";
+    cout << "Reads per second: " << (reads.size() / 2.0) / elapsed.count()
+         << "\n";
+    latencies.print(cout, "read (both strands)");
     cout << "Average no. nodes: " << counters.nodeCounter / (reads.size() / 2.0)
          << endl;
     cout << "Total no. Nodes: " << counters.nodeCounter << "\n";
@@ -349,15 +398,17 @@ void doBench(vector<pair<string, string>>& reads, FMIndex& mapper,
     cout << "Total no. reported matches: " << counters.totalReportedPositions
          << "\n";
     cout << "Mapped reads: " << mappedReads << endl;
+    if (strategy->getMaxHits() != 0) {
+        cout << "Repetitive reads (more than " << strategy->getMaxHits()
+             << " hits): " << repetitiveReads << endl;
+    }
     cout << "Median number of occurrences per read "
          << findMedian(numberMatchesPerRead, numberMatchesPerRead.size())
          << endl;
     cout << "Reported matches via in-text verification: "
-         << counters.cigarsInTextVerification << endl;
-    cout << "Unique matches via (partial) in-text verification "
-         << counters.usefulCigarsInText << endl;
-    cout << "Unique matches via pure in-index matching "
-         << counters.cigarsInIndex << endl;
+         << counters.inTextReported << endl;
+    cout << "CIGAR strings calculated for unique matches "
+         << counters.cigarsComputed << endl;
     cout << "In text verification procedures " << counters.inTextStarted
          << endl;
     cout << "Failed in-text verifications procedures: "
@@ -373,14 +424,110 @@ void doBench(vector<pair<string, string>>& reads, FMIndex& mapper,
          << counters.approximateSearchStarted << endl;
 
     cout << "Average size of reads: " << sizes / (reads.size() / 2.0) << endl;
+    cout << "Peak memory: " << IndexStats::getPeakRSS() / 1024 << " kB"
+         << endl;
+
+    ScopedPhase scope(OUTPUT);
+    writeToOutput(readsFile + "_output.txt", matchesPerRead, reads, cigars);
+    if (strategy->getMaxHits() != 0) {
+        writeRepetitiveToOutput(readsFile + "_repetitive.txt", hitsPerRead,
+                                reads, strategy);
+    }
+    if (slowest != 0) {
+        vector<SlowRead> slowestReads;
+        while (!slowReads.empty()) {
+            slowestReads.push_back(slowReads.top());
+            slowReads.pop();
+        }
+        writeSlowestToOutput(readsFile + "_slowest.txt", slowestReads, reads);
+    }
+    if (traceReads != 0) {
+        Tracer::write(readsFile + "_trace.json");
+    }
+}
+
+void writeCountsToOutput(const string& file,
+                         const vector<vector<length_t>>& countsPerRead,
+                         const vector<pair<string, string>>& reads,
+                         length_t ED) {
+
+    cout << "Writing to output file " << file << " ..." << endl;
+    ofstream f2;
+    f2.open(file);
 
-    writeToOutput(readsFile + "_output.txt", matchesPerRead, reads);
+    f2 << "identifier";
+    for (length_t d = 0; d <= ED; d++) {
+        f2 << "\tcount" << d;
+    }
+    f2 << "\treverseComplement\n";
+
+    for (unsigned int i = 0; i < reads.size(); i++) {
+        f2 << reads[i].first;
+        for (const auto& c : countsPerRead[i]) {
+            f2 << "\t" << c;
+        }
+        f2 << "\t" << (i & 1) << "\n";
+    }
+
+    f2.close();
+}
+
+void doCount(vector<pair<string, string>>& reads, SearchStrategy* strategy,
+             string readsFile, length_t ED) {
+
+    cout << "Counting with " << strategy->getName()
+         << " strategy for max distance " << ED << " with "
+         << strategy->getPartitioningStrategy() << " partitioning and using "
+         << strategy->getDistanceMetric() << " distance " << endl;
+    cout.precision(2);
+
+    vector<vector<length_t>> countsPerRead;
+    countsPerRead.reserve(reads.size());
+
+    vector<length_t> totalCounts(ED + 1, 0);
+    Counters counters;
+
+    auto start = chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < reads.size(); i++) {
+        if (((i >> 1) - 1) % getProgressInterval(ED) == 0) {
+            cout << "Progress: " << i / 2 << "/" << reads.size() / 2 << "\r";
+            cout.flush();
+        }
+
+        countsPerRead.emplace_back(
+            strategy->countApprox(reads[i].second, ED, counters));
+        for (length_t d = 0; d < countsPerRead.back().size(); d++) {
+            totalCounts[d] += countsPerRead.back()[d];
+        }
+    }
+    auto finish = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed = finish - start;
+    cout << "Progress: " << reads.size() << "/" << reads.size() << "\n";
+    cout << "Results for " << strategy->getName() << endl;
+
+    cout << "Total duration: " << fixed << elapsed.count() << "s\n";
+    cout << "Reads per second: " << (reads.size() / 2.0) / elapsed.count()
+         << "\n";
+    cout << "Average no. nodes: " << counters.nodeCounter / (reads.size() / 2.0)
+         << endl;
+    cout << "Total no. Nodes: " << counters.nodeCounter << "\n";
+    for (length_t d = 0; d <= ED; d++) {
+        cout << "Total no. occurrences at distance " << d << ": "
+             << totalCounts[d] << "\n";
+    }
+    cout << "Peak memory: " << IndexStats::getPeakRSS() / 1024 << " kB"
+         << endl;
+
+    ScopedPhase scope(OUTPUT);
+    writeCountsToOutput(readsFile + "_counts.txt", countsPerRead, reads, ED);
 }
 
 void showUsage() {
     cout << "Usage: ./columba [options] basefilename readfile.[ext]\n\n";
     cout << " [options]\n";
-    cout << "  -e  --max-ed\t\tmaximum edit distance [default = 0]\n";
+    cout << "  -e  --max-ed\t\tmaximum edit distance, at most 6, at most 10 "
+            "for a custom scheme or at most 20 for the naive scheme "
+            "[default = 0]\n";
     cout << "  -s  --sa-sparseness\tsuffix array sparseness factor "
             "[default = "
             "1]\n";
@@ -390,8 +537,29 @@ void showUsage() {
     cout << "  -m   --metric\tAdd flag to set distance metric "
             "(editnaive/editopt/hamming) [default = "
             "editopt]\n";
-    cout << "  -i  --in-text\tThe tipping point for in-text verification "
-            "[default = 5]\n";
+    cout << "  -i  --in-text\tThe tipping point for in-text verification, "
+            "or auto to calibrate a cost model on the index that decides per "
+            "node [default = 5]\n";
+    cout << "  -nc --no-cigar\tDo not calculate CIGAR strings, only positions "
+            "and distances are reported\n";
+    cout << "  -c  --count\tOnly count the occurrences per distance, without "
+            "locating them\n";
+    cout << "  -mh --max-hits\tMaximal number of occurrences located per "
+            "strand, reads with more hits, counted as with --count, are "
+            "reported as repetitive [default = 0 (no maximum)]\n";
+    cout << "  -sr --sample-repeats\tReport a sample of at most max-hits "
+            "occurrences for repetitive reads instead of none, only max-hits "
+            "of their occurrences are located\n";
+    cout << "  -sl --slowest\tWrite the identifiers, sequences and counters "
+            "of the N slowest reads to readfile_slowest.txt [default = 0]\n";
+    cout << "  -tr --trace\tWrite a Chrome trace of the searches for the first "
+            "N reads to readfile_trace.json [default = 0]\n";
+    cout << "  -st --stats\tPrint the memory used by the index, the expected "
+            "memory per suffix array sparseness and the rank and locate "
+            "throughput before mapping\n";
+    cout << "  -pf --profile\tTime the phases of the mapping, with time or "
+            "with all to also count cycles, LLC misses and branch misses "
+            "(costs a system call per phase switch)\n";
     cout << "  -ss --search-scheme\tChoose the search scheme\n  options:\n\t"
          << "kuch1\tKucherov k + 1\n\t"
          << "kuch2\tKucherov k + 2\n\t"
@@ -439,6 +607,13 @@ int main(int argc, char* argv[]) {
     string searchscheme = "kuch1";
     string customFile = "";
     string inTextPoint = "5";
+    bool generateCigars = true;
+    bool countOnly = false;
+    string maxHits = "0";
+    bool sampleRepeats = false;
+    string slowest = "0";
+    string traceReads = "0";
+    bool printStats = false;
 
     PartitionStrategy pStrat = DYNAMIC;
     DistanceMetric metric = EDITOPTIMIZED;
@@ -521,6 +696,46 @@ int main(int argc, char* argv[]) {
             } else {
                 throw runtime_error(arg + " takes 1 argument as input");
             }
+        } else if (arg == "-nc" || arg == "--no-cigar") {
+            generateCigars = false;
+        } else if (arg == "-c" || arg == "--count") {
+            countOnly = true;
+        } else if (arg == "-mh" || arg == "--max-hits") {
+            if (i + 1 < argc) {
+                maxHits = argv[++i];
+            } else {
+                throw runtime_error(arg + " takes 1 argument as input");
+            }
+        } else if (arg == "-sr" || arg == "--sample-repeats") {
+            sampleRepeats = true;
+        } else if (arg == "-sl" || arg == "--slowest") {
+            if (i + 1 < argc) {
+                slowest = argv[++i];
+            } else {
+                throw runtime_error(arg + " takes 1 argument as input");
+            }
+        } else if (arg == "-tr" || arg == "--trace") {
+            if (i + 1 < argc) {
+                traceReads = argv[++i];
+            } else {
+                throw runtime_error(arg + " takes 1 argument as input");
+            }
+        } else if (arg == "-st" || arg == "--stats") {
+            printStats = true;
+        } else if (arg == "-pf" || arg == "--profile") {
+            if (i + 1 < argc) {
+                string s = argv[++i];
+                if (s == "time") {
+                    Profiler::enable(false);
+                } else if (s == "all") {
+                    Profiler::enable(true);
+                } else {
+                    throw runtime_error(s + " is not a profile option\nOptions "
+                                            "are: time, all");
+                }
+            } else {
+                throw runtime_error(arg + " takes 1 argument as input");
+            }
         }
 
         else {
@@ -530,8 +745,17 @@ int main(int argc, char* argv[]) {
     }
 
     length_t ed = stoi(maxED);
-    if (ed < 0 || ed > 6) {
-        cerr << ed << " is not allowed as maxED should be in [0, 4]" << endl;
+    // the naive backtracking does not use search schemes, so it is only
+    // limited by the widest bit-parallel matrix
+    length_t maxAllowedED = 6;
+    if (searchscheme == "naive") {
+        maxAllowedED = WideBitParallelED::MAX_ED;
+    } else if (searchscheme == "custom") {
+        maxAllowedED = CustomSearchStrategy::MAX_SCORE;
+    }
+    if (ed < 0 || ed > maxAllowedED) {
+        cerr << ed << " is not allowed as maxED should be in [0, "
+             << maxAllowedED << "]" << endl;
 
         return EXIT_FAILURE;
     }
@@ -542,11 +766,8 @@ int main(int argc, char* argv[]) {
              << endl;
     }
 
-    length_t inTextSwitchPoint = stoi(inTextPoint);
-
-    if (ed != 4 && searchscheme == "manbest") {
-        throw runtime_error("manbest only supports 4 allowed errors");
-    }
+    bool adaptiveSwitch = inTextPoint == "auto";
+    length_t inTextSwitchPoint = adaptiveSwitch ? 0 : stoi(inTextPoint);
 
     string baseFile = argv[argc - 2];
     string readsFile = argv[argc - 1];
@@ -554,6 +775,7 @@ int main(int argc, char* argv[]) {
     cout << "Reading in reads from " << readsFile << endl;
     vector<pair<string, string>> reads;
     try {
+        ScopedPhase scope(READ_PARSING);
         reads = getReads(readsFile);
     } catch (const exception& e) {
         string er = e.what();
@@ -562,31 +784,30 @@ int main(int argc, char* argv[]) {
     }
 
     FMIndex bwt = FMIndex(baseFile, inTextSwitchPoint, saSF);
+    if (adaptiveSwitch) {
+        bwt.calibrateInTextSwitch();
+    }
+    if (printStats) {
+        IndexStats().print(bwt, cout);
+    }
 
-    SearchStrategy* strategy;
-    if (searchscheme == "kuch1") {
-        strategy = new KucherovKplus1(bwt, pStrat, metric);
-    } else if (searchscheme == "kuch2") {
-        strategy = new KucherovKplus2(bwt, pStrat, metric);
-    } else if (searchscheme == "kianfar") {
-        strategy = new OptimalKianfar(bwt, pStrat, metric);
-    } else if (searchscheme == "manbest") {
-        strategy = new ManBestStrategy(bwt, pStrat, metric);
-    } else if (searchscheme == "01*0") {
-        strategy = new O1StarSearchStrategy(bwt, pStrat, metric);
-    } else if (searchscheme == "pigeon") {
-        strategy = new PigeonHoleSearchStrategy(bwt, pStrat, metric);
-    } else if (searchscheme == "custom") {
-        strategy = new CustomSearchStrategy(bwt, customFile, pStrat, metric);
-    } else if (searchscheme == "naive") {
-        strategy = new NaiveBackTrackingStrategy(bwt, pStrat, metric);
+    SearchStrategy* strategy =
+        createSearchStrategy(bwt, searchscheme, ed, pStrat, metric, customFile);
+    strategy->setGenerateCigars(generateCigars);
+    strategy->setMaxHits(stoi(maxHits), sampleRepeats);
+
+    if (countOnly) {
+        doCount(reads, strategy, readsFile, ed);
     } else {
-        // should not get here
-        throw runtime_error(searchscheme +
-                            " is not on option as search scheme");
+        if (stoi(traceReads) != 0) {
+            Tracer::enable();
+        }
+        doBench(reads, bwt, strategy, readsFile, ed, stoi(slowest),
+                stoi(traceReads));
     }
-
-    doBench(reads, bwt, strategy, readsFile, ed);
     delete strategy;
+    if (Profiler::isEnabled()) {
+        Profiler::printSummary(cout);
+    }
     cout << "Bye...\n";
 }
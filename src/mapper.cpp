@@ -0,0 +1,125 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#include "mapper.h"
+
+using namespace std;
+
+// ============================================================================
+// FACTORY FOR SEARCH STRATEGIES
+// ============================================================================
+
+SearchStrategy* createSearchStrategy(const FMIndex& index,
+                                     const string& scheme, length_t maxED,
+                                     PartitionStrategy p,
+                                     DistanceMetric metric,
+                                     const string& customFolder) {
+    if (maxED != 4 && scheme == "manbest") {
+        throw runtime_error("manbest only supports 4 allowed errors");
+    }
+
+    if (scheme == "kuch1") {
+        return new KucherovKplus1(index, p, metric);
+    } else if (scheme == "kuch2") {
+        return new KucherovKplus2(index, p, metric);
+    } else if (scheme == "kianfar") {
+        return new OptimalKianfar(index, p, metric);
+    } else if (scheme == "manbest") {
+        return new ManBestStrategy(index, p, metric);
+    } else if (scheme == "01*0") {
+        return new O1StarSearchStrategy(index, p, metric);
+    } else if (scheme == "pigeon") {
+        return new PigeonHoleSearchStrategy(index, p, metric);
+    } else if (scheme == "custom") {
+        return new CustomSearchStrategy(index, customFolder, p, metric);
+    } else if (scheme == "naive") {
+        return new NaiveBackTrackingStrategy(index, p, metric);
+    }
+    throw runtime_error(scheme + " is not on option as search scheme");
+}
+
+// ============================================================================
+// CLASS MAPPER
+// ============================================================================
+
+Mapper::Mapper(const FMIndex& index, const string& scheme, length_t maxED,
+               PartitionStrategy p, DistanceMetric metric,
+               const string& customFolder, bool bothStrands)
+    : index(index),
+      strategy(createSearchStrategy(index, scheme, maxED, p, metric,
+                                    customFolder)),
+      maxED(maxED), bothStrands(bothStrands) {
+}
+
+void Mapper::append(const string& seq, bool rc, MappingBatch& batch,
+                    Counters& counters) const {
+    length_t hits;
+    const auto& occs =
+        strategy->matchApprox(seq, maxED, counters, batch.cigars, hits);
+
+    batch.hits.back() += hits;
+    if (strategy->isRepetitive(hits)) {
+        batch.repetitive.back() = true;
+    }
+
+    for (const auto& o : occs) {
+        MappedOcc m;
+        m.begin = o.getRange().getBegin();
+        m.length = o.getRange().width();
+        m.distance = o.getDistance();
+        m.cigarBegin = o.getCigarOffset();
+        m.cigarEnd = o.getCigarOffset() + o.getCigarLength();
+        m.reverseComplement = rc;
+        batch.occurrences.push_back(m);
+    }
+}
+
+void Mapper::map(const vector<string>& sequences, MappingBatch& batch,
+                 Counters& counters) const {
+    batch.clear();
+    batch.firstOcc.reserve(sequences.size() + 1);
+    batch.hits.reserve(sequences.size());
+    batch.repetitive.reserve(sequences.size());
+
+    for (const auto& seq : sequences) {
+        batch.hits.push_back(0);
+        batch.repetitive.push_back(false);
+        append(seq, false, batch, counters);
+        if (bothStrands) {
+            append(Nucleotide::getRevCompl(seq), true, batch, counters);
+        }
+        batch.firstOcc.push_back(batch.occurrences.size());
+    }
+}
+
+void Mapper::count(const vector<string>& sequences, vector<length_t>& counts,
+                   Counters& counters) const {
+    counts.assign(sequences.size() * (maxED + 1), 0);
+
+    for (length_t i = 0; i < sequences.size(); i++) {
+        auto c = strategy->countApprox(sequences[i], maxED, counters);
+        if (bothStrands) {
+            auto rc = strategy->countApprox(
+                Nucleotide::getRevCompl(sequences[i]), maxED, counters);
+            for (length_t d = 0; d < rc.size(); d++) {
+                c[d] += rc[d];
+            }
+        }
+        copy(c.begin(), c.end(), counts.begin() + i * (maxED + 1));
+    }
+}
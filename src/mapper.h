@@ -0,0 +1,279 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#ifndef MAPPER_H
+#define MAPPER_H
+
+#include "searchstrategy.h"
+
+#include <memory>
+
+// ============================================================================
+// FACTORY FOR SEARCH STRATEGIES
+// ============================================================================
+
+/**
+ * Creates the search strategy corresponding to the name of a search scheme.
+ * The caller takes ownership of the returned strategy.
+ * @param index the index to search in
+ * @param scheme the name of the search scheme, one of kuch1, kuch2, kianfar,
+ * manbest, pigeon, 01*0, custom or naive
+ * @param maxED the maximal allowed distance the strategy will be used for
+ * @param p the partitioning strategy
+ * @param metric the distance metric
+ * @param customFolder the folder with the custom search scheme, only used if
+ * scheme is custom
+ * @returns a pointer to the newly created search strategy
+ */
+SearchStrategy* createSearchStrategy(const FMIndex& index,
+                                     const std::string& scheme, length_t maxED,
+                                     PartitionStrategy p = DYNAMIC,
+                                     DistanceMetric metric = EDITOPTIMIZED,
+                                     const std::string& customFolder = "");
+
+// ============================================================================
+// STRUCT MAPPEDOCC
+// ============================================================================
+
+/**
+ * A compact occurrence of a mapped sequence in the text. The CIGAR string is
+ * not stored in the occurrence itself, but in the batch the occurrence belongs
+ * to.
+ */
+struct MappedOcc {
+    length_t begin;         // the begin position in the text
+    length_t length;        // the length of the occurrence in the text
+    length_t distance;      // the (edit or hamming) distance to the sequence
+    length_t cigarBegin;    // index of the first CIGAR operation in the batch
+    length_t cigarEnd;      // index past the last CIGAR operation in the batch
+    bool reverseComplement; // true if the reverse complement was matched
+};
+
+// ============================================================================
+// CLASS MAPPINGBATCH
+// ============================================================================
+
+/**
+ * The result of mapping a batch of sequences. The occurrences of all sequences
+ * are stored contiguously, the occurrences of sequence i are in
+ * [begin(i), end(i)). A batch can be reused for several calls to Mapper::map,
+ * its memory is then recycled.
+ */
+class MappingBatch {
+  private:
+    std::vector<MappedOcc> occurrences; // the occurrences of all sequences
+    std::vector<length_t> firstOcc; // per sequence the index of its first
+                                    // occurrence, plus a closing sentinel
+    std::vector<length_t> hits;   // per sequence the number of hits
+    std::vector<bool> repetitive; // per sequence true if it has more hits
+                                  // than the maximum of the mapper
+    CigarArena cigars; // the CIGAR strings of all occurrences
+
+    friend class Mapper;
+
+  public:
+    MappingBatch() : firstOcc(1, 0) {
+    }
+
+    /**
+     * Removes all sequences and occurrences from this batch, the allocated
+     * memory is kept
+     */
+    void clear() {
+        occurrences.clear();
+        cigars.clear();
+        firstOcc.assign(1, 0);
+        hits.clear();
+        repetitive.clear();
+    }
+
+    /**
+     * @returns the number of sequences in this batch
+     */
+    length_t size() const {
+        return firstOcc.size() - 1;
+    }
+
+    /**
+     * @returns the total number of occurrences in this batch
+     */
+    length_t getNumberOfOccurrences() const {
+        return occurrences.size();
+    }
+
+    /**
+     * @param i the index of the sequence in the batch
+     * @returns a pointer to the first occurrence of sequence i
+     */
+    const MappedOcc* begin(length_t i) const {
+        return occurrences.data() + firstOcc[i];
+    }
+
+    /**
+     * @param i the index of the sequence in the batch
+     * @returns a pointer past the last occurrence of sequence i
+     */
+    const MappedOcc* end(length_t i) const {
+        return occurrences.data() + firstOcc[i + 1];
+    }
+
+    /**
+     * @param i the index of the sequence in the batch
+     * @returns the number of hits of sequence i, summed over both strands,
+     * as counted in count mode, 0 if the mapper has no maximal number of
+     * hits
+     */
+    length_t getHits(length_t i) const {
+        return hits[i];
+    }
+
+    /**
+     * @param i the index of the sequence in the batch
+     * @returns true if sequence i has more hits than the maximum of the
+     * mapper on at least one strand, its occurrences are then at most a
+     * sample
+     */
+    bool isRepetitive(length_t i) const {
+        return repetitive[i];
+    }
+
+    /**
+     * Creates the textual CIGAR string of an occurrence in this batch
+     * @param occ the occurrence
+     * @returns the CIGAR string
+     */
+    std::string getCIGAR(const MappedOcc& occ) const {
+        std::string cigar;
+        for (length_t i = occ.cigarBegin; i < occ.cigarEnd; i++) {
+            cigar += std::to_string(cigars[i].second) + cigars[i].first;
+        }
+        return cigar;
+    }
+};
+
+// ============================================================================
+// CLASS MAPPER
+// ============================================================================
+
+/**
+ * In-process entry point for mapping sequences to a loaded index. The index is
+ * only read, all scratch space of the search lives in thread-local storage, so
+ * a single Mapper can be shared by several threads that each map their own
+ * batches.
+ */
+class Mapper {
+  private:
+    const FMIndex& index;                     // the index to map to
+    std::unique_ptr<SearchStrategy> strategy; // the search strategy
+    length_t maxED;                           // the maximal allowed distance
+    bool bothStrands; // map the reverse complement as well
+
+    /**
+     * Maps one strand of a sequence and appends its occurrences to the batch
+     * @param seq the strand to map
+     * @param rc true if the strand is the reverse complement
+     * @param batch the batch to append to
+     * @param counters the performance counters
+     */
+    void append(const std::string& seq, bool rc, MappingBatch& batch,
+                Counters& counters) const;
+
+  public:
+    /**
+     * Constructor
+     * @param index the index to map to, must outlive the mapper
+     * @param scheme the name of the search scheme
+     * @param maxED the maximal allowed distance
+     * @param p the partitioning strategy
+     * @param metric the distance metric
+     * @param customFolder the folder with the custom search scheme, only used
+     * if scheme is custom
+     * @param bothStrands if true the reverse complement of each sequence is
+     * mapped as well
+     */
+    Mapper(const FMIndex& index, const std::string& scheme, length_t maxED,
+           PartitionStrategy p = DYNAMIC, DistanceMetric metric = EDITOPTIMIZED,
+           const std::string& customFolder = "", bool bothStrands = true);
+
+    /**
+     * Maps a batch of sequences. Any previous content of the batch is
+     * discarded.
+     * @param sequences the sequences to map
+     * @param batch the result, sequence i in the batch corresponds to
+     * sequences[i]
+     * @param counters the performance counters
+     */
+    void map(const std::vector<std::string>& sequences, MappingBatch& batch,
+             Counters& counters) const;
+
+    /**
+     * Maps a batch of sequences. Any previous content of the batch is
+     * discarded.
+     * @param sequences the sequences to map
+     * @param batch the result, sequence i in the batch corresponds to
+     * sequences[i]
+     */
+    void map(const std::vector<std::string>& sequences,
+             MappingBatch& batch) const {
+        Counters counters;
+        map(sequences, batch, counters);
+    }
+
+    /**
+     * Counts the occurrences of a batch of sequences per distance, without
+     * locating them in the text
+     * @param sequences the sequences to count
+     * @param counts the result, counts[i * (maxED + 1) + d] is the number of
+     * occurrences of sequences[i] at distance d, summed over both strands if
+     * the reverse complement is mapped as well
+     * @param counters the performance counters
+     */
+    void count(const std::vector<std::string>& sequences,
+               std::vector<length_t>& counts, Counters& counters) const;
+
+    /**
+     * Sets whether the CIGAR strings of the occurrences should be calculated,
+     * must not be called while sequences are being mapped
+     * @param generate true if CIGAR strings should be calculated
+     */
+    void setGenerateCigars(bool generate) {
+        strategy->setGenerateCigars(generate);
+    }
+
+    /**
+     * Sets the maximal number of occurrences that are located per strand of a
+     * sequence, must not be called while sequences are being mapped
+     * @param maxHits the maximal number of occurrences, 0 if there is no
+     * maximum
+     * @param sample true if a deterministic sample of maxHits occurrences
+     * should be reported for repetitive sequences instead of none
+     */
+    void setMaxHits(length_t maxHits, bool sample = false) {
+        strategy->setMaxHits(maxHits, sample);
+    }
+
+    const SearchStrategy& getStrategy() const {
+        return *strategy;
+    }
+
+    length_t getMaxED() const {
+        return maxED;
+    }
+};
+
+#endif
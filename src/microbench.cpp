@@ -0,0 +1,498 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#include "fmindex.h"
+#include "perfcounter.h"
+
+#include <chrono>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <string.h>
+
+using namespace std;
+
+// ============================================================================
+// MICRO-BENCHMARKS OF THE INDEX PRIMITIVES
+// ============================================================================
+
+/**
+ * Times the primitives of the index in isolation. Every primitive is called
+ * on arguments that are drawn at random before the timing starts, so that the
+ * access pattern over the data structures is that of a search and not that of
+ * a scan. Each benchmark is run several times and the fastest pass is
+ * reported, together with the number of cache misses in that pass.
+ */
+class MicroBench {
+  private:
+    typedef chrono::steady_clock Clock;
+
+    length_t numOps;         // the number of operations of one pass
+    length_t numPasses;      // the number of passes of each benchmark
+    PerfCounter cacheMisses; // the cache misses of a pass
+    mt19937 rng;             // the generator of the arguments
+    length_t checksum = 0; // keeps the timed calls from being optimized away
+
+    /**
+     * Runs a benchmark and reports its fastest pass
+     * @param name the name of the primitive
+     * @param ops the number of operations of one pass
+     * @param pass one pass of the benchmark, returns a checksum of the results
+     */
+    template <typename F> void run(const string& name, length_t ops, F pass) {
+        double best = numeric_limits<double>::max();
+        uint64_t misses = 0;
+        for (length_t p = 0; p < numPasses; p++) {
+            cacheMisses.start();
+            auto start = Clock::now();
+            checksum += pass();
+            chrono::duration<double, nano> elapsed = Clock::now() - start;
+            cacheMisses.stop();
+            if (elapsed.count() < best) {
+                best = elapsed.count();
+                misses = cacheMisses.read();
+            }
+        }
+
+        cout << left << setw(42) << name << right << fixed << setprecision(2)
+             << setw(12) << best / ops;
+        if (cacheMisses.isAvailable()) {
+            cout << setw(12) << (double)misses / ops << "\n";
+        } else {
+            cout << setw(12) << "n/a"
+                 << "\n";
+        }
+        cout.flush();
+    }
+
+    /**
+     * Draws start positions of substrings of the text that do not contain
+     * the sentinel
+     * @param text the text
+     * @param size the size of the substrings
+     * @param number the number of positions to draw
+     * @param offset the minimal start position
+     * @returns the start positions
+     */
+    vector<length_t> drawPositions(const string& text, length_t size,
+                                   length_t number, length_t offset = 0) {
+        uniform_int_distribution<length_t> dist(offset,
+                                                text.size() - size - 1);
+        vector<length_t> positions(number);
+        for (auto& p : positions) {
+            p = dist(rng);
+        }
+        return positions;
+    }
+
+    /**
+     * Benchmarks the rank queries on the bitvectors of a BWT
+     * @param repr the representation of the BWT
+     * @param size the size of the BWT
+     */
+    void benchRank(const BWTRepr<ALPHABET>& repr, length_t size) {
+        const BitvecIntl<ALPHABET - 1>& bv = repr.getBitvector();
+
+        uniform_int_distribution<length_t> posDist(0, size - 1);
+        uniform_int_distribution<int> charDist(0, ALPHABET - 1);
+        vector<length_t> pos(numOps);
+        vector<int> chars(numOps);
+        for (length_t i = 0; i < numOps; i++) {
+            pos[i] = posDist(rng);
+            chars[i] = charDist(rng);
+        }
+
+        run("BitvecIntl::rank", numOps, [&]() {
+            length_t sum = 0;
+            for (length_t i = 0; i < numOps; i++) {
+                sum += bv.rank(chars[i] % (ALPHABET - 1), pos[i]);
+            }
+            return sum;
+        });
+        run("BWTRepr::occ", numOps, [&]() {
+            length_t sum = 0;
+            for (length_t i = 0; i < numOps; i++) {
+                sum += repr.occ(chars[i], pos[i]);
+            }
+            return sum;
+        });
+        run("BWTRepr::cumOcc", numOps, [&]() {
+            length_t sum = 0;
+            for (length_t i = 0; i < numOps; i++) {
+                sum += repr.cumOcc(chars[i], pos[i]);
+            }
+            return sum;
+        });
+    }
+
+    /**
+     * Benchmarks the rows of the bit-parallel alignment matrix. The pattern
+     * is aligned to the substring of the text it was taken from, so that no
+     * alignment is aborted early.
+     * @param text the text
+     * @param patternSize the size of the patterns
+     * @param maxED the maximal edit distance of the alignments
+     */
+    void benchAlignment(const string& text, length_t patternSize,
+                        length_t maxED) {
+        length_t numAlignments = max<length_t>(1, numOps / patternSize);
+        auto starts = drawPositions(text, patternSize + maxED, numAlignments);
+
+        BitParallelED matrix;
+        length_t numRows = numAlignments * (patternSize + maxED);
+        run("BitParallelED::computeRow", numRows, [&]() {
+            length_t sum = 0;
+            for (length_t b : starts) {
+                matrix.setSequence(Substring(&text, b, b + patternSize));
+                matrix.initializeMatrix(maxED);
+                for (length_t r = 1; r < matrix.getNumberOfRows(); r++) {
+                    sum += matrix.computeRow(r, text[b + r - 1]);
+                }
+            }
+            return sum;
+        });
+    }
+
+    /**
+     * Benchmarks the navigation in the index: the LF mapping, the extension
+     * of a range with a character in both directions and the look-up of a
+     * k-mer in the hash table
+     * @param index the index
+     */
+    void benchNavigation(const FMIndex& index) {
+        const string& text = index.text;
+
+        uniform_int_distribution<length_t> rowDist(0, index.bwt.size() - 1);
+        vector<length_t> rows(numOps);
+        for (auto& r : rows) {
+            r = rowDist(rng);
+        }
+        run("FMIndex::findLF", numOps, [&]() {
+            length_t sum = 0;
+            for (length_t i = 0; i < numOps; i++) {
+                sum += index.findLF(rows[i]);
+            }
+            return sum;
+        });
+
+        // the ranges of substrings of the text at the depths of a search
+        const length_t maxDepth = 12;
+        auto starts = drawPositions(text, maxDepth, numOps);
+        uniform_int_distribution<length_t> depthDist(1, maxDepth);
+        uniform_int_distribution<length_t> charDist(1, ALPHABET - 1);
+        vector<SARangePair> ranges(numOps);
+        vector<length_t> chars(numOps);
+        for (length_t i = 0; i < numOps; i++) {
+            SARangePair r = index.getCompleteRange();
+            length_t depth = depthDist(rng);
+            for (length_t d = 0; d < depth; d++) {
+                int c = index.sigma.c2i((unsigned char)text[starts[i] + d]);
+                index.findRangesWithExtraCharForward(c, r, r);
+            }
+            ranges[i] = r;
+            chars[i] = charDist(rng);
+        }
+
+        run("FMIndex::findRangesWithExtraCharForward", numOps, [&]() {
+            length_t sum = 0;
+            SARangePair child;
+            for (length_t i = 0; i < numOps; i++) {
+                index.findRangesWithExtraCharForward(chars[i], ranges[i],
+                                                     child);
+                sum += child.width();
+            }
+            return sum;
+        });
+        run("FMIndex::findRangesWithExtraCharBackward", numOps, [&]() {
+            length_t sum = 0;
+            SARangePair child;
+            for (length_t i = 0; i < numOps; i++) {
+                index.findRangesWithExtraCharBackward(chars[i], ranges[i],
+                                                      child);
+                sum += child.width();
+            }
+            return sum;
+        });
+
+        length_t wordSize = index.getWordSize();
+        run("FMIndex::lookUpInKmerTable", numOps, [&]() {
+            length_t sum = 0;
+            for (length_t i = 0; i < numOps; i++) {
+                Substring kmer(&text, starts[i], starts[i] + wordSize);
+                sum += index.lookUpInKmerTable(kmer).width();
+            }
+            return sum;
+        });
+    }
+
+    /**
+     * Benchmarks the verification of occurrences in the text. Every pattern
+     * is verified at the position it was taken from, as an occurrence of its
+     * first character found in the index.
+     * @param index the index
+     * @param patternSize the size of the patterns
+     * @param maxED the maximal edit distance of the verification
+     */
+    void benchInText(const FMIndex& index, length_t patternSize,
+                     length_t maxED) {
+        const string& text = index.text;
+        length_t numVerifications = max<length_t>(1, numOps / patternSize);
+        auto starts = drawPositions(text, patternSize + 2 * maxED,
+                                    numVerifications, maxED);
+
+        BitParallelED matrix;
+        CigarArena cigars;
+        Counters counters;
+        vector<TextOcc> tos(1);
+        run("FMIndex::inTextVerification", numVerifications, [&]() {
+            Occurrences occ(cigars, false, 0, false, numVerifications);
+            length_t reported = counters.inTextReported;
+            for (length_t b : starts) {
+                matrix.setSequence(Substring(&text, b, b + patternSize));
+                tos[0] = TextOcc(Range(b, b + 1), 0);
+                index.inTextVerification(tos, maxED, 0, matrix, occ, counters,
+                                         maxED, 0, 0);
+            }
+            return counters.inTextReported - reported;
+        });
+    }
+
+    /**
+     * Benchmarks the look-ups in the suffix array for all sparseness factors
+     * of which the files are present. A look-up takes about sparseness / 2 LF
+     * steps, so the number of look-ups is divided by the sparseness factor to
+     * keep the passes equally long. The sparse suffix array of the index is
+     * replaced.
+     * @param index the index
+     */
+    void benchSuffixArray(FMIndex& index) {
+        uniform_int_distribution<length_t> rowDist(0, index.bwt.size() - 1);
+        vector<length_t> rows(numOps);
+        for (auto& r : rows) {
+            r = rowDist(rng);
+        }
+
+        for (length_t sf = 1; sf <= 256; sf *= 2) {
+            ifstream sa(index.baseFile + ".sa." + to_string(sf));
+            ifstream bv(index.baseFile + ".sa.bv." + to_string(sf));
+            if (!sa || !bv) {
+                continue;
+            }
+            index.sparseSA = SparseSuffixArray(index.baseFile, sf);
+            index.sparseFactorSA = sf;
+            index.logSparseFactorSA = log2(sf);
+
+            length_t numLookUps = max<length_t>(1, numOps / sf);
+            run("FMIndex::findSA (sparseness " + to_string(sf) + ")",
+                numLookUps, [&]() {
+                    length_t sum = 0;
+                    for (length_t i = 0; i < numLookUps; i++) {
+                        sum += index.findSA(rows[i]);
+                    }
+                    return sum;
+                });
+        }
+    }
+
+  public:
+    /**
+     * Constructor
+     * @param numOps the number of operations of one pass
+     * @param numPasses the number of passes of each benchmark
+     */
+    MicroBench(length_t numOps, length_t numPasses)
+        : numOps(numOps), numPasses(numPasses), cacheMisses(CACHE_MISSES),
+          rng(42) {
+        if (!cacheMisses.isAvailable()) {
+            cout << "Hardware counters are not available, cache misses are "
+                    "not reported\n";
+        }
+        cout << left << setw(42) << "primitive" << right << setw(12) << "ns/op"
+             << setw(12) << "misses/op"
+             << "\n";
+    }
+
+    /**
+     * @returns the sum of the results of all benchmarks
+     */
+    length_t getChecksum() const {
+        return checksum;
+    }
+
+    /**
+     * Benchmarks the primitives that do not need an index on a random text
+     * @param text the random text
+     * @param patternSize the size of the aligned patterns
+     * @param maxED the maximal edit distance of the alignments
+     */
+    void benchText(const string& text, length_t patternSize, length_t maxED) {
+        // a random string over the alphabet has the statistics of the BWT of
+        // a random text
+        vector<length_t> charCounts(256, 0);
+        for (char c : text) {
+            charCounts[(unsigned char)c]++;
+        }
+        Alphabet<ALPHABET> sigma(charCounts);
+        BWTRepr<ALPHABET> repr(sigma, text);
+        benchRank(repr, text.size());
+        benchAlignment(text, patternSize, maxED);
+    }
+
+    /**
+     * Benchmarks all primitives on an index
+     * @param index the index, its suffix array is replaced
+     * @param patternSize the size of the aligned patterns
+     * @param maxED the maximal edit distance of the alignments
+     */
+    void benchIndex(FMIndex& index, length_t patternSize, length_t maxED) {
+        benchRank(index.fwdRepr, index.bwt.size());
+        benchAlignment(index.text, patternSize, maxED);
+        benchNavigation(index);
+        benchInText(index, patternSize, maxED);
+        benchSuffixArray(index);
+    }
+};
+
+/**
+ * Generates a random text over A, C, G and T, ending with the sentinel
+ * @param size the size of the text, including the sentinel
+ * @param rng the random generator
+ * @returns the text
+ */
+string randomText(length_t size, mt19937& rng) {
+    static const char bases[] = "ACGT";
+    uniform_int_distribution<int> dist(0, 3);
+    string text(size, '$');
+    for (length_t i = 0; i + 1 < size; i++) {
+        text[i] = bases[dist(rng)];
+    }
+    return text;
+}
+
+void showUsage() {
+    cout << "Usage: ./columba_microbench [options] [basefilename]\n\n";
+    cout << "Without an index, only the bitvectors and the alignment matrix "
+            "are benchmarked on a random text.\n\n";
+    cout << " [options]\n";
+    cout << "  -n  --num-ops\tnumber of operations per pass "
+            "[default = 1000000]\n";
+    cout << "  -p  --passes\tnumber of passes, the fastest is reported "
+            "[default = 3]\n";
+    cout << "  -e  --max-ed\tedit distance of the alignments, in [0, "
+         << FMIndex::MAX_IN_TEXT_ED << "] [default = 4]\n";
+    cout << "  -l  --length\tsize of the aligned patterns [default = 100]\n";
+    cout << "  -g  --generate\tsize of the random text without an index "
+            "[default = 67108864]\n";
+}
+
+int main(int argc, char* argv[]) {
+
+    if (argc == 2 && strcmp("help", argv[1]) == 0) {
+        showUsage();
+        return EXIT_SUCCESS;
+    }
+
+    cout << "Welcome to Columba's micro-benchmarks!\n";
+
+    string numOps = "1000000";
+    string numPasses = "3";
+    string maxED = "4";
+    string patternSize = "100";
+    string textSize = "67108864";
+    string baseFile = "";
+
+    // process optional arguments, an argument that is not an option must be
+    // the last one and is the base file of the index
+    for (int i = 1; i < argc; i++) {
+        const string& arg = argv[i];
+
+        if (arg[0] != '-') {
+            if (i + 1 != argc) {
+                cerr << "Unknown argument: " << arg << " is not an option"
+                     << endl;
+                showUsage();
+                return EXIT_FAILURE;
+            }
+            baseFile = arg;
+            break;
+        }
+        if (i + 1 >= argc) {
+            throw runtime_error(arg + " takes 1 argument as input");
+        }
+        if (arg == "-n" || arg == "--num-ops") {
+            numOps = argv[++i];
+        } else if (arg == "-p" || arg == "--passes") {
+            numPasses = argv[++i];
+        } else if (arg == "-e" || arg == "--max-ed") {
+            maxED = argv[++i];
+        } else if (arg == "-l" || arg == "--length") {
+            patternSize = argv[++i];
+        } else if (arg == "-g" || arg == "--generate") {
+            textSize = argv[++i];
+        } else {
+            cerr << "Unknown argument: " << arg << " is not an option" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    length_t ed = stoi(maxED);
+    if (ed > FMIndex::MAX_IN_TEXT_ED) {
+        cerr << ed << " is not allowed as maxED should be in [0, "
+             << FMIndex::MAX_IN_TEXT_ED << "]" << endl;
+        return EXIT_FAILURE;
+    }
+    length_t ops = stoul(numOps), passes = stoul(numPasses);
+    length_t size = stoul(patternSize);
+    if (ops == 0 || passes == 0 || size == 0) {
+        cerr << "The number of operations, passes and the pattern size "
+                "should be positive"
+             << endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        MicroBench bench(ops, passes);
+        if (baseFile.empty()) {
+            mt19937 rng(7);
+            string text = randomText(stoul(textSize), rng);
+            if (text.size() < 4 * (size + ed)) {
+                throw runtime_error("The random text is too short");
+            }
+            bench.benchText(text, size, ed);
+        } else {
+            // the sparsest suffix array is the fastest to load, it is
+            // replaced for every sparseness factor anyway
+            length_t saSF = FMIndex::findSparsestSA(baseFile);
+            if (saSF == 0) {
+                throw runtime_error("No suffix array found for " + baseFile);
+            }
+            FMIndex index(baseFile, 0, saSF, false);
+            if (index.getText().size() < 4 * (size + 2 * ed)) {
+                throw runtime_error("The text of the index is too short");
+            }
+            bench.benchIndex(index, size, ed);
+        }
+        volatile length_t sink = bench.getChecksum();
+        (void)sink;
+    } catch (const exception& e) {
+        cerr << "Fatal error: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#include "perfcounter.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#endif
+
+using namespace std;
+
+// ============================================================================
+// HARDWARE PERFORMANCE COUNTERS
+// ============================================================================
+
+#ifdef __linux__
+
+/**
+ * Opens a counter for the calling thread on any cpu, that only counts in user
+ * space
+ * @param event the event to count
+ * @param groupFD the leader of the group of the counter, -1 for a new group
+ * @param group true if the counters of the group are read together
+ * @returns the file descriptor, -1 if the counter could not be opened
+ */
+static int openCounter(PerfEvent event, int groupFD, bool group) {
+    static const uint64_t configs[] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[event];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    if (group) {
+        attr.read_format = PERF_FORMAT_GROUP;
+    }
+
+    return syscall(__NR_perf_event_open, &attr, 0, -1, groupFD, 0);
+}
+
+PerfCounter::PerfCounter(PerfEvent event) {
+    fd = openCounter(event, -1, false);
+}
+
+PerfCounter::~PerfCounter() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+void PerfCounter::start() {
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void PerfCounter::stop() {
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+uint64_t PerfCounter::read() const {
+    uint64_t count = 0;
+    if (fd < 0 || ::read(fd, &count, sizeof(count)) != sizeof(count)) {
+        return 0;
+    }
+    return count;
+}
+
+PerfCounterGroup::PerfCounterGroup(const vector<PerfEvent>& events) {
+    for (PerfEvent event : events) {
+        int leader = fds.empty() ? -1 : fds.front();
+        int fd = openCounter(event, leader, true);
+        if (fd < 0) {
+            for (int f : fds) {
+                close(f);
+            }
+            fds.clear();
+            return;
+        }
+        fds.push_back(fd);
+    }
+    if (!fds.empty()) {
+        ioctl(fds.front(), PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds.front(), PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+PerfCounterGroup::~PerfCounterGroup() {
+    for (int fd : fds) {
+        close(fd);
+    }
+}
+
+bool PerfCounterGroup::read(vector<uint64_t>& values) const {
+    if (fds.empty()) {
+        return false;
+    }
+    // the number of counters followed by their values
+    thread_local vector<uint64_t> buffer;
+    buffer.resize(fds.size() + 1);
+    ssize_t size = buffer.size() * sizeof(uint64_t);
+    if (::read(fds.front(), buffer.data(), size) != size) {
+        return false;
+    }
+    values.assign(buffer.begin() + 1, buffer.end());
+    return true;
+}
+
+#else
+
+PerfCounter::PerfCounter(PerfEvent event) : fd(-1) {
+}
+
+PerfCounter::~PerfCounter() {
+}
+
+void PerfCounter::start() {
+}
+
+void PerfCounter::stop() {
+}
+
+uint64_t PerfCounter::read() const {
+    return 0;
+}
+
+PerfCounterGroup::PerfCounterGroup(const vector<PerfEvent>& events) {
+}
+
+PerfCounterGroup::~PerfCounterGroup() {
+}
+
+bool PerfCounterGroup::read(vector<uint64_t>& values) const {
+    return false;
+}
+
+#endif
@@ -0,0 +1,123 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#ifndef PERFCOUNTER_H
+#define PERFCOUNTER_H
+
+#include <cstdint>
+#include <vector>
+
+// ============================================================================
+// HARDWARE PERFORMANCE COUNTERS
+// ============================================================================
+
+/**
+ * The hardware events that can be counted
+ */
+enum PerfEvent { CPU_CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES };
+
+/**
+ * A hardware event counter for the calling thread. The counter is opened with
+ * perf_event_open and only counts in user space. If it cannot be opened (not
+ * on Linux, perf_event_paranoid too strict or no hardware counters in a
+ * virtual machine) it is unavailable and always reads zero.
+ */
+class PerfCounter {
+  private:
+    int fd; // the file descriptor of the counter, -1 if unavailable
+
+  public:
+    /**
+     * Constructor, opens a disabled counter
+     * @param event the event to count
+     */
+    PerfCounter(PerfEvent event);
+
+    /**
+     * Destructor, closes the counter
+     */
+    ~PerfCounter();
+
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+
+    /**
+     * @returns true if the counter could be opened
+     */
+    bool isAvailable() const {
+        return fd >= 0;
+    }
+
+    /**
+     * Resets the counter to zero and starts counting
+     */
+    void start();
+
+    /**
+     * Stops counting, the value is kept until the next start
+     */
+    void stop();
+
+    /**
+     * @returns the number of events counted between start and stop
+     */
+    uint64_t read() const;
+};
+
+/**
+ * A group of hardware event counters for the calling thread, that count from
+ * construction on and are read together with a single system call. The group
+ * is unavailable if any of its counters cannot be opened.
+ */
+class PerfCounterGroup {
+  private:
+    std::vector<int> fds; // the file descriptors, the leader first, empty
+                          // if unavailable
+
+  public:
+    /**
+     * Constructor, opens and starts the counters
+     * @param events the events to count
+     */
+    PerfCounterGroup(const std::vector<PerfEvent>& events);
+
+    /**
+     * Destructor, closes the counters
+     */
+    ~PerfCounterGroup();
+
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+    /**
+     * @returns true if all counters could be opened
+     */
+    bool isAvailable() const {
+        return !fds.empty();
+    }
+
+    /**
+     * Reads the counters
+     * @param values the number of events counted so far, in the order of the
+     * events in the constructor (output)
+     * @returns true if the counters could be read
+     */
+    bool read(std::vector<uint64_t>& values) const;
+};
+
+#endif
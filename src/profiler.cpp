@@ -0,0 +1,229 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#include "profiler.h"
+#include "perfcounter.h"
+
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <set>
+
+using namespace std;
+
+// ============================================================================
+// THREAD PROFILE
+// ============================================================================
+
+/**
+ * The costs of the phases in a single thread. Each thread that enters a phase
+ * gets a profile, which is merged into the finished costs when the thread
+ * exits.
+ */
+class ThreadProfile {
+  public:
+    PhaseCost costs[NUM_PHASES]; // the cost of every phase
+    Phase current;               // the current phase, NUM_PHASES if none
+
+    /**
+     * Constructor, registers the profile and starts counting
+     * @param withCounters true if hardware events should be counted
+     */
+    ThreadProfile(bool withCounters);
+
+    /**
+     * Destructor, merges the profile into the finished costs
+     */
+    ~ThreadProfile();
+
+    /**
+     * Charges the time and events since the last phase switch to the current
+     * phase
+     */
+    void charge();
+
+  private:
+    uint64_t lastNanos;                   // the time of the last switch
+    vector<uint64_t> last;                // the counts at the last switch
+    vector<uint64_t> now;                 // buffer for the current counts
+    unique_ptr<PerfCounterGroup> counters; // the counters, null if disabled
+};
+
+static mutex registryMutex;               // guards the variables below
+static set<ThreadProfile*> liveProfiles;  // the profiles of running threads
+static PhaseCost finished[NUM_PHASES];    // the costs of exited threads
+static bool countersEverywhere = true;    // false if a thread had no counters
+
+/**
+ * @returns the current time in nanoseconds
+ */
+static uint64_t nowNanos() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+               chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+ThreadProfile::ThreadProfile(bool withCounters)
+    : current(NUM_PHASES), lastNanos(nowNanos()) {
+    bool available = true;
+    if (withCounters) {
+        counters.reset(new PerfCounterGroup(
+            {CPU_CYCLES, CACHE_MISSES, BRANCH_MISSES}));
+        available = counters->read(last);
+        if (!available) {
+            counters.reset();
+        }
+    }
+
+    lock_guard<mutex> lock(registryMutex);
+    liveProfiles.insert(this);
+    countersEverywhere = countersEverywhere && available;
+}
+
+ThreadProfile::~ThreadProfile() {
+    lock_guard<mutex> lock(registryMutex);
+    liveProfiles.erase(this);
+    for (int p = 0; p < NUM_PHASES; p++) {
+        finished[p].add(costs[p]);
+    }
+}
+
+void ThreadProfile::charge() {
+    uint64_t t = nowNanos();
+    bool counted = counters && counters->read(now);
+
+    if (current != NUM_PHASES) {
+        PhaseCost& cost = costs[current];
+        cost.nanos += t - lastNanos;
+        if (counted) {
+            cost.cycles += now[0] - last[0];
+            cost.llcMisses += now[1] - last[1];
+            cost.branchMisses += now[2] - last[2];
+        }
+    }
+
+    lastNanos = t;
+    if (counted) {
+        swap(last, now);
+    }
+}
+
+/**
+ * @param withCounters true if hardware events should be counted, only used
+ * when the profile is created
+ * @returns the profile of the calling thread
+ */
+static ThreadProfile& getThreadProfile(bool withCounters) {
+    thread_local ThreadProfile profile(withCounters);
+    return profile;
+}
+
+// ============================================================================
+// PROFILER
+// ============================================================================
+
+bool Profiler::enabled = false;
+bool Profiler::withCounters = false;
+
+Phase Profiler::enter(Phase phase) {
+    ThreadProfile& profile = getThreadProfile(withCounters);
+    profile.charge();
+    Phase previous = profile.current;
+    profile.current = phase;
+    profile.costs[phase].calls++;
+    return previous;
+}
+
+void Profiler::leave(Phase previous) {
+    ThreadProfile& profile = getThreadProfile(withCounters);
+    profile.charge();
+    profile.current = previous;
+}
+
+void Profiler::enable(bool hardwareCounters) {
+    enabled = true;
+    withCounters = hardwareCounters;
+}
+
+bool Profiler::hasCounters() {
+    lock_guard<mutex> lock(registryMutex);
+    return withCounters && countersEverywhere;
+}
+
+vector<PhaseCost> Profiler::getSummary() {
+    lock_guard<mutex> lock(registryMutex);
+    vector<PhaseCost> summary(finished, finished + NUM_PHASES);
+    for (const ThreadProfile* profile : liveProfiles) {
+        for (int p = 0; p < NUM_PHASES; p++) {
+            summary[p].add(profile->costs[p]);
+        }
+    }
+    return summary;
+}
+
+const char* Profiler::getName(Phase phase) {
+    static const char* names[] = {
+        "read parsing", "partition",           "exact seeding",
+        "approximate search", "locate", "in-text verification",
+        "dedup/CIGAR",  "output"};
+    return (phase < NUM_PHASES) ? names[phase] : "none";
+}
+
+void Profiler::printSummary(ostream& os) {
+    vector<PhaseCost> summary = getSummary();
+    PhaseCost total;
+    for (const PhaseCost& cost : summary) {
+        total.add(cost);
+    }
+    bool counted = hasCounters();
+
+    // the times are summed over all threads
+    os << "Phase profile (summed over threads):\n";
+    os << left << setw(22) << "phase" << right << setw(12) << "calls"
+       << setw(12) << "seconds" << setw(8) << "share";
+    if (counted) {
+        os << setw(16) << "cycles" << setw(14) << "LLC misses" << setw(14)
+           << "branch misses";
+    }
+    os << "\n";
+
+    auto printRow = [&](const char* name, const PhaseCost& cost) {
+        double share = (total.nanos == 0) ? 0.0 : 100.0 * cost.nanos /
+                                                     total.nanos;
+        os << left << setw(22) << name << right << setw(12) << cost.calls
+           << setw(12) << fixed << setprecision(3) << cost.nanos * 1e-9
+           << setw(7) << setprecision(1) << share << "%";
+        if (counted) {
+            os << setw(16) << cost.cycles << setw(14) << cost.llcMisses
+               << setw(14) << cost.branchMisses;
+        }
+        os << "\n";
+    };
+
+    for (int p = 0; p < NUM_PHASES; p++) {
+        printRow(getName((Phase)p), summary[p]);
+    }
+    printRow("total", total);
+    if (withCounters && !counted) {
+        os << "Hardware counters unavailable (see "
+              "/proc/sys/kernel/perf_event_paranoid)\n";
+    }
+    os.unsetf(ios_base::floatfield);
+    os << setprecision(6);
+}
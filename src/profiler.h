@@ -0,0 +1,171 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// ============================================================================
+// PHASE PROFILER
+// ============================================================================
+
+/**
+ * The phases of mapping reads
+ */
+enum Phase {
+    READ_PARSING,
+    PARTITION,
+    EXACT_SEEDING,
+    APPROXIMATE_SEARCH,
+    LOCATE,
+    IN_TEXT_VERIFICATION,
+    DEDUP_CIGAR,
+    OUTPUT,
+    NUM_PHASES // not a phase, the number of phases
+};
+
+/**
+ * The cost of a phase, summed over all times it was entered
+ */
+struct PhaseCost {
+    uint64_t calls = 0;        // the number of times the phase was entered
+    uint64_t nanos = 0;        // the time spent in the phase
+    uint64_t cycles = 0;       // the cpu cycles spent in the phase
+    uint64_t llcMisses = 0;    // the last-level cache misses in the phase
+    uint64_t branchMisses = 0; // the mispredicted branches in the phase
+
+    /**
+     * Adds the cost of another phase to this cost
+     * @param o the other cost
+     */
+    void add(const PhaseCost& o) {
+        calls += o.calls;
+        nanos += o.nanos;
+        cycles += o.cycles;
+        llcMisses += o.llcMisses;
+        branchMisses += o.branchMisses;
+    }
+};
+
+/**
+ * Attributes the time, and optionally the hardware events, of every thread
+ * to the phase it is in. A phase is entered with a ScopedPhase. Nested phases
+ * pause the enclosing phase, such that each phase is only charged for its own
+ * work. The profiler is disabled by default, a disabled ScopedPhase costs a
+ * single test of a global flag.
+ */
+class Profiler {
+  private:
+    static bool enabled;      // true if the phases are profiled
+    static bool withCounters; // true if hardware events are counted
+
+    /**
+     * Enters a phase for the calling thread
+     * @param phase the phase to enter
+     * @returns the phase the thread was in, NUM_PHASES if none
+     */
+    static Phase enter(Phase phase);
+
+    /**
+     * Leaves the current phase of the calling thread
+     * @param previous the phase to return to, NUM_PHASES if none
+     */
+    static void leave(Phase previous);
+
+    friend class ScopedPhase;
+
+  public:
+    /**
+     * Enables the profiler, must be called before the phases to profile are
+     * entered and before any worker threads are started
+     * @param hardwareCounters true if the cpu cycles, last-level cache misses
+     * and branch misses should be counted as well, this costs a system call
+     * per phase switch
+     */
+    static void enable(bool hardwareCounters);
+
+    /**
+     * @returns true if the profiler is enabled
+     */
+    static bool isEnabled() {
+        return enabled;
+    }
+
+    /**
+     * @returns true if hardware events were counted in all profiled threads
+     */
+    static bool hasCounters();
+
+    /**
+     * Sums the costs of the phases over all threads. Should be called once
+     * the worker threads have finished.
+     * @returns the cost of every phase, indexed by phase
+     */
+    static std::vector<PhaseCost> getSummary();
+
+    /**
+     * Prints a table with the cost of every phase
+     * @param os the stream to print to
+     */
+    static void printSummary(std::ostream& os);
+
+    /**
+     * @param phase the phase
+     * @returns the name of the phase
+     */
+    static const char* getName(Phase phase);
+};
+
+/**
+ * Attributes the work of the calling thread to a phase for as long as it is
+ * in scope
+ */
+class ScopedPhase {
+  private:
+    bool active;     // true if the profiler was enabled on entry
+    Phase previous;  // the phase to return to
+
+  public:
+    /**
+     * Constructor, enters the phase
+     * @param phase the phase to enter
+     */
+    explicit ScopedPhase(Phase phase)
+        : active(Profiler::isEnabled()), previous(NUM_PHASES) {
+        if (active) {
+            previous = Profiler::enter(phase);
+        }
+    }
+
+    /**
+     * Destructor, returns to the enclosing phase
+     */
+    ~ScopedPhase() {
+        if (active) {
+            Profiler::leave(previous);
+        }
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+};
+
+#endif
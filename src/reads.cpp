@@ -0,0 +1,141 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#include "reads.h"
+#include "nucleotide.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+// ============================================================================
+// READING READS
+// ============================================================================
+
+string getFileExt(const string& s) {
+
+    size_t i = s.rfind('.', s.length());
+    if (i != string::npos) {
+        return (s.substr(i + 1, s.length() - i));
+    }
+
+    return ("");
+}
+
+vector<pair<string, string>> getReads(const string& file) {
+    vector<pair<string, string>> reads;
+    reads.reserve(200000);
+
+    const auto& extension = getFileExt(file);
+
+    bool fasta =
+        (extension == "FASTA") || (extension == "fasta") || (extension == "fa");
+    bool fastq = (extension == "fq") || (extension == "fastq");
+
+    ifstream ifile(file.c_str());
+    if (!ifile) {
+        throw runtime_error("Cannot open file " + file);
+    }
+    if (!fasta && !fastq) {
+        // this is a csv file
+        if (extension != "csv") {
+            throw runtime_error("extension " + extension +
+                                " is not a valid extension for the readsfile");
+        }
+        string line;
+        // get the first line we do not need this
+        getline(ifile, line);
+
+        while (getline(ifile, line)) {
+            istringstream iss{line};
+
+            vector<string> tokens;
+            string token;
+
+            while (getline(iss, token, ',')) {
+                tokens.push_back(token);
+            }
+            string position = tokens[1];
+            string read =
+                tokens[2]; // ED + 2 column contains a read with ED compared
+                           // to the read at position position with length
+            string p = position;
+            reads.push_back(make_pair(p, read));
+        }
+    } else if (fasta) {
+        // fasta file
+        string read = "";
+        string p = "";
+        string line;
+        while (getline(ifile, line)) {
+            if (!line.empty() && line[0] == '>') {
+
+                if (!read.empty()) {
+
+                    reads.push_back(make_pair(p, read));
+                    reads.push_back(
+                        make_pair(p, Nucleotide::getRevCompl(read)));
+                    read.clear();
+                }
+
+                p = (line.substr(1));
+
+            } else {
+                read += line;
+            }
+        }
+        if (!read.empty()) {
+
+            reads.push_back(make_pair(p, read));
+            reads.push_back(make_pair(p, Nucleotide::getRevCompl(read)));
+            read.clear();
+        }
+    } else {
+        // fastQ
+        string read = "";
+        string id = "";
+        string line;
+        bool readLine = false;
+        while (getline(ifile, line)) {
+            if (!line.empty() && line[0] == '@') {
+                if (!read.empty()) {
+
+                    reads.push_back(make_pair(id, read));
+                    reads.push_back(
+                        make_pair(id, Nucleotide::getRevCompl(read)));
+                    read.clear();
+                }
+                id = (line.substr(1));
+                readLine = true;
+            } else if (readLine) {
+                read = line;
+                readLine = false;
+            }
+        }
+        if (!read.empty()) {
+
+            reads.push_back(make_pair(id, read));
+            reads.push_back(make_pair(id, Nucleotide::getRevCompl(read)));
+            read.clear();
+        }
+    }
+
+    return reads;
+}
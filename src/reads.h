@@ -0,0 +1,48 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#ifndef READS_H
+#define READS_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+// READING READS
+// ============================================================================
+
+/**
+ * Get the extension of a file name
+ * @param s the file name
+ * @returns the part of s after the last dot, or an empty string if s has no
+ * extension
+ */
+std::string getFileExt(const std::string& s);
+
+/**
+ * Reads the reads of a FASTA (.fasta, .FASTA, .fa), FASTQ (.fastq, .fq) or
+ * CSV (.csv) file. For FASTA and FASTQ files every read is followed by its
+ * reverse complement, with the same identifier.
+ * @param file the file to read
+ * @returns pairs of the identifier and the sequence of the reads
+ */
+std::vector<std::pair<std::string, std::string>>
+getReads(const std::string& file);
+
+#endif
@@ -0,0 +1,66 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#include "sample.h"
+#include "reads.h"
+
+#include <chrono>
+#include <limits>
+
+using namespace std;
+
+// ============================================================================
+// MEASURING A STRATEGY ON A SAMPLE OF READS
+// ============================================================================
+
+vector<string> getSample(const string& file, length_t numReads) {
+    // the reads are followed by their reverse complements
+    auto reads = getReads(file);
+    vector<string> sample;
+    for (length_t i = 0; i < reads.size() && i < 2 * numReads; i++) {
+        sample.push_back(reads[i].second);
+    }
+    return sample;
+}
+
+Cost measure(const SearchStrategy& strategy, const vector<string>& reads,
+             length_t maxED, length_t numPasses) {
+    Counters counters;
+    CigarArena cigars;
+    Cost cost = {0, numeric_limits<double>::max()};
+
+    for (length_t pass = 0; pass < numPasses; pass++) {
+        length_t nodesBefore = counters.nodeCounter;
+        auto start = chrono::steady_clock::now();
+        for (const string& read : reads) {
+            cigars.clear();
+            strategy.matchApprox(read, maxED, counters, cigars);
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+        // the number of nodes is the same in every pass
+        cost.nodes = counters.nodeCounter - nodesBefore;
+        cost.seconds = min(cost.seconds, elapsed.count());
+    }
+    return cost;
+}
+
+double score(const Cost& cost, const Cost& reference) {
+    return (double)cost.nodes / max<length_t>(reference.nodes, 1) +
+           cost.seconds / max(reference.seconds, 1e-9);
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include "searchstrategy.h"
+
+#include <string>
+#include <vector>
+
+// ============================================================================
+// MEASURING A STRATEGY ON A SAMPLE OF READS
+// ============================================================================
+
+/**
+ * The measured cost of matching a sample of reads
+ */
+struct Cost {
+    length_t nodes; // the number of nodes visited in the index
+    double seconds; // the wall time
+};
+
+/**
+ * Reads the first reads of a file, each followed by its reverse complement
+ * @param file the file with the reads
+ * @param numReads the maximal number of reads, a read and its reverse
+ * complement count as one
+ * @returns the sequences of the sample
+ */
+std::vector<std::string> getSample(const std::string& file, length_t numReads);
+
+/**
+ * Matches a sample of reads and measures the cost. The sample is matched
+ * several times and the fastest pass is kept, as a single pass over a small
+ * sample is short enough to be disturbed by noise.
+ * @param strategy the strategy to match with
+ * @param reads the sample of reads
+ * @param maxED the maximal allowed distance
+ * @param numPasses the number of times the sample is matched
+ * @returns the cost of matching all reads once
+ */
+Cost measure(const SearchStrategy& strategy,
+             const std::vector<std::string>& reads, length_t maxED,
+             length_t numPasses = 3);
+
+/**
+ * Scores a cost relative to a reference cost, the number of nodes and the
+ * wall time weigh equally
+ * @param cost the cost to score
+ * @param reference the reference cost, which has score 2
+ * @returns the score, lower is better
+ */
+double score(const Cost& cost, const Cost& reference);
+
+#endif
@@ -18,8 +18,15 @@
  ******************************************************************************/
 #include "searchstrategy.h"
 
+#include <cerrno>
+
 using namespace std;
 
+atomic<length_t> SearchStrategy::numberOfStrategies(0);
+thread_local vector<PhaseNode> SearchStrategy::searchTree;
+thread_local length_t SearchStrategy::searchTreeOwner = 0;
+thread_local length_t SearchStrategy::searchTreeED = 0;
+
 // ============================================================================
 // CLASS SEARCHSTRATEGY
 // ============================================================================
@@ -28,9 +35,10 @@ using namespace std;
 // CONSTRUCTOR
 // ----------------------------------------------------------------------------
 
-SearchStrategy::SearchStrategy(FMIndex& argument, PartitionStrategy p,
+SearchStrategy::SearchStrategy(const FMIndex& argument, PartitionStrategy p,
                                DistanceMetric distanceMetric)
-    : index(argument), partitionStrategy(p), distanceMetric(distanceMetric) {
+    : index(argument), partitionStrategy(p), distanceMetric(distanceMetric),
+      id(++numberOfStrategies) {
 
     // set the partition strategy
     switch (p) {
@@ -100,24 +108,74 @@ string SearchStrategy::getDistanceMetric() const {
         return "";
     }
 }
+
+void SearchStrategy::writeToFolder(const string& pathToFolder,
+                                   length_t maxED) const {
+    string folder = pathToFolder;
+    if (folder.empty() || folder.back() != '/') {
+        folder += '/';
+    }
+    string scoreFolder = folder + to_string(maxED) + "/";
+    for (const string& dir : {folder, scoreFolder}) {
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw runtime_error("Cannot create directory: " + dir);
+        }
+    }
+
+    ofstream name(folder + "name.txt");
+    name << getName() << "\n";
+
+    ofstream searches(scoreFolder + "searches.txt");
+    for (const Search& s : createSearches(maxED)) {
+        searches << s << "\n";
+    }
+
+    ofstream positions(scoreFolder + "static_partitioning.txt");
+    for (double b : getStaticPositions(maxED)) {
+        positions << b << " ";
+    }
+    positions << "\n";
+
+    ofstream dynamic(scoreFolder + "dynamic_partitioning.txt");
+    for (double seed : getDynamicSeeds(maxED)) {
+        dynamic << seed << " ";
+    }
+    dynamic << "\n";
+    for (int weight : getDynamicWeights(maxED)) {
+        dynamic << weight << " ";
+    }
+    dynamic << "\n";
+
+    if (!name || !searches || !positions || !dynamic) {
+        throw runtime_error("Problem writing the search scheme to " + folder);
+    }
+}
+
 // ----------------------------------------------------------------------------
 // SANITY CHECKS
 // ----------------------------------------------------------------------------
 
 void SearchStrategy::genErrorPatterns(int P, int K, vector<Pattern>& patterns) {
     Pattern pattern(P, 0);
-
-    for (int i = 0; i < pow(K + 1, P); i++) {
-        int sum = accumulate(pattern.begin(), pattern.end(), 0);
-        if (sum <= K)
-            patterns.push_back(pattern);
-
-        for (int j = 0; j < P; j++) {
-            pattern[j]++;
-            if (pattern[j] != K + 1)
+    int sum = 0;
+
+    // count with the first part as least significant digit, but skip all
+    // patterns with more than K errors instead of generating them
+    while (true) {
+        patterns.push_back(pattern);
+
+        int j = 0;
+        for (; j < P; j++) {
+            if (sum < K) {
+                pattern[j]++;
+                sum++;
                 break;
+            }
+            sum -= pattern[j];
             pattern[j] = 0;
         }
+        if (j == P)
+            break;
     }
 }
 
@@ -225,6 +283,8 @@ void SearchStrategy::partition(const string& pattern, vector<Substring>& parts,
                                const int& numParts, const int& maxScore,
                                vector<SARangePair>& exactMatchRanges,
                                Counters& counters) const {
+    ScopedPhase scope(PARTITION);
+    TraceSpan span("partition", "search");
 
     parts.clear();
 
@@ -236,6 +296,17 @@ void SearchStrategy::partition(const string& pattern, vector<Substring>& parts,
     parts.reserve(numParts);
     (this->*partitionPtr)(pattern, parts, numParts, maxScore, exactMatchRanges,
                           counters);
+
+    if (span.isActive()) {
+        // the begins of the parts and the widths of their exact ranges
+        ostringstream begins, widths;
+        for (int i = 0; i < numParts; i++) {
+            begins << ((i == 0) ? "" : " ") << parts[i].begin();
+            widths << ((i == 0) ? "" : " ") << exactMatchRanges[i].width();
+        }
+        span.arg("begins", begins.str());
+        span.arg("widths", widths.str());
+    }
 }
 
 // Uniform Partitioning
@@ -259,6 +330,7 @@ void SearchStrategy::partitionUniform(const string& pattern,
 
     vector<bool> partNumberSeen(numParts, false);
 
+    ScopedPhase scope(EXACT_SEEDING);
     for (int i = 0; i < numParts; i++) {
         exactMatchRanges[i] =
             index.matchStringBidirectionally(parts[i], initialRanges, counters);
@@ -277,6 +349,7 @@ void SearchStrategy::partitionOptimalStatic(
     index.setDirection(FORWARD);
     SARangePair initialRanges = index.getCompleteRange();
 
+    ScopedPhase scope(EXACT_SEEDING);
     for (int i = 0; i < numParts; i++) {
         exactMatchRanges[i] =
             index.matchStringBidirectionally(parts[i], initialRanges, counters);
@@ -304,6 +377,9 @@ void SearchStrategy::partitionDynamic(const string& pattern,
                                       const int& numParts, const int& maxScore,
                                       vector<SARangePair>& exactMatchRanges,
                                       Counters& counters) const {
+    // the parts are found by extending exact matches, so all of the dynamic
+    // partitioning counts as seeding
+    ScopedPhase scope(EXACT_SEEDING);
 
     int matchedChars =
         seed(pattern, parts, numParts, maxScore, exactMatchRanges);
@@ -427,12 +503,85 @@ void SearchStrategy::extendParts(const string& pattern,
 // (APPROXIMATE) MATCHING
 // ----------------------------------------------------------------------------
 vector<TextOcc> SearchStrategy::matchApprox(const string& pattern,
-                                            length_t maxED,
-                                            Counters& counters) const {
+                                            length_t maxED, Counters& counters,
+                                            CigarArena& cigars,
+                                            length_t& hits) const {
+    TraceSpan span("match", "read");
+    span.arg("length", pattern.size());
+    span.arg("maxED", maxED);
+    span.track("nodes", counters.nodeCounter);
+
+    // The occurrences in the text and index
+    Occurrences occ(cigars, generateCigars, maxHits, sampleRepeats);
 
+    vector<TextOcc> result;
     if (maxED == 0) {
-        return index.exactMatchesOutput(pattern, counters);
+        result = index.exactMatchesOutput(pattern, counters, occ);
+        hits = occ.getHits();
+        span.arg("hits", hits);
+        return result;
+    }
+
+    // create the bit-parallel matrix for in-text verification
+    BitParallelED intextMatrix;
+
+    // larger edit distances do not fit in the band of the in-text matrix, so
+    // those occurrences are all found in the index, a caller that disabled
+    // in-text verification is respected
+    bool inText = index.isInTextVerificationEnabled() &&
+                  (distanceMetric == HAMMING ||
+                   maxED <= FMIndex::MAX_IN_TEXT_ED);
+    bool searched;
+    {
+        ScopedInTextVerification guard(index, inText);
+        searched = search(pattern, maxED, occ, intextMatrix, counters);
+    }
+
+    if (!searched) {
+        result = index.approxMatchesNaive(pattern, maxED, counters, occ);
+    } else if (distanceMetric != HAMMING) {
+        // all matches mapped to the text
+        result = occ.getUniqueTextOccurrences(index, maxED, intextMatrix,
+                                              counters);
+    } else {
+        result = occ.getTextOccurrencesHamming(index, pattern.size(), counters);
+    }
+    hits = occ.getHits();
+    span.arg("hits", hits);
+    return result;
+}
+
+vector<length_t> SearchStrategy::countApprox(const string& pattern,
+                                             length_t maxED,
+                                             Counters& counters) const {
+    if (maxED == 0) {
+        ScopedPhase scope(EXACT_SEEDING);
+        return vector<length_t>(1, index.matchString(pattern, counters).width());
+    }
+
+    // no CIGAR strings are calculated, so the arena stays empty
+    CigarArena cigars;
+    Occurrences occ(cigars, false);
+    BitParallelED intextMatrix;
+
+    // keep all occurrences in the index, they are never located
+    bool searched;
+    {
+        ScopedInTextVerification guard(index, false);
+        searched = search(pattern, maxED, occ, intextMatrix, counters);
+    }
+
+    if (!searched) {
+        return index.countApproxNaive(pattern, maxED, counters);
     }
+    return occ.getCounts(maxED);
+}
+
+bool SearchStrategy::search(const string& pattern, length_t maxED,
+                            Occurrences& occ, BitParallelED& intextMatrix,
+                            Counters& counters) const {
+    ScopedPhase scope(APPROXIMATE_SEARCH);
+
     // create the parts of the pattern
     vector<Substring> parts;
 
@@ -450,60 +599,84 @@ vector<TextOcc> SearchStrategy::matchApprox(const string& pattern,
         cerr << "Warning: Normal bidirectional search was used as "
                 "entered pattern is too short "
              << pattern.size() << endl;
-
-        return index.approxMatchesNaive(pattern, maxED, counters);
+        return false;
     }
 
-    // The occurrences in the text and index
-    Occurrences occ;
-
-    // create the bit-parallel matrix for in-text verification
-    BitParallelED intextMatrix;
-    // set sequence to this matrix
-    intextMatrix.setSequence(pattern);
+    // encode the pattern once, the matrices of the parts in both directions
+    // and the in-text matrix are sliced from this encoding
+    index.encodePattern(pattern);
+    intextMatrix.setSequence(Substring(pattern), index.getEncodedPattern());
 
     // END of preprocessing
 
     // A) do in-text verification for the parts that occur less than the index's
-    // switch point
+    // switch point, the searches that start with such a part are skipped in B
+    vector<bool> verifiedInText(numParts, false);
     for (uint i = 0; i < numParts; i++) {
         size_t width = exactMatchRanges[i].width();
-        if (width != 0 && width <= index.getSwitchPoint()) {
+        if (width != 0 &&
+            index.switchToInText(width, parts[i].size(),
+                                 pattern.size() - parts[i].size(), maxED)) {
+            verifiedInText[i] = true;
             // do in-text verification on this part
             const auto& part = parts[i];
             FMOcc startMatch(exactMatchRanges[i], 0, part.size());
-            index.verifyExactPartialMatchInText(
-                intextMatrix, startMatch, part.begin(), maxED, occ, counters);
+            if (distanceMetric == HAMMING) {
+                index.verifyExactPartialMatchInTextHamming(
+                    startMatch, parts, part.begin(), maxED, occ, counters);
+            } else {
+                index.verifyExactPartialMatchInText(intextMatrix, startMatch,
+                                                    part.begin(), maxED, occ,
+                                                    counters);
+            }
         }
     }
 
     // B) do the searches for which the first part occurs more than the switch
     // point
 
-    // create the searches
-    const vector<Search>& searches = createSearches(maxED);
+    // get the searches, phases with a common prefix are shared
+    const vector<PhaseNode>& roots = getSearchTree(maxED);
     index.reserveStacks(numParts,
                         pattern.length()); // reserve stacks for each part
 
     // create the bit-parallel alignment matrices
     index.resetMatrices(parts.size()); // reset the alignment matrix that will
                                        // be (possibly) used for each part
+    index.reserveScratch(numParts);    // scratch space for each part
 
-    for (const Search& s : searches) {
-        doRecSearch(intextMatrix, s, parts, occ, exactMatchRanges, counters);
+    for (const PhaseNode& root : roots) {
+        doRecSearch(intextMatrix, root, parts, occ, exactMatchRanges,
+                    verifiedInText, counters);
     }
+    return true;
+}
 
-    // return all matches mapped to the text
-    return (distanceMetric != HAMMING)
-               ? occ.getUniqueTextOccurrences(index, maxED, intextMatrix,
-                                              counters)
-               : occ.getTextOccurrencesHamming(index, pattern.size(), counters);
+const vector<PhaseNode>& SearchStrategy::getSearchTree(length_t maxED) const {
+    if (searchTreeOwner != id || searchTreeED != maxED) {
+        PhaseNode::createTree(createSearches(maxED), searchTree);
+        searchTreeOwner = id;
+        searchTreeED = maxED;
+    }
+    return searchTree;
 }
 
-void SearchStrategy::doRecSearch(BitParallelED& intextMatrix, const Search& s,
+void SearchStrategy::doRecSearch(BitParallelED& intextMatrix,
+                                 const PhaseNode& root,
                                  vector<Substring>& parts, Occurrences& occ,
                                  const vector<SARangePair>& exactMatchRanges,
+                                 const vector<bool>& verifiedInText,
                                  Counters& counters) const {
+    const Search& s = root.getSearch();
+
+    TraceSpan span("search", "search");
+    if (span.isActive()) {
+        // the searches through the root only share its first phase
+        ostringstream search;
+        search << s;
+        span.arg("search", search.str());
+        span.track("nodes", counters.nodeCounter);
+    }
 
     if (s.getUpperBound(0) > 0) {
         // first part is allowed an error so start with an empty match
@@ -511,45 +684,65 @@ void SearchStrategy::doRecSearch(BitParallelED& intextMatrix, const Search& s,
 
         SARangePair startRange = index.getCompleteRange();
         FMOcc startMatch = FMOcc(startRange, 0, 0);
-        (this->*startIdxPtr)(intextMatrix, s, startMatch, occ, parts, counters,
-                             0);
+        (this->*startIdxPtr)(intextMatrix, root, startMatch, occ, parts,
+                             counters, 0);
         return;
     }
 
     // first get the bidirectional match of first part
     int first = s.getPart(0);
     SARangePair startRange = exactMatchRanges[first];
+    if (startRange.empty()) {
+        // the first part does not occur
+        return;
+    }
+
+    // the occurrences of a part that was verified in the text are all found
+    if (!verifiedInText[first]) {
+        extendExactMatch(intextMatrix, root, startRange, parts[first].size(),
+                         parts, occ, counters);
+    }
+}
 
-    // if this range is bigger than the switch point
-    if (startRange.width() > index.getSwitchPoint()) {
+void SearchStrategy::extendExactMatch(BitParallelED& intextMatrix,
+                                      const PhaseNode& phase,
+                                      const SARangePair& startRange,
+                                      length_t exactLength,
+                                      vector<Substring>& parts,
+                                      Occurrences& occ,
+                                      Counters& counters) const {
+    length_t idx = phase.getPhase() + 1;
 
+    for (const PhaseNode& child : phase.getChildren()) {
+        const Search& s = child.getSearch();
         // prepare the parts for this search
         s.setDirectionsInParts(parts);
 
-        // can we continue exact matching according to this search?
-        uint partInSearch = 1;
-        length_t exactLength = parts[first].size();
-
-        while (s.getUpperBound(partInSearch) == 0) {
-            // extend the exact match
-            index.setDirection(s.getDirection(partInSearch - 1));
-            const auto& part = parts[s.getPart(partInSearch)];
+        if (s.getUpperBound(idx) > 0) {
+            // Create a match corresponding to the exact match
+            FMOcc startMatch = FMOcc(startRange, 0, exactLength);
+            // Start approximate matching in the index
+            (this->*startIdxPtr)(intextMatrix, child, startMatch, occ, parts,
+                                 counters, idx);
+            continue;
+        }
 
-            startRange =
+        // extend the exact match
+        index.setDirection(s.getDirection(idx - 1));
+        const auto& part = parts[s.getPart(idx)];
+        SARangePair nextRange;
+        {
+            TraceSpan span("exact part", "search");
+            span.arg("part", s.getPart(idx));
+            span.arg("phase", idx);
+            nextRange =
                 index.matchStringBidirectionally(part, startRange, counters);
-            if (startRange.empty()) {
-                return;
-            }
-
-            exactLength += parts[s.getPart(partInSearch)].size();
-            partInSearch++;
+            span.arg("width", nextRange.width());
+        }
+        if (!nextRange.empty()) {
+            extendExactMatch(intextMatrix, child, nextRange,
+                             exactLength + part.size(), parts, occ, counters);
         }
-
-        // Create a match corresponding to the exact match
-        FMOcc startMatch = FMOcc(startRange, 0, exactLength);
-        // Start approximate matching in the index
-        (this->*startIdxPtr)(intextMatrix, s, startMatch, occ, parts, counters,
-                             partInSearch);
     }
 }
 // ============================================================================
@@ -560,6 +753,8 @@ void SearchStrategy::doRecSearch(BitParallelED& intextMatrix, const Search& s,
 // CONSTRUCTION
 // ----------------------------------------------------------------------------
 
+constexpr length_t CustomSearchStrategy::MAX_SCORE;
+
 void CustomSearchStrategy::getSearchSchemeFromFolder(string pathToFolder,
                                                      bool verbose) {
 
@@ -577,9 +772,9 @@ void CustomSearchStrategy::getSearchSchemeFromFolder(string pathToFolder,
         ifs.close();
     }
 
-    // get the info per distance score (scores between 1 and 4 are looked
-    // at)
-    for (int i = 1; i <= 4; i++) {
+    // get the info per distance score (scores between 1 and MAX_SCORE are
+    // looked at)
+    for (length_t i = 1; i <= MAX_SCORE; i++) {
 
         ifstream stream_searches(pathToFolder + to_string(i) + "/searches.txt");
         if (!stream_searches) {
@@ -609,7 +804,7 @@ void CustomSearchStrategy::getSearchSchemeFromFolder(string pathToFolder,
     sanityCheck(verbose);
 
     // get static positions (if they exist)
-    for (int i = 1; i <= 4; i++) {
+    for (length_t i = 1; i <= MAX_SCORE; i++) {
         ifstream stream_static(pathToFolder + to_string(i) +
                                "/static_partitioning.txt");
 
@@ -645,7 +840,7 @@ void CustomSearchStrategy::getSearchSchemeFromFolder(string pathToFolder,
     }
 
     // get dynamic seeds and weights (if file exists)
-    for (int i = 1; i <= 4; i++) {
+    for (length_t i = 1; i <= MAX_SCORE; i++) {
         ifstream stream_dynamic(pathToFolder + to_string(i) +
                                 "/dynamic_partitioning.txt");
 
@@ -696,6 +891,57 @@ void CustomSearchStrategy::getSearchSchemeFromFolder(string pathToFolder,
     }
 }
 
+CustomSearchStrategy::CustomSearchStrategy(const FMIndex& index,
+                                           const string& name, length_t maxED,
+                                           const vector<Search>& searches,
+                                           PartitionStrategy p,
+                                           DistanceMetric metric)
+    : SearchStrategy(index, p, metric) {
+    if (maxED < 1 || maxED > MAX_SCORE) {
+        throw runtime_error("Custom search schemes support distance scores "
+                            "1 to " +
+                            to_string(MAX_SCORE));
+    }
+    this->name = name;
+    schemePerED[maxED - 1] = searches;
+    supportsMaxScore[maxED - 1] = !searches.empty();
+
+    // check if the searches are valid
+    sanityCheck(false);
+}
+
+void CustomSearchStrategy::setStaticPositions(const int& maxScore,
+                                              const vector<double>& positions) {
+    if (positions.size() != calculateNumParts(maxScore) - 1) {
+        throw runtime_error("Expected " +
+                            to_string(calculateNumParts(maxScore) - 1) +
+                            " static positions for max score " +
+                            to_string(maxScore));
+    }
+    staticPositions[maxScore - 1] = positions;
+    sanityCheckStaticPartitioning(maxScore);
+    beginsPointer[maxScore - 1] = &CustomSearchStrategy::getBeginsCustom;
+}
+
+void CustomSearchStrategy::setDynamicPartitioning(
+    const int& maxScore, const vector<double>& seeds,
+    const vector<int>& partWeights) {
+    if (seeds.size() != calculateNumParts(maxScore) - 2 ||
+        partWeights.size() != calculateNumParts(maxScore)) {
+        throw runtime_error("Expected " +
+                            to_string(calculateNumParts(maxScore) - 2) +
+                            " seeds and " +
+                            to_string(calculateNumParts(maxScore)) +
+                            " weights for max score " + to_string(maxScore));
+    }
+    seedingPositions[maxScore - 1] = seeds;
+    sanityCheckDynamicPartitioning(maxScore);
+    weights[maxScore - 1] = partWeights;
+    seedingPointer[maxScore - 1] =
+        &CustomSearchStrategy::getSeedingPositionsCustom;
+    weightsPointers[maxScore - 1] = &CustomSearchStrategy::getWeightsCustom;
+}
+
 Search CustomSearchStrategy::makeSearch(const string& line) const {
     stringstream ss(line);
 
@@ -784,7 +1030,7 @@ void CustomSearchStrategy::sanityCheck(bool verbose) const {
 
     // check if for each supported edit distance all error patterns  are
     // covered
-    for (int K = 1; K <= 4; K++) {
+    for (length_t K = 1; K <= MAX_SCORE; K++) {
 
         const auto& scheme = schemePerED[K - 1];
         if (!supportsMaxScore[K - 1]) {
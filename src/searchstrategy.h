@@ -19,6 +19,7 @@
 #ifndef SEARCHSTRATEGY_H
 #define SEARCHSTRATEGY_H
 
+#include <atomic>
 #include <sys/stat.h>
 
 #include "fmindex.h"
@@ -49,14 +50,14 @@ typedef void (SearchStrategy::*PartitionPtr)(const std::string&,
 
 // Pointer to function that starts the index on a particular search
 typedef void (SearchStrategy::*StartIdxPtr)(BitParallelED& intextMatrix,
-                                            const Search&, const FMOcc&,
+                                            const PhaseNode&, const FMOcc&,
                                             Occurrences&,
                                             std::vector<Substring>&, Counters&,
                                             const int&) const;
 
 class SearchStrategy {
   protected:
-    FMIndex& index; // pointer to the index of the text that is searched
+    const FMIndex& index; // pointer to the index of the text that is searched
 
     // variables for getting info about strategy used
     PartitionStrategy partitionStrategy; // the partitioning strategy
@@ -70,6 +71,22 @@ class SearchStrategy {
 
     length_t maxSize = 200;
 
+    bool generateCigars = true; // calculate CIGAR strings of the occurrences
+    length_t maxHits = 0;       // the maximal number of located occurrences
+                                // per pattern, 0 if there is no maximum
+    bool sampleRepeats = false; // report a sample of the occurrences of
+                                // repetitive patterns instead of none
+
+    length_t id; // unique identifier of this strategy
+
+    static std::atomic<length_t> numberOfStrategies; // to create identifiers
+
+    // the prefix tree of the searches the current thread last used, with the
+    // identifier of the strategy and the maximal distance it was built for
+    thread_local static std::vector<PhaseNode> searchTree;
+    thread_local static length_t searchTreeOwner;
+    thread_local static length_t searchTreeED;
+
     // ----------------------------------------------------------------------------
     // CONSTRUCTOR
     // ----------------------------------------------------------------------------
@@ -81,33 +98,9 @@ class SearchStrategy {
      * @param edit, true if edit distance should be used, false if hamming
      * distance should be used
      */
-    SearchStrategy(FMIndex& argument, PartitionStrategy p,
+    SearchStrategy(const FMIndex& argument, PartitionStrategy p,
                    DistanceMetric distanceMetric);
 
-    // ----------------------------------------------------------------------------
-    // SANITY CHECKS
-    // ----------------------------------------------------------------------------
-
-    /**
-     * Static function which generates all error patterns with P parts and K
-     * errors.
-     * @param P the number of parts
-     * @param K the number of allowed errors
-     * @param patterns vector to store the error patterns in
-     */
-    static void genErrorPatterns(int P, int K, std::vector<Pattern>& patterns);
-
-    /**
-     * Static function to check if a particular search scheme covers all
-     * patterns.
-     * @param patterns the error patterns to check
-     * @param scheme the search scheme to check
-     * @param verbose if true the details about which search covers which
-     * pattern will be written to stdout
-     */
-    static bool coversPatterns(const std::vector<Pattern>& patterns,
-                               const std::vector<Search>& scheme, bool verbose);
-
     // ----------------------------------------------------------------------------
     // PARTITIONING
     // ----------------------------------------------------------------------------
@@ -293,67 +286,117 @@ class SearchStrategy {
     createSearches(unsigned int maxED) const = 0;
 
     /**
-     * Executes the search recursively. If U[0] != 1, then the search will
-     * start at pi[0], else the search will start with idx i and U[i]!=0 and
-     * U[j]=0 with j < i
-     * @param s, the search to follow
+     * Partitions the pattern and executes all searches of this strategy,
+     * including the in-text verification of parts that occur less than the
+     * switch point
+     * @param pattern, the pattern to match
+     * @param maxED, the maximal allowed edit distance (or hamming distance)
+     * @param occ, the occurrences, found occurrences are added to this
+     * @param intextMatrix, the matrix for in-text verification, its sequence
+     * is set to the pattern
+     * @param counters, the performance counters
+     * @returns false if the pattern is too short to be partitioned, in which
+     * case no search was done
+     */
+    bool search(const std::string& pattern, length_t maxED, Occurrences& occ,
+                BitParallelED& intextMatrix, Counters& counters) const;
+
+    /**
+     * Gets the prefix tree of the searches for a maximal distance. The tree
+     * is built once per thread and reused as long as the thread searches
+     * with this strategy and maximal distance.
+     * @param maxED, the maximal allowed distance
+     * @returns the nodes of the first phases of the searches
+     */
+    const std::vector<PhaseNode>& getSearchTree(length_t maxED) const;
+
+    /**
+     * Executes the searches that share a first phase recursively. If U[0] !=
+     * 0, then the searches will start at pi[0], else the searches will start
+     * with idx i and U[i]!=0 and U[j]=0 with j < i
+     * @param root, the node of the first phase in the prefix tree of the
+     * searches
      * @param parts, the parts of the pattern
      * @param allMatches, vector to add occurrences to
      * @param exactMatchRanges, a vector corresponding to the ranges for the
      * exact matches of the parts
+     * @param verifiedInText, per part true if its exact match was already
+     * verified in the text, the searches starting with it are then skipped
      */
-    void doRecSearch(BitParallelED& intextMatrix, const Search& s,
+    void doRecSearch(BitParallelED& intextMatrix, const PhaseNode& root,
                      std::vector<Substring>& parts, Occurrences& occ,
                      const std::vector<SARangePair>& exactMatchRanges,
+                     const std::vector<bool>& verifiedInText,
                      Counters& counters) const;
 
+    /**
+     * Continues the exact matching of the searches in a subtree of the prefix
+     * tree. The next phases that allow errors start the approximate matching,
+     * the others are matched exactly.
+     * @param phase, the last phase that was matched exactly
+     * @param startRange, the ranges of the exact match up to this phase
+     * @param exactLength, the length of the exact match up to this phase
+     * @param parts, the parts of the pattern
+     * @param occ, vector to add occurrences to
+     * @param counters, the performance counters
+     */
+    void extendExactMatch(BitParallelED& intextMatrix, const PhaseNode& phase,
+                          const SARangePair& startRange, length_t exactLength,
+                          std::vector<Substring>& parts, Occurrences& occ,
+                          Counters& counters) const;
+
     /**
      * Starts the index with hamming distance
-     * @param s, the search to follow
+     * @param phase, the node of the phase to start with in the prefix tree
+     * of the searches
      * @param startMatch, the startMatch that corresponds to the first piece
      * @param occ, vector to add occurrences to
      * @param parts, the parts of the pattern
      * @param idx, the index in the search to match next
      */
-    void startIndexHamming(BitParallelED& intextMatrix, const Search& s,
+    void startIndexHamming(BitParallelED& intextMatrix, const PhaseNode& phase,
                            const FMOcc& startMatch, Occurrences& occ,
                            std::vector<Substring>& parts, Counters& counters,
                            const int& idx) const {
-        index.recApproxMatchHamming(s, startMatch, occ, parts, counters, idx);
+        index.recApproxMatchHamming(phase, startMatch, occ, parts, counters,
+                                    idx);
     }
 
     /**
      * Starts the index with edit distance and optimized alignment for the
      * edit distance metric
-     * @param s, the search to follow
+     * @param phase, the node of the phase to start with in the prefix tree
+     * of the searches
      * @param startMatch, the startMatch that corresponds to the first piece
      * @param occ, vector to add occurrences to
      * @param parts, the parts of the pattern
      * @param idx, the index in the search to match next
      */
-    void startIndexEditOptimized(BitParallelED& intextMatrix, const Search& s,
+    void startIndexEditOptimized(BitParallelED& intextMatrix,
+                                 const PhaseNode& phase,
                                  const FMOcc& startMatch, Occurrences& occ,
                                  std::vector<Substring>& parts,
                                  Counters& counters, const int& idx) const {
-        index.recApproxMatchEditOptimizedEntry(intextMatrix, s, startMatch, occ,
-                                               parts, counters, idx);
+        index.recApproxMatchEditOptimizedEntry(intextMatrix, phase, startMatch,
+                                               occ, parts, counters, idx);
     }
 
     /**
      * Starts the index with naive edit distance (= redundancy between parts
      * of a search)
-     * @param s, the search to follow
+     * @param phase, the node of the phase to start with in the prefix tree
+     * of the searches
      * @param startMatch, the startMatch that corresponds to the first piece
      * @param occ, vector to add occurrences to
      * @param parts, the parts of the pattern
      * @param idx, the index in the search to match next
      */
-    void startIndexEditNaive(BitParallelED& intextMatrix, const Search& s,
-                             const FMOcc& startMatch, Occurrences& occ,
-                             std::vector<Substring>& parts, Counters& counters,
-                             const int& idx) const {
-        index.recApproxMatchEditNaive(s, startMatch, occ, parts, intextMatrix,
-                                      counters, idx);
+    void startIndexEditNaive(BitParallelED& intextMatrix,
+                             const PhaseNode& phase, const FMOcc& startMatch,
+                             Occurrences& occ, std::vector<Substring>& parts,
+                             Counters& counters, const int& idx) const {
+        index.recApproxMatchEditNaive(phase, startMatch, occ, parts,
+                                      intextMatrix, counters, idx);
     }
 
   public:
@@ -362,6 +405,30 @@ class SearchStrategy {
     // ----------------------------------------------------------------------------
     virtual ~SearchStrategy() {
     }
+    // ----------------------------------------------------------------------------
+    // SANITY CHECKS
+    // ----------------------------------------------------------------------------
+
+    /**
+     * Static function which generates all error patterns with P parts and K
+     * errors.
+     * @param P the number of parts
+     * @param K the number of allowed errors
+     * @param patterns vector to store the error patterns in
+     */
+    static void genErrorPatterns(int P, int K, std::vector<Pattern>& patterns);
+
+    /**
+     * Static function to check if a particular search scheme covers all
+     * patterns.
+     * @param patterns the error patterns to check
+     * @param scheme the search scheme to check
+     * @param verbose if true the details about which search covers which
+     * pattern will be written to stdout
+     */
+    static bool coversPatterns(const std::vector<Pattern>& patterns,
+                               const std::vector<Search>& scheme, bool verbose);
+
     // ----------------------------------------------------------------------------
     // INFORMATION
     // ----------------------------------------------------------------------------
@@ -394,15 +461,148 @@ class SearchStrategy {
         return index.getSwitchPoint();
     }
 
+    /**
+     * Get the searches of this strategy for a maximal distance
+     * @param maxED the maximal allowed distance
+     */
+    const std::vector<Search>& getSearches(length_t maxED) const {
+        return createSearches(maxED);
+    }
+
+    /**
+     * Get the number of parts a pattern is split into for a maximal distance
+     * @param maxED the maximal allowed distance
+     */
+    length_t getNumParts(length_t maxED) const {
+        return calculateNumParts(maxED);
+    }
+
+    /**
+     * Get the begin positions of the parts 1 to n - 1 for static
+     * partitioning, relative to the size of the pattern
+     * @param maxED the maximal allowed distance
+     */
+    std::vector<double> getStaticPositions(length_t maxED) const {
+        return getBegins(calculateNumParts(maxED), maxED);
+    }
+
+    /**
+     * Get the seeding positions of the middle parts for dynamic
+     * partitioning, relative to the size of the pattern
+     * @param maxED the maximal allowed distance
+     */
+    std::vector<double> getDynamicSeeds(length_t maxED) const {
+        return getSeedingPositions(calculateNumParts(maxED), maxED);
+    }
+
+    /**
+     * Get the weights of the parts for dynamic partitioning
+     * @param maxED the maximal allowed distance
+     */
+    std::vector<int> getDynamicWeights(length_t maxED) const {
+        return getWeights(calculateNumParts(maxED), maxED);
+    }
+
+    /**
+     * Writes the searches and partitioning parameters of this strategy for
+     * a maximal distance as a custom search scheme folder, see
+     * CustomSearchStrategy. The folder and its subfolder for maxED are
+     * created if they do not exist, an existing name.txt is overwritten.
+     * @param pathToFolder the folder to write to
+     * @param maxED the maximal allowed distance
+     */
+    void writeToFolder(const std::string& pathToFolder, length_t maxED) const;
+
+    /**
+     * Sets whether the CIGAR strings of the reported occurrences should be
+     * calculated. If not, only positions and distances are reported.
+     * @param generate true if CIGAR strings should be calculated
+     */
+    void setGenerateCigars(bool generate) {
+        generateCigars = generate;
+    }
+
+    bool getGenerateCigars() const {
+        return generateCigars;
+    }
+
+    /**
+     * Sets the maximal number of occurrences that are located per pattern. A
+     * pattern with more hits, counted as in count mode, is repetitive: the
+     * search stops before locating and no occurrences are reported. With a
+     * sample, at most maxHits SA rows are located, so the sample may hold
+     * near-duplicates that the redundancy filter would remove otherwise.
+     * @param maxHits the maximal number of occurrences, 0 if there is no
+     * maximum
+     * @param sample true if a sample should be reported for repetitive
+     * patterns
+     */
+    void setMaxHits(length_t maxHits, bool sample = false) {
+        this->maxHits = maxHits;
+        sampleRepeats = sample;
+    }
+
+    length_t getMaxHits() const {
+        return maxHits;
+    }
+
+    /**
+     * @param hits the number of hits of a pattern, as returned by
+     * matchApprox
+     * @returns true if a pattern with this number of hits is repetitive
+     */
+    bool isRepetitive(length_t hits) const {
+        return maxHits != 0 && hits > maxHits;
+    }
+
     /**
      * Matches a pattern approximately using this strategy
      * @param pattern, the pattern to match
      * @param maxED, the maximal allowed edit distance (or  hamming
      * distance)
+     * @param counters, the performance counters
+     * @param cigars, the arena in which the CIGAR strings of the returned
+     * occurrences are stored
+     * @param hits, the number of occurrences as counted in count mode, 0 if
+     * there is no maximal number of hits. If it exceeds the maximal number of
+     * hits, the pattern is repetitive and at most a sample is returned.
      */
     virtual std::vector<TextOcc> matchApprox(const std::string& pattern,
-                                             length_t maxED,
-                                             Counters& counters) const;
+                                             length_t maxED, Counters& counters,
+                                             CigarArena& cigars,
+                                             length_t& hits) const;
+
+    /**
+     * Matches a pattern approximately using this strategy
+     * @param pattern, the pattern to match
+     * @param maxED, the maximal allowed edit distance (or  hamming
+     * distance)
+     * @param counters, the performance counters
+     * @param cigars, the arena in which the CIGAR strings of the returned
+     * occurrences are stored
+     */
+    std::vector<TextOcc> matchApprox(const std::string& pattern,
+                                     length_t maxED, Counters& counters,
+                                     CigarArena& cigars) const {
+        length_t hits;
+        return matchApprox(pattern, maxED, counters, cigars, hits);
+    }
+
+    /**
+     * Counts the approximate occurrences of a pattern per distance, without
+     * locating them in the text. Occurrences are only deduplicated in the
+     * index, so an occurrence that is found with a different length or shift
+     * can be counted more than once.
+     * @param pattern, the pattern to match
+     * @param maxED, the maximal allowed edit distance (or  hamming
+     * distance)
+     * @param counters, the performance counters
+     * @returns a vector with at index d the number of occurrences at
+     * distance d
+     */
+    virtual std::vector<length_t> countApprox(const std::string& pattern,
+                                              length_t maxED,
+                                              Counters& counters) const;
 };
 
 // ============================================================================
@@ -450,45 +650,46 @@ typedef const std::vector<int> (CustomSearchStrategy::*GetWeightsPtr)(
     const int& numParts, const int& maxScore) const;
 
 class CustomSearchStrategy : public SearchStrategy {
+  public:
+    // the highest distance score a custom scheme can support, limited by the
+    // bit-parallel matrices of the search
+    static constexpr length_t MAX_SCORE = BitParallelED::MAX_ED;
+
   private:
-    std::vector<std::vector<Search>> schemePerED = {
-        {}, {}, {}, {}}; // the search schemes for each distance score, for
-                         // now only scores 1 to 4 are supported
-    std::vector<bool> supportsMaxScore = {
-        false, false, false,
-        false}; // if a particular distance score is supported
+    std::vector<std::vector<Search>> schemePerED =
+        std::vector<std::vector<Search>>(
+            MAX_SCORE); // the search schemes for each distance score
+    std::vector<bool> supportsMaxScore = std::vector<bool>(
+        MAX_SCORE, false); // if a particular distance score is supported
 
     // static partitioning
-    std::vector<std::vector<double>> staticPositions = {
-        {}, {}, {}, {}}; // the static positions per score
-    std::vector<GetBeginsPtr> beginsPointer = {
-        &CustomSearchStrategy::getBeginsDefault,
-        &CustomSearchStrategy::getBeginsDefault,
-        &CustomSearchStrategy::getBeginsDefault,
-        &CustomSearchStrategy::getBeginsDefault}; // pointer to the correct
-    // getBegins() function,
-    // either default or custom
+    std::vector<std::vector<double>> staticPositions =
+        std::vector<std::vector<double>>(
+            MAX_SCORE); // the static positions per score
+    std::vector<GetBeginsPtr> beginsPointer = std::vector<GetBeginsPtr>(
+        MAX_SCORE,
+        &CustomSearchStrategy::getBeginsDefault); // pointer to the correct
+                                                  // getBegins() function,
+                                                  // either default or custom
 
     // dynamic partitioning
-    std::vector<std::vector<double>> seedingPositions = {
-        {}, {}, {}, {}}; // the seeds for dynamic partitioning per score
-    std::vector<std::vector<int>> weights = {
-        {}, {}, {}, {}}; // the weights for dynamic partitioning per score
-
-    std::vector<GetSeedingPostitionsPtr> seedingPointer = {
-        &CustomSearchStrategy::getSeedingPositionsDefault,
-        &CustomSearchStrategy::getSeedingPositionsDefault,
-        &CustomSearchStrategy::getSeedingPositionsDefault,
-        &CustomSearchStrategy::
-            getSeedingPositionsDefault}; // pointer to the correct
-                                         // getSeedingPositions() function,
-                                         // either default or custom
-
-    std::vector<GetWeightsPtr> weightsPointers = {
-        &CustomSearchStrategy::getWeightsDefault,
-        &CustomSearchStrategy::getWeightsDefault,
-        &CustomSearchStrategy::getWeightsDefault,
-        &CustomSearchStrategy::getWeightsDefault}; // pointer to the correct
+    std::vector<std::vector<double>> seedingPositions =
+        std::vector<std::vector<double>>(
+            MAX_SCORE); // the seeds for dynamic partitioning per score
+    std::vector<std::vector<int>> weights = std::vector<std::vector<int>>(
+        MAX_SCORE); // the weights for dynamic partitioning per score
+
+    std::vector<GetSeedingPostitionsPtr> seedingPointer =
+        std::vector<GetSeedingPostitionsPtr>(
+            MAX_SCORE,
+            &CustomSearchStrategy::
+                getSeedingPositionsDefault); // pointer to the correct
+                                             // getSeedingPositions() function,
+                                             // either default or custom
+
+    std::vector<GetWeightsPtr> weightsPointers = std::vector<GetWeightsPtr>(
+        MAX_SCORE,
+        &CustomSearchStrategy::getWeightsDefault); // pointer to the correct
                                                    // getWeigths() function,
                                                    // either default or
                                                    // custom
@@ -640,7 +841,7 @@ class CustomSearchStrategy : public SearchStrategy {
     }
 
   public:
-    CustomSearchStrategy(FMIndex& index, std::string pathToFolder,
+    CustomSearchStrategy(const FMIndex& index, std::string pathToFolder,
                          PartitionStrategy p = DYNAMIC,
                          DistanceMetric metric = EDITOPTIMIZED,
                          bool verbose = false)
@@ -648,6 +849,44 @@ class CustomSearchStrategy : public SearchStrategy {
         getSearchSchemeFromFolder(pathToFolder, verbose);
     }
 
+    /**
+     * Creates a custom scheme with the searches of a single maximal distance.
+     * The partitioning parameters are the defaults until they are set.
+     * @param index the index to search in
+     * @param name the name of the scheme
+     * @param maxED the maximal distance of the searches, in [1, MAX_SCORE]
+     * @param searches the searches, they must cover all error patterns
+     * @param p the partitioning strategy
+     * @param metric the distance metric
+     */
+    CustomSearchStrategy(const FMIndex& index, const std::string& name,
+                         length_t maxED, const std::vector<Search>& searches,
+                         PartitionStrategy p = DYNAMIC,
+                         DistanceMetric metric = EDITOPTIMIZED);
+
+    /**
+     * Sets the begin positions of static partitioning for a distance score
+     * that is supported. Will throw a runtime error if they are not valid.
+     * @param maxScore the distance score
+     * @param positions the begin positions of the parts 1 to n - 1, relative
+     * to the size of the pattern
+     */
+    void setStaticPositions(const int& maxScore,
+                            const std::vector<double>& positions);
+
+    /**
+     * Sets the seeds and weights of dynamic partitioning for a distance
+     * score that is supported. Will throw a runtime error if they are not
+     * valid.
+     * @param maxScore the distance score
+     * @param seeds the seeding positions of the middle parts, relative to the
+     * size of the pattern
+     * @param partWeights the weights of the parts
+     */
+    void setDynamicPartitioning(const int& maxScore,
+                                const std::vector<double>& seeds,
+                                const std::vector<int>& partWeights);
+
     uint calculateNumParts(unsigned int maxED) const {
         assert(supportsMaxScore[maxED - 1]);
         return schemePerED[maxED - 1][0].getNumParts();
@@ -674,26 +913,36 @@ class NaiveBackTrackingStrategy : public SearchStrategy {
     }
 
   public:
+    using SearchStrategy::matchApprox;
+
     virtual std::vector<TextOcc> matchApprox(const std::string& pattern,
-                                             length_t maxED,
-                                             Counters& counters) const {
+                                             length_t maxED, Counters& counters,
+                                             CigarArena& cigars,
+                                             length_t& hits) const {
+        counters.resetCounters();
+        Occurrences occ(cigars, generateCigars, maxHits, sampleRepeats);
+        std::vector<TextOcc> result =
+            (maxED == 0)
+                ? index.exactMatchesOutput(pattern, counters, occ)
+                : index.approxMatchesNaive(pattern, maxED, counters, occ);
+        hits = occ.getHits();
+        return result;
+    }
+
+    virtual std::vector<length_t> countApprox(const std::string& pattern,
+                                              length_t maxED,
+                                              Counters& counters) const {
         counters.resetCounters();
         if (maxED == 0) {
-            auto result = index.exactMatches(pattern, counters);
-            std::vector<TextOcc> returnvalue;
-            returnvalue.reserve(result.size());
-            std::vector<std::pair<char, uint>> CIGAR = {{'M', pattern.size()}};
-            for (length_t startpos : result) {
-                returnvalue.emplace_back(
-                    Range(startpos, startpos + pattern.size()), 0, CIGAR);
-                returnvalue.back().generateOutput();
-            }
-            return returnvalue;
+            ScopedPhase scope(EXACT_SEEDING);
+            return std::vector<length_t>(
+                1, index.matchString(pattern, counters).width());
         }
-        return index.approxMatchesNaive(pattern, maxED, counters);
+        return index.countApproxNaive(pattern, maxED, counters);
     }
 
-    NaiveBackTrackingStrategy(FMIndex& index, PartitionStrategy p = DYNAMIC,
+    NaiveBackTrackingStrategy(const FMIndex& index,
+                              PartitionStrategy p = DYNAMIC,
                               DistanceMetric metric = EDITOPTIMIZED)
         : SearchStrategy(index, p, metric) {
         name = "Naive backtracking";
@@ -765,7 +1014,7 @@ class KucherovKplus1 : public SearchStrategy {
     }
 
   public:
-    KucherovKplus1(FMIndex& index, PartitionStrategy p = DYNAMIC,
+    KucherovKplus1(const FMIndex& index, PartitionStrategy p = DYNAMIC,
                    DistanceMetric metric = EDITOPTIMIZED)
         : SearchStrategy(index, p, metric) {
         name = "KUCHEROV K + 1";
@@ -850,7 +1099,7 @@ class KucherovKplus2 : public SearchStrategy {
     }
 
   public:
-    KucherovKplus2(FMIndex& index, PartitionStrategy p = DYNAMIC,
+    KucherovKplus2(const FMIndex& index, PartitionStrategy p = DYNAMIC,
                    DistanceMetric metric = EDITOPTIMIZED)
         : SearchStrategy(index, p, metric) {
         name = "KUCHEROV K + 2";
@@ -912,7 +1161,7 @@ class OptimalKianfar : public SearchStrategy {
     }
 
   public:
-    OptimalKianfar(FMIndex& index, PartitionStrategy p = DYNAMIC,
+    OptimalKianfar(const FMIndex& index, PartitionStrategy p = DYNAMIC,
                    DistanceMetric metric = EDITOPTIMIZED)
         : SearchStrategy(index, p, metric) {
         name = "OPTIMAL KIANFAR";
@@ -996,7 +1245,7 @@ class O1StarSearchStrategy : public SearchStrategy {
     }
 
   public:
-    O1StarSearchStrategy(FMIndex& index, PartitionStrategy p = DYNAMIC,
+    O1StarSearchStrategy(const FMIndex& index, PartitionStrategy p = DYNAMIC,
                          DistanceMetric metric = EDITOPTIMIZED)
         : SearchStrategy(index, p, metric) {
         name = "01*0";
@@ -1050,7 +1299,7 @@ class ManBestStrategy : public SearchStrategy {
     }
 
   public:
-    ManBestStrategy(FMIndex& index, PartitionStrategy p = DYNAMIC,
+    ManBestStrategy(const FMIndex& index, PartitionStrategy p = DYNAMIC,
                     DistanceMetric metric = EDITOPTIMIZED)
         : SearchStrategy(index, p, metric) {
         name = "MANBEST";
@@ -1100,7 +1349,8 @@ class PigeonHoleSearchStrategy : public SearchStrategy {
     }
 
   public:
-    PigeonHoleSearchStrategy(FMIndex& index, PartitionStrategy p = DYNAMIC,
+    PigeonHoleSearchStrategy(const FMIndex& index,
+                             PartitionStrategy p = DYNAMIC,
                              DistanceMetric metric = EDITOPTIMIZED)
         : SearchStrategy(index, p, metric) {
         name = "PIGEON HOLE";
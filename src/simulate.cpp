@@ -0,0 +1,441 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#include "fmindex.h"
+#include "nucleotide.h"
+#include "reads.h"
+
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string.h>
+
+using namespace std;
+
+// the size of the prefix that decides whether a read starts in a repeat, a
+// read starts in a repeat if this prefix of its template occurs more than once
+const length_t repeatSeedSize = 32;
+
+// the number of positions that are tried for a read that should start in a
+// repeat, before a position outside of a repeat is accepted
+const length_t maxRepeatAttempts = 1000;
+
+// ============================================================================
+// SIMULATING READS
+// ============================================================================
+
+/**
+ * A simulated read and its origin in the text
+ */
+struct SimulatedRead {
+    string sequence; // the sequence of the read
+    length_t begin;  // the begin of the template of the read in the text
+    bool reverse;    // true if the read is the reverse complement
+    length_t errors; // the number of errors that were introduced
+};
+
+/**
+ * Samples reads from a text with an error profile. Only the output of the
+ * Mersenne Twister is used, which is fixed by the standard, and not the
+ * distributions of the standard library, whose results differ between
+ * implementations. Therefore a seed gives the same reads on every platform.
+ */
+class ReadSimulator {
+  private:
+    const string& text;      // the text to sample from
+    const FMIndex* index;    // the index of the text, to find repeats
+    length_t readSize;       // the size of the reads
+    vector<double> errorCDF; // the cumulative distribution of the errors
+    double indelRatio;       // the fraction of errors that are indels
+    double repeatFraction;   // the fraction of reads that start in a repeat
+    mt19937_64 rng;          // the random generator
+    length_t missedRepeats = 0; // the reads that should start in a repeat,
+                                // but for which none was found
+
+    /**
+     * @returns a random number in [0, n[
+     */
+    length_t uniform(length_t n) {
+        return rng() % n;
+    }
+
+    /**
+     * @returns a random number in [0, 1[
+     */
+    double uniformReal() {
+        return (rng() >> 11) * (1.0 / (1ull << 53));
+    }
+
+    /**
+     * @returns a random base
+     */
+    char randomBase() {
+        return "ACGT"[uniform(4)];
+    }
+
+    /**
+     * Checks whether a substring of the text only consists of bases
+     * @param begin the begin of the substring
+     * @param size the size of the substring
+     */
+    bool onlyBases(length_t begin, length_t size) const {
+        for (length_t i = begin; i < begin + size; i++) {
+            char c = text[i];
+            if (c != 'A' && c != 'C' && c != 'G' && c != 'T') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Checks whether the prefix of a template occurs more than once
+     * @param begin the begin of the template
+     */
+    bool inRepeat(length_t begin) const {
+        Counters counters;
+        string seed = text.substr(begin, repeatSeedSize);
+        return index->matchString(seed, counters).width() > 1;
+    }
+
+    /**
+     * Draws the begin of a template
+     * @param size the size of the template
+     * @param repeat true if the template should start in a repeat
+     */
+    length_t drawBegin(length_t size, bool repeat) {
+        for (length_t attempt = 0;; attempt++) {
+            length_t begin = uniform(text.size() - size);
+            if (!onlyBases(begin, size)) {
+                continue;
+            }
+            if (!repeat || inRepeat(begin)) {
+                return begin;
+            }
+            if (attempt >= maxRepeatAttempts) {
+                missedRepeats++;
+                return begin;
+            }
+        }
+    }
+
+    /**
+     * Copies a template into a read, with errors at distinct positions of
+     * the read. An error is an insertion or deletion with probability
+     * indelRatio, both equally likely, and otherwise a substitution.
+     * @param begin the begin of the template, its size should be at least
+     * the size of the read plus the number of errors
+     * @param errors the number of errors
+     */
+    string copyWithErrors(length_t begin, length_t errors) {
+        vector<bool> isError(readSize, false);
+        for (length_t e = 0; e < errors;) {
+            length_t pos = uniform(readSize);
+            e += !isError[pos];
+            isError[pos] = true;
+        }
+
+        string read;
+        read.reserve(readSize);
+        length_t t = begin;
+        for (length_t i = 0; i < readSize; i++) {
+            if (!isError[i]) {
+                read += text[t++];
+            } else if (uniformReal() >= indelRatio) {
+                // substitution by one of the three other bases
+                char c = text[t++];
+                char s;
+                do {
+                    s = randomBase();
+                } while (s == c);
+                read += s;
+            } else if (uniform(2) == 0) {
+                // insertion
+                read += randomBase();
+            } else {
+                // deletion
+                t++;
+                read += text[t++];
+            }
+        }
+        return read;
+    }
+
+  public:
+    /**
+     * Constructor
+     * @param text the text to sample from
+     * @param index the index of the text, only used if repeatFraction > 0
+     * @param readSize the size of the reads
+     * @param errorWeights the weights of the number of errors, starting from
+     * zero errors
+     * @param indelRatio the fraction of the errors that are indels
+     * @param repeatFraction the fraction of the reads that start in a repeat
+     * @param seed the seed of the random generator
+     */
+    ReadSimulator(const string& text, const FMIndex* index, length_t readSize,
+                  const vector<double>& errorWeights, double indelRatio,
+                  double repeatFraction, uint64_t seed)
+        : text(text), index(index), readSize(readSize),
+          indelRatio(indelRatio), repeatFraction(repeatFraction), rng(seed) {
+        double total = 0;
+        for (double w : errorWeights) {
+            total += w;
+            errorCDF.push_back(total);
+        }
+        for (double& c : errorCDF) {
+            c /= total;
+        }
+
+        length_t maxErrors = errorCDF.size() - 1;
+        if (readSize + maxErrors + repeatSeedSize >= text.size()) {
+            throw runtime_error("The text is too short for the reads");
+        }
+    }
+
+    /**
+     * @returns the next read
+     */
+    SimulatedRead next() {
+        SimulatedRead read;
+
+        double r = uniformReal();
+        read.errors = 0;
+        while (read.errors + 1 < errorCDF.size() &&
+               errorCDF[read.errors] <= r) {
+            read.errors++;
+        }
+
+        // the template is long enough for all errors to be deletions, and
+        // for the seed that decides whether it is a repeat
+        bool repeat = uniformReal() < repeatFraction;
+        length_t size = max(readSize + read.errors, repeatSeedSize);
+        read.begin = drawBegin(size, repeat);
+
+        read.sequence = copyWithErrors(read.begin, read.errors);
+        read.reverse = uniform(2) == 1;
+        if (read.reverse) {
+            Nucleotide::revCompl(read.sequence);
+        }
+        return read;
+    }
+
+    /**
+     * @returns the number of reads that should start in a repeat, but for
+     * which no repeat was found
+     */
+    length_t getMissedRepeats() const {
+        return missedRepeats;
+    }
+};
+
+/**
+ * Parses a comma separated list of weights
+ * @param s the list
+ * @returns the weights
+ */
+vector<double> parseWeights(const string& s) {
+    vector<double> weights;
+    stringstream ss(s);
+    string token;
+    double total = 0;
+    while (getline(ss, token, ',')) {
+        double w = stod(token);
+        if (w < 0) {
+            throw runtime_error("The weights of the errors can not be "
+                                "negative");
+        }
+        weights.push_back(w);
+        total += w;
+    }
+    if (total <= 0) {
+        throw runtime_error("The weights of the errors should not all be 0");
+    }
+    return weights;
+}
+
+/**
+ * Reads the text of an index
+ * @param baseFile the base file of the index
+ * @returns the text
+ */
+string readIndexText(const string& baseFile) {
+    ifstream ifs(baseFile + ".txt");
+    if (!ifs) {
+        throw runtime_error("Problem reading: " + baseFile + ".txt");
+    }
+    stringstream ss;
+    ss << ifs.rdbuf();
+    return ss.str();
+}
+
+void showUsage() {
+    cout << "Usage: ./columba_simulate [options] basefilename "
+            "outputfile.[ext]\n\n";
+    cout << " [options]\n";
+    cout << "  -n  --num-reads\tnumber of reads [default = 100000]\n";
+    cout << "  -l  --length\t\tsize of the reads [default = 100]\n";
+    cout << "  -d  --distribution\tcomma separated weights of the number of "
+            "errors in a read, starting from 0 errors [default = "
+            "1,1,1,1,1]\n";
+    cout << "  -x  --indel-ratio\tfraction of the errors that are "
+            "insertions or deletions [default = 0.2]\n";
+    cout << "  -r  --repeats\t\tfraction of the reads that start in a "
+            "repeat, which requires the full index [default = 0]\n";
+    cout << "  -S  --seed\t\tseed of the random generator [default = 42]\n\n";
+
+    cout << "[ext]\n"
+         << "\tone of the following: fq, fastq, FASTA, fasta, fa\n\n";
+
+    cout << "The identifier of a read is sim<i>:<begin>:<strand>:<errors>, "
+            "with begin the start of its template in the text.\n";
+}
+
+int main(int argc, char* argv[]) {
+
+    int requiredArguments = 2; // baseFile and output file
+
+    if (argc == 2 && strcmp("help", argv[1]) == 0) {
+        showUsage();
+        return EXIT_SUCCESS;
+    }
+    if (argc <= requiredArguments) {
+        cerr << "Insufficient number of arguments" << endl;
+        showUsage();
+        return EXIT_FAILURE;
+    }
+
+    cout << "Welcome to Columba's read simulator!\n";
+
+    string numReads = "100000";
+    string readSize = "100";
+    string distribution = "1,1,1,1,1";
+    string indelRatio = "0.2";
+    string repeats = "0";
+    string seed = "42";
+
+    // process optional arguments
+    for (int i = 1; i < argc - requiredArguments; i++) {
+        const string& arg = argv[i];
+
+        if (i + 1 >= argc - requiredArguments) {
+            throw runtime_error(arg + " takes 1 argument as input");
+        }
+        if (arg == "-n" || arg == "--num-reads") {
+            numReads = argv[++i];
+        } else if (arg == "-l" || arg == "--length") {
+            readSize = argv[++i];
+        } else if (arg == "-d" || arg == "--distribution") {
+            distribution = argv[++i];
+        } else if (arg == "-x" || arg == "--indel-ratio") {
+            indelRatio = argv[++i];
+        } else if (arg == "-r" || arg == "--repeats") {
+            repeats = argv[++i];
+        } else if (arg == "-S" || arg == "--seed") {
+            seed = argv[++i];
+        } else {
+            cerr << "Unknown argument: " << arg << " is not an option" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    string baseFile = argv[argc - 2];
+    string outputFile = argv[argc - 1];
+
+    string ext = getFileExt(outputFile);
+    bool fastq = ext == "fq" || ext == "fastq";
+    if (!fastq && ext != "fa" && ext != "fasta" && ext != "FASTA") {
+        cerr << "The extension of the output file should be one of fq, "
+                "fastq, FASTA, fasta, fa"
+             << endl;
+        return EXIT_FAILURE;
+    }
+
+    double indel = stod(indelRatio), repeatFraction = stod(repeats);
+    if (indel < 0 || indel > 1 || repeatFraction < 0 || repeatFraction > 1) {
+        cerr << "The indel ratio and the fraction of repeats should be in "
+                "[0, 1]"
+             << endl;
+        return EXIT_FAILURE;
+    }
+    length_t size = stoul(readSize);
+    if (size == 0) {
+        cerr << "The size of the reads should be positive" << endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        vector<double> weights = parseWeights(distribution);
+        if (weights.size() > size) {
+            throw runtime_error("A read can not have more errors than "
+                                "characters");
+        }
+
+        // the index is only needed to find repeats
+        unique_ptr<FMIndex> index;
+        string text;
+        if (repeatFraction > 0) {
+            length_t saSF = FMIndex::findSparsestSA(baseFile);
+            if (saSF == 0) {
+                throw runtime_error("No suffix array found for " + baseFile);
+            }
+            index.reset(new FMIndex(baseFile, 0, saSF, false));
+        } else {
+            text = readIndexText(baseFile);
+        }
+
+        ReadSimulator simulator(index ? index->getText() : text, index.get(),
+                                size, weights, indel, repeatFraction,
+                                stoull(seed));
+
+        ofstream out(outputFile);
+        if (!out) {
+            throw runtime_error("Cannot open file: " + outputFile);
+        }
+
+        length_t n = stoul(numReads);
+        vector<length_t> readsPerErrors(weights.size(), 0);
+        for (length_t i = 0; i < n; i++) {
+            SimulatedRead read = simulator.next();
+            readsPerErrors[read.errors]++;
+
+            out << (fastq ? '@' : '>') << "sim" << i << ":" << read.begin << ":"
+                << (read.reverse ? '-' : '+') << ":" << read.errors << "\n"
+                << read.sequence << "\n";
+            if (fastq) {
+                out << "+\n" << string(read.sequence.size(), 'I') << "\n";
+            }
+        }
+
+        cout << "Wrote " << n << " reads to " << outputFile << "\n";
+        for (length_t e = 0; e < readsPerErrors.size(); e++) {
+            cout << "Reads with " << e << " errors: " << readsPerErrors[e]
+                 << "\n";
+        }
+        if (simulator.getMissedRepeats() > 0) {
+            cout << "No repeat was found for "
+                 << simulator.getMissedRepeats()
+                 << " reads that should start in one\n";
+        }
+    } catch (const exception& e) {
+        cerr << "Fatal error: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
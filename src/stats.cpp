@@ -0,0 +1,91 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#include "indexstats.h"
+
+#include <string.h>
+
+using namespace std;
+
+void showUsage() {
+    cout << "Usage: ./columba_stats [options] basefilename\n\n";
+    cout << "Prints the memory used by the components of the index, the "
+            "expected memory for every suffix array sparseness factor and "
+            "the throughput of rank and locate queries.\n\n";
+    cout << " [options]\n";
+    cout << "  -s  --sa-sparseness\tsuffix array sparseness factor to load "
+            "the index with [default = the sparsest present]\n";
+    cout << "  -n  --num-ops\tnumber of random queries per probe, look-ups "
+            "in sparser suffix arrays are fewer [default = 65536]\n";
+}
+
+int main(int argc, char* argv[]) {
+
+    if (argc < 2 || (argc == 2 && strcmp("help", argv[1]) == 0)) {
+        showUsage();
+        return (argc < 2) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    cout << "Welcome to Columba's index statistics!\n";
+
+    string saSparse = "0";
+    string numOps = "65536";
+
+    // process optional arguments
+    for (int i = 1; i < argc - 1; i++) {
+        const string& arg = argv[i];
+
+        if (i + 2 >= argc) {
+            throw runtime_error(arg + " takes 1 argument as input");
+        }
+        if (arg == "-s" || arg == "--sa-sparseness") {
+            saSparse = argv[++i];
+        } else if (arg == "-n" || arg == "--num-ops") {
+            numOps = argv[++i];
+        } else {
+            cerr << "Unknown argument: " << arg << " is not an option" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    string baseFile = argv[argc - 1];
+    length_t saSF = stoul(saSparse);
+    length_t ops = stoul(numOps);
+    if (saSF == 0) {
+        saSF = FMIndex::findSparsestSA(baseFile);
+    }
+    if (saSF == 0 || saSF > 256 || (saSF & (saSF - 1)) != 0) {
+        cerr << "No suffix array found for " << baseFile
+             << " or the sparseness factor is not in 2^[0, 8]" << endl;
+        return EXIT_FAILURE;
+    }
+    if (ops == 0) {
+        cerr << "The number of queries should be positive" << endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        FMIndex index(baseFile, 0, saSF, false);
+        IndexStats(ops).print(index, cout);
+    } catch (const exception& e) {
+        cerr << "Fatal error: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
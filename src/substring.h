@@ -1,6 +1,9 @@
 #ifndef SUBSTRING_H
 #define SUBSTRING_H
 
+#include <cassert>
+#include <string>
+
 // ============================================================================
 // ENUMS
 // ============================================================================
@@ -10,6 +13,51 @@
  */
 enum Direction { FORWARD, BACKWARD };
 
+// ============================================================================
+// CLASS SUBSTRINGVIEW
+// ============================================================================
+
+/**
+ * A view on the characters of a substring, read in a direction that is fixed
+ * at compile time. Accessing a character is a single unchecked memory access,
+ * so a loop over a view compiles to a plain pointer walk. The bounds are only
+ * checked in debug builds. A view is only valid as long as the text of the
+ * substring it was created from.
+ */
+template <Direction D> class SubstringView {
+  private:
+    const char* first; // the lowest address of the characters in the text
+    const char* last;  // one past the highest address of the characters
+
+  public:
+    /**
+     * Constructor
+     * @param first, pointer to the first character of the range in the text
+     * @param last, pointer past the last character of the range in the text
+     */
+    SubstringView(const char* first, const char* last)
+        : first(first), last(last) {
+    }
+
+    /**
+     * Get the character at index i in direction D
+     * @param i the index to get the character from
+     * @returns the character at index i
+     */
+    char operator[](unsigned int i) const {
+        assert(i < size());
+        return (D == FORWARD) ? first[i] : *(last - 1 - i);
+    }
+
+    /**
+     * Get the size of this view
+     * @returns the number of characters in this view
+     */
+    unsigned int size() const {
+        return last - first;
+    }
+};
+
 // ============================================================================
 // CLASS SUBSTRING
 // ============================================================================
@@ -96,6 +144,34 @@ class Substring {
         d = nd;
     }
 
+    /**
+     * Get the characters of this substring in the text, they are in the
+     * order of the substring only if the direction is FORWARD
+     * @returns a pointer to the first character of this substring in the text
+     */
+    const char* data() const {
+        return text->data() + startIndex;
+    }
+
+    /**
+     * Get the direction of this substring
+     * @returns the direction in which the characters are read
+     */
+    Direction getDirection() const {
+        return d;
+    }
+
+    /**
+     * Get an unchecked view on the characters of this substring. The
+     * direction of the view must equal the direction of this substring.
+     * @returns a view on the characters of this substring in direction D
+     */
+    template <Direction D> SubstringView<D> view() const {
+        assert(d == D);
+        const char* first = text->data() + startIndex;
+        return SubstringView<D>(first, first + size());
+    }
+
     /**
      * Creates a substring of a substring, skipping the first skip characters
      * (relative to the direction)
@@ -110,13 +186,15 @@ class Substring {
     }
 
     /**
-     * Get the character at index i of this substring
+     * Get the character at index i of this substring, the index is only
+     * checked in debug builds
      * @param i the index to get the character from
      * @returns the character at index i
      */
     char operator[](unsigned int i) const {
-        return (d == FORWARD) ? text->at(startIndex + i)
-                              : text->at(endIndex - i - 1);
+        assert(i < size());
+        return (d == FORWARD) ? (*text)[startIndex + i]
+                              : (*text)[endIndex - i - 1];
     }
 
     /**
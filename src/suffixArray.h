@@ -41,29 +41,35 @@ class SparseSuffixArray {
         bitvector.index();
     }
 
-    SparseSuffixArray(const std::string& basename, const length_t sparseNess)
+    SparseSuffixArray(const std::string& basename, const length_t sparseNess,
+                      bool verbose = true)
         : sparseNessFactor(sparseNess) {
 
         using namespace std;
         {
-
-            cout << "Reading "
-                 << basename + ".sa.bv." + std::to_string(sparseNessFactor)
-                 << "...";
-            cout.flush();
+            if (verbose) {
+                cout << "Reading "
+                     << basename + ".sa.bv." + std::to_string(sparseNessFactor)
+                     << "...";
+                cout.flush();
+            }
             auto name = basename + ".sa.bv." + std::to_string(sparseNessFactor);
             std::ifstream ifs(name);
             if (!ifs) {
                 throw std::runtime_error("Cannot open file: " + name);
             }
             bitvector.read(ifs);
-            cout << "done " << endl;
+            if (verbose) {
+                cout << "done " << endl;
+            }
         }
         {
-            cout << "Reading "
-                 << basename + ".sa." + std::to_string(sparseNessFactor)
-                 << "..";
-            cout.flush();
+            if (verbose) {
+                cout << "Reading "
+                     << basename + ".sa." + std::to_string(sparseNessFactor)
+                     << "..";
+                cout.flush();
+            }
             auto name = basename + ".sa." + std::to_string(sparseNessFactor);
             std::ifstream ifs(name);
             if (!ifs) {
@@ -73,23 +79,66 @@ class SparseSuffixArray {
             sparseSA.resize(ifs.tellg() / sizeof(length_t));
             ifs.seekg(0, std::ios::beg);
             ifs.read((char*)&sparseSA[0], sparseSA.size() * sizeof(length_t));
-            cout << "done" << endl;
+            if (verbose) {
+                cout << "done" << endl;
+            }
         }
     }
 
     void write(const std::string& basename) const {
+        write(basename, sparseNessFactor, bitvector, sparseSA);
+    }
+
+    /**
+     * Writes the files of a sparse suffix array
+     * @param basename the base name of the files
+     * @param sparseNess the sparseness factor
+     * @param bitvector the indexed bitvector that marks the sampled entries
+     * @param samples the sampled entries of the suffix array
+     */
+    static void write(const std::string& basename, length_t sparseNess,
+                      const Bitvec& bitvector,
+                      const std::vector<length_t>& samples) {
+        writeBitvector(basename, sparseNess, bitvector);
         {
-            std::ofstream ofs(basename + ".sa.bv." +
-                              std::to_string(sparseNessFactor));
-            bitvector.write(ofs);
-        }
-        {
-            std::ofstream ofs(basename + ".sa." +
-                              std::to_string(sparseNessFactor));
-            ofs.write((char*)sparseSA.data(),
-                      sparseSA.size() * sizeof(length_t));
+            std::ofstream ofs(basename + ".sa." + std::to_string(sparseNess));
+            ofs.write((char*)samples.data(),
+                      samples.size() * sizeof(length_t));
         }
     }
+
+    /**
+     * Writes the bitvector file of a sparse suffix array, the samples can be
+     * streamed to the file with basename.sa.sparseNess
+     * @param basename the base name of the files
+     * @param sparseNess the sparseness factor
+     * @param bitvector the indexed bitvector that marks the sampled entries
+     */
+    static void writeBitvector(const std::string& basename,
+                               length_t sparseNess, const Bitvec& bitvector) {
+        std::ofstream ofs(basename + ".sa.bv." + std::to_string(sparseNess));
+        bitvector.write(ofs);
+    }
+
+    /**
+     * @returns the number of bytes used by the sparse suffix array
+     */
+    size_t getSizeInBytes() const {
+        return bitvector.getSizeInBytes() +
+               sparseSA.capacity() * sizeof(length_t);
+    }
+
+    /**
+     * @param textLength the length of the text
+     * @param sparseNess the sparseness factor
+     * @returns the number of bytes used by a sparse suffix array of a text
+     * of that length with that sparseness factor
+     */
+    static size_t getSizeInBytes(size_t textLength, length_t sparseNess) {
+        size_t numSamples = (textLength + sparseNess - 1) / sparseNess;
+        return Bitvec::getSizeInBytes(textLength) +
+               numSamples * sizeof(length_t);
+    }
 };
 
 #endif
\ No newline at end of file
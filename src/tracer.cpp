@@ -0,0 +1,147 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#include "tracer.h"
+
+#include <atomic>
+#include <cstdio>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+// ============================================================================
+// TRACER
+// ============================================================================
+
+bool Tracer::enabled = false;
+thread_local bool Tracer::active = false;
+
+static mutex eventsMutex;           // guards the events
+static vector<string> events;       // the recorded events as JSON objects
+static chrono::steady_clock::time_point origin; // the time tracing started
+static atomic<length_t> numThreads(0); // the number of threads that traced
+
+/**
+ * @returns a small identifier of the calling thread
+ */
+static length_t getThreadID() {
+    thread_local length_t id = numThreads++;
+    return id;
+}
+
+/**
+ * Escapes a string for use in JSON
+ * @param s the string
+ * @returns the escaped string, without the quotes
+ */
+static string escape(const string& s) {
+    string escaped;
+    escaped.reserve(s.size());
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if ((unsigned char)c < 0x20) {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            escaped += buffer;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+void Tracer::enable() {
+    origin = chrono::steady_clock::now();
+    enabled = true;
+}
+
+uint64_t Tracer::now() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+               chrono::steady_clock::now() - origin)
+        .count();
+}
+
+void Tracer::addEvent(const char* name, const char* category, uint64_t start,
+                      uint64_t end, const string& args) {
+    // the timestamps are in microseconds, with nanosecond precision
+    ostringstream event;
+    event << fixed << setprecision(3) << "{\"name\":\"" << name
+          << "\",\"cat\":\"" << category << "\",\"ph\":\"X\",\"ts\":"
+          << start / 1000.0 << ",\"dur\":" << (end - start) / 1000.0
+          << ",\"pid\":0,\"tid\":" << getThreadID() << ",\"args\":{" << args
+          << "}}";
+
+    lock_guard<mutex> lock(eventsMutex);
+    events.push_back(event.str());
+}
+
+void Tracer::write(const string& file) {
+    ofstream out(file);
+    if (!out) {
+        throw runtime_error("Cannot open trace file " + file);
+    }
+    cout << "Writing trace to " << file << " ..." << endl;
+
+    lock_guard<mutex> lock(eventsMutex);
+    out << "{\"traceEvents\":[\n";
+    for (size_t i = 0; i < events.size(); i++) {
+        out << events[i] << ((i + 1 < events.size()) ? ",\n" : "\n");
+    }
+    out << "],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+// ============================================================================
+// TRACESPAN
+// ============================================================================
+
+void TraceSpan::end() {
+    if (counter != nullptr) {
+        addArg(counterKey, *counter - counterStart);
+    }
+    Tracer::addEvent(name, category, start, Tracer::now(), args);
+}
+
+void TraceSpan::addKey(const char* key) {
+    if (!args.empty()) {
+        args += ',';
+    }
+    args += '"';
+    args += key;
+    args += "\":";
+}
+
+void TraceSpan::addArg(const char* key, uint64_t value) {
+    addKey(key);
+    args += to_string(value);
+}
+
+void TraceSpan::addArg(const char* key, const string& value) {
+    addKey(key);
+    args += '"';
+    args += escape(value);
+    args += '"';
+}
@@ -0,0 +1,203 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <cstdint>
+#include <string>
+
+typedef uint32_t length_t;
+
+// ============================================================================
+// TRACER
+// ============================================================================
+
+/**
+ * Records spans of work as Chrome trace events, that can be viewed with
+ * chrome://tracing or https://ui.perfetto.dev. Tracing is disabled by default.
+ * Once enabled, each thread only records spans while it is marked active, such
+ * that a trace can be limited to a few reads. A span of an inactive thread
+ * costs a test of two flags.
+ */
+class Tracer {
+  private:
+    static bool enabled;             // true if spans can be recorded
+    thread_local static bool active; // true if this thread records spans
+
+    /**
+     * Adds a complete event to the trace
+     * @param name the name of the span
+     * @param category the category of the span
+     * @param start the start of the span in ns since tracing was enabled
+     * @param end the end of the span in ns since tracing was enabled
+     * @param args the arguments of the span as JSON members
+     */
+    static void addEvent(const char* name, const char* category,
+                         uint64_t start, uint64_t end,
+                         const std::string& args);
+
+    friend class TraceSpan;
+
+  public:
+    /**
+     * Enables tracing, must be called before any thread is marked active
+     */
+    static void enable();
+
+    /**
+     * Marks the calling thread as active or inactive, has no effect if
+     * tracing is disabled
+     * @param isActive true if the thread should record spans
+     */
+    static void setActive(bool isActive) {
+        active = isActive;
+    }
+
+    /**
+     * @returns true if the calling thread records spans
+     */
+    static bool isTracing() {
+        return enabled && active;
+    }
+
+    /**
+     * @returns the number of ns since tracing was enabled
+     */
+    static uint64_t now();
+
+    /**
+     * Writes all recorded events to a file in the JSON trace event format,
+     * should be called once all threads have finished
+     * @param file the file to write to
+     */
+    static void write(const std::string& file);
+};
+
+/**
+ * A span of work that is recorded as a trace event when it goes out of scope,
+ * if the thread was tracing when the span was created
+ */
+class TraceSpan {
+  private:
+    bool active;            // true if the span is recorded
+    const char* name;       // the name of the span
+    const char* category;   // the category of the span
+    uint64_t start;         // the start of the span
+    std::string args;       // the arguments as JSON members
+    const char* counterKey; // the name of the tracked counter
+    const length_t* counter; // the tracked counter, null if none
+    length_t counterStart;   // the value of the counter at the start
+
+    /**
+     * Appends the key of an argument
+     * @param key the key
+     */
+    void addKey(const char* key);
+
+    /**
+     * Appends a numeric argument, only called if the span is recorded
+     * @param key the name of the argument
+     * @param value the value of the argument
+     */
+    void addArg(const char* key, uint64_t value);
+
+    /**
+     * Appends a string argument, only called if the span is recorded
+     * @param key the name of the argument
+     * @param value the value of the argument
+     */
+    void addArg(const char* key, const std::string& value);
+
+    /**
+     * Ends the span and records it, only called if the span is recorded
+     */
+    void end();
+
+  public:
+    /**
+     * Constructor, starts the span
+     * @param name the name of the span, must outlive the span
+     * @param category the category of the span, must outlive the span
+     */
+    TraceSpan(const char* name, const char* category)
+        : active(Tracer::isTracing()), name(name), category(category),
+          start(0), counterKey(nullptr), counter(nullptr), counterStart(0) {
+        if (active) {
+            start = Tracer::now();
+        }
+    }
+
+    /**
+     * Destructor, ends the span and records it
+     */
+    ~TraceSpan() {
+        if (active) {
+            end();
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    /**
+     * @returns true if the span is recorded, arguments that are expensive to
+     * compute should only be computed in that case
+     */
+    bool isActive() const {
+        return active;
+    }
+
+    /**
+     * Adds a numeric argument to the span
+     * @param key the name of the argument
+     * @param value the value of the argument
+     */
+    void arg(const char* key, uint64_t value) {
+        if (active) {
+            addArg(key, value);
+        }
+    }
+
+    /**
+     * Adds a string argument to the span
+     * @param key the name of the argument
+     * @param value the value of the argument
+     */
+    void arg(const char* key, const std::string& value) {
+        if (active) {
+            addArg(key, value);
+        }
+    }
+
+    /**
+     * Adds the increase of a counter during the span as an argument when the
+     * span ends
+     * @param key the name of the argument
+     * @param c the counter, must outlive the span
+     */
+    void track(const char* key, const length_t& c) {
+        if (active) {
+            counterKey = key;
+            counter = &c;
+            counterStart = c;
+        }
+    }
+};
+
+#endif
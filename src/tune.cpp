@@ -0,0 +1,350 @@
+/******************************************************************************
+ *  Columba 1.1: Approximate Pattern Matching using Search Schemes            *
+ *  Copyright (C) 2020-2022 - Luca Renders <luca.renders@ugent.be> and        *
+ *                            Jan Fostier <jan.fostier@ugent.be>              *
+ *                                                                            *
+ *  This program is free software: you can redistribute it and/or modify      *
+ *  it under the terms of the GNU Affero General Public License as            *
+ *  published by the Free Software Foundation, either version 3 of the        *
+ *  License, or (at your option) any later version.                           *
+ *                                                                            *
+ *  This program is distributed in the hope that it will be useful,           *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU Affero General Public License for more details.                       *
+ *                                                                            *
+ * You should have received a copy of the GNU Affero General Public License   *
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.     *
+ ******************************************************************************/
+#include "mapper.h"
+#include "sample.h"
+
+#include <string.h>
+
+using namespace std;
+
+// a move of a parameter is only kept if it lowers the score by this much
+const double tolerance = 0.01;
+
+// the minimal distance between two positions, relative to the pattern size
+const double minGap = 0.02;
+
+// ============================================================================
+// TUNING
+// ============================================================================
+
+/**
+ * Checks whether positions relative to the pattern size are strictly
+ * increasing and at least minGap apart from each other and from 0 and 1
+ * @param positions the positions to check
+ */
+bool validPositions(const vector<double>& positions) {
+    double previous = 0;
+    for (double p : positions) {
+        if (p - previous < minGap) {
+            return false;
+        }
+        previous = p;
+    }
+    return 1 - previous >= minGap;
+}
+
+/**
+ * Checks whether all weights are at least 1
+ * @param weights the weights to check
+ */
+bool validWeights(const vector<int>& weights) {
+    return all_of(weights.begin(), weights.end(), [](int w) { return w > 0; });
+}
+
+/**
+ * One round of coordinate descent: every value is moved up and down by step
+ * and a move is kept if it lowers the score by more than the tolerance
+ * @param values the values to tune, they are updated to the best values found
+ * @param step the size of a move
+ * @param valid returns whether candidate values are allowed
+ * @param evaluate applies candidate values and returns their score
+ * @param best the score of values, updated with the values
+ * @returns the number of moves that were kept
+ */
+template <typename T, typename Valid, typename Evaluate>
+length_t descend(vector<T>& values, T step, Valid valid, Evaluate evaluate,
+                 double& best) {
+    length_t moves = 0;
+    for (length_t i = 0; i < values.size(); i++) {
+        for (int sign : {1, -1}) {
+            vector<T> candidate = values;
+            candidate[i] += sign * step;
+            if (!valid(candidate)) {
+                continue;
+            }
+            double s = evaluate(candidate);
+            if (s < best - tolerance) {
+                values = candidate;
+                best = s;
+                moves++;
+                break;
+            }
+        }
+    }
+    return moves;
+}
+
+/**
+ * Tunes the begin positions of static partitioning
+ * @param strategy the strategy to tune, it should use static partitioning
+ * @param reads the sample of reads
+ * @param maxED the maximal allowed distance
+ * @param rounds the number of rounds of coordinate descent
+ * @returns the cost of the initial and the tuned positions
+ */
+pair<Cost, Cost> tuneStatic(CustomSearchStrategy& strategy,
+                            const vector<string>& reads, length_t maxED,
+                            length_t rounds) {
+    vector<double> begins = strategy.getStaticPositions(maxED);
+    const Cost reference = measure(strategy, reads, maxED);
+    Cost best = reference;
+    double bestScore = score(best, reference);
+
+    auto evaluate = [&](const vector<double>& candidate) {
+        strategy.setStaticPositions(maxED, candidate);
+        Cost c = measure(strategy, reads, maxED);
+        if (score(c, reference) < bestScore - tolerance) {
+            best = c;
+        }
+        return score(c, reference);
+    };
+
+    double step = 0.04;
+    for (length_t r = 0; r < rounds; r++, step /= 2) {
+        length_t moves =
+            descend(begins, step, validPositions, evaluate, bestScore);
+        cout << "Static round " << r + 1 << ": " << moves << " moves, "
+             << best.nodes << " nodes, " << best.seconds << "s" << endl;
+    }
+    strategy.setStaticPositions(maxED, begins);
+    return make_pair(reference, best);
+}
+
+/**
+ * Tunes the seeding positions and weights of dynamic partitioning
+ * @param strategy the strategy to tune, it should use dynamic partitioning
+ * @param reads the sample of reads
+ * @param maxED the maximal allowed distance
+ * @param rounds the number of rounds of coordinate descent
+ * @returns the cost of the initial and the tuned seeds and weights
+ */
+pair<Cost, Cost> tuneDynamic(CustomSearchStrategy& strategy,
+                             const vector<string>& reads, length_t maxED,
+                             length_t rounds) {
+    vector<double> seeds = strategy.getDynamicSeeds(maxED);
+    vector<int> weights = strategy.getDynamicWeights(maxED);
+    const Cost reference = measure(strategy, reads, maxED);
+    Cost best = reference;
+    double bestScore = score(best, reference);
+
+    auto measureScore = [&]() {
+        Cost c = measure(strategy, reads, maxED);
+        if (score(c, reference) < bestScore - tolerance) {
+            best = c;
+        }
+        return score(c, reference);
+    };
+    auto evaluateSeeds = [&](const vector<double>& candidate) {
+        strategy.setDynamicPartitioning(maxED, candidate, weights);
+        return measureScore();
+    };
+    auto evaluateWeights = [&](const vector<int>& candidate) {
+        strategy.setDynamicPartitioning(maxED, seeds, candidate);
+        return measureScore();
+    };
+
+    // the weights only matter relative to each other, so their step scales
+    // with the largest weight
+    double step = 0.04;
+    int weightStep = max(1, *max_element(weights.begin(), weights.end()) / 8);
+    for (length_t r = 0; r < rounds;
+         r++, step /= 2, weightStep = max(1, weightStep / 2)) {
+        length_t moves =
+            descend(seeds, step, validPositions, evaluateSeeds, bestScore);
+        strategy.setDynamicPartitioning(maxED, seeds, weights);
+        moves += descend(weights, weightStep, validWeights, evaluateWeights,
+                         bestScore);
+        strategy.setDynamicPartitioning(maxED, seeds, weights);
+        cout << "Dynamic round " << r + 1 << ": " << moves << " moves, "
+             << best.nodes << " nodes, " << best.seconds << "s" << endl;
+    }
+    return make_pair(reference, best);
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+void showUsage() {
+    cout << "Usage: ./columba_tune [options] basefilename readfile.[ext] "
+            "outputfolder\n\n";
+    cout << "Tunes the partitioning parameters of a search scheme on a sample "
+            "of reads and writes them as a custom search scheme to "
+            "outputfolder, to be used with -ss custom outputfolder\n\n";
+    cout << " [options]\n";
+    cout << "  -e  --max-ed\t\tmaximum edit distance, in [1, "
+         << CustomSearchStrategy::MAX_SCORE << "] [default = 4]\n";
+    cout << "  -s  --sa-sparseness\tsuffix array sparseness factor "
+            "[default = 1]\n";
+    cout << "  -m   --metric\tdistance metric (editnaive/editopt/hamming) "
+            "[default = editopt]\n";
+    cout << "  -i  --in-text\tThe tipping point for in-text verification, "
+            "or auto [default = 5]\n";
+    cout << "  -n  --num-reads\tnumber of reads in the sample, both strands "
+            "are matched [default = 1000]\n";
+    cout << "  -r  --rounds\tnumber of rounds of coordinate descent, the step "
+            "halves every round [default = 4]\n";
+    cout << "  -ss --search-scheme\tthe search scheme to start from, one of "
+            "kuch1, kuch2, kianfar, manbest, pigeon, 01*0 or custom followed "
+            "by a folder [default = kuch1]\n\n";
+
+    cout << "[ext]\n"
+         << "\tone of the following: fq, fastq, FASTA, fasta, fa\n";
+}
+
+int main(int argc, char* argv[]) {
+
+    int requiredArguments = 3; // baseFile, reads and output folder
+
+    if (argc == 2 && strcmp("help", argv[1]) == 0) {
+        showUsage();
+        return EXIT_SUCCESS;
+    }
+    if (argc <= requiredArguments) {
+        cerr << "Insufficient number of arguments" << endl;
+        showUsage();
+        return EXIT_FAILURE;
+    }
+
+    cout << "Welcome to Columba's search scheme tuner!\n";
+
+    string saSparse = "1";
+    string maxED = "4";
+    string searchscheme = "kuch1";
+    string customFile = "";
+    string inTextPoint = "5";
+    string numReads = "1000";
+    string rounds = "4";
+    DistanceMetric metric = EDITOPTIMIZED;
+
+    // process optional arguments
+    for (int i = 1; i < argc - requiredArguments; i++) {
+        const string& arg = argv[i];
+
+        if (i + 1 >= argc - requiredArguments) {
+            throw runtime_error(arg + " takes 1 argument as input");
+        }
+        if (arg == "-s" || arg == "--sa-sparseness") {
+            saSparse = argv[++i];
+        } else if (arg == "-e" || arg == "--max-ed") {
+            maxED = argv[++i];
+        } else if (arg == "-i" || arg == "--in-text") {
+            inTextPoint = argv[++i];
+        } else if (arg == "-n" || arg == "--num-reads") {
+            numReads = argv[++i];
+        } else if (arg == "-r" || arg == "--rounds") {
+            rounds = argv[++i];
+        } else if (arg == "-ss" || arg == "--search-scheme") {
+            searchscheme = argv[++i];
+            if (searchscheme == "naive") {
+                throw runtime_error("the naive scheme has no parameters");
+            }
+            if (searchscheme == "custom") {
+                if (i + 1 >= argc - requiredArguments) {
+                    throw runtime_error(
+                        "custom search scheme takes a folder as argument");
+                }
+                customFile = argv[++i];
+            }
+        } else if (arg == "-m" || arg == "--metric") {
+            string s = argv[++i];
+            if (s == "editopt") {
+                metric = EDITOPTIMIZED;
+            } else if (s == "editnaive") {
+                metric = EDITNAIVE;
+            } else if (s == "hamming") {
+                metric = HAMMING;
+            } else {
+                throw runtime_error(s + " is not a metric option\nOptions are: "
+                                        "editopt, editnaive, hamming");
+            }
+        } else {
+            cerr << "Unknown argument: " << arg << " is not an option" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    length_t ed = stoi(maxED);
+    if (ed < 1 || ed > CustomSearchStrategy::MAX_SCORE) {
+        cerr << ed << " is not allowed as maxED should be in [1, "
+             << CustomSearchStrategy::MAX_SCORE << "]" << endl;
+        return EXIT_FAILURE;
+    }
+    length_t saSF = stoi(saSparse);
+    if (saSF == 0 || saSF > 256 || (saSF & (saSF - 1)) != 0) {
+        cerr << saSF
+             << " is not allowed as sparse factor, should be in 2^[0, 8]"
+             << endl;
+        return EXIT_FAILURE;
+    }
+    bool adaptiveSwitch = inTextPoint == "auto";
+    length_t inTextSwitchPoint = adaptiveSwitch ? 0 : stoi(inTextPoint);
+
+    string baseFile = argv[argc - 3];
+    string readsFile = argv[argc - 2];
+    string outputFolder = argv[argc - 1];
+
+    try {
+        vector<string> sample = getSample(readsFile, stoul(numReads));
+        cout << "Tuning on " << sample.size() << " sequences" << endl;
+
+        FMIndex index(baseFile, inTextSwitchPoint, saSF);
+        if (adaptiveSwitch) {
+            index.calibrateInTextSwitch();
+        }
+
+        unique_ptr<SearchStrategy> base(createSearchStrategy(
+            index, searchscheme, ed, DYNAMIC, metric, customFile));
+        string name = base->getName() + " tuned";
+        CustomSearchStrategy staticStrategy(index, name, ed,
+                                            base->getSearches(ed), STATIC,
+                                            metric);
+        CustomSearchStrategy dynamicStrategy(index, name, ed,
+                                             base->getSearches(ed), DYNAMIC,
+                                             metric);
+        staticStrategy.setStaticPositions(ed, base->getStaticPositions(ed));
+        dynamicStrategy.setDynamicPartitioning(ed, base->getDynamicSeeds(ed),
+                                               base->getDynamicWeights(ed));
+        // the CIGAR strings do not depend on the partitioning
+        staticStrategy.setGenerateCigars(false);
+        dynamicStrategy.setGenerateCigars(false);
+
+        auto s = tuneStatic(staticStrategy, sample, ed, stoi(rounds));
+        auto d = tuneDynamic(dynamicStrategy, sample, ed, stoi(rounds));
+
+        cout << "Static partitioning: " << s.first.nodes << " -> "
+             << s.second.nodes << " nodes, " << s.first.seconds << "s -> "
+             << s.second.seconds << "s" << endl;
+        cout << "Dynamic partitioning: " << d.first.nodes << " -> "
+             << d.second.nodes << " nodes, " << d.first.seconds << "s -> "
+             << d.second.seconds << "s" << endl;
+
+        // write both tuned partitionings as one scheme
+        staticStrategy.setDynamicPartitioning(
+            ed, dynamicStrategy.getDynamicSeeds(ed),
+            dynamicStrategy.getDynamicWeights(ed));
+        staticStrategy.writeToFolder(outputFolder, ed);
+        cout << "Wrote the tuned search scheme to " << outputFolder << endl;
+    } catch (const exception& e) {
+        cerr << "Fatal error: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}